@@ -0,0 +1,67 @@
+#pragma once
+
+// Scenes shared by the benchmarks, built like the demo: the ground, two walls and a pile of
+// bodies dropped in rows between them
+
+#include "Physics/PhysicsLayer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace BenchScenes
+{
+	const float AspectRatio = 2560.0f / 1440.0f;
+
+	// Same settings as the demo window
+	inline Physics* MakePhysics()
+	{
+		Physics* physics = new Physics(0.6f, -1.0f, 0.2f, 2.95f, 0.5f, AspectRatio);
+		physics->AddWall(-0.8f, -0.5f, 0.07f, 1.0f);
+		physics->AddWall(0.8f, -0.5f, 0.07f, 1.0f);
+		return physics;
+	}
+
+	// Rows of circles (and squares when mixed) with a little jitter so the pile doesn't stack
+	// perfectly. Bodies shrink as the count grows so every pile fits under the top of the frame
+	inline void AddPile(BodyStore& bodies, uint32_t count, bool mixed)
+	{
+		uint32_t columns = std::max(40u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count)) * 1.1f)));
+		bodies.SetAspectRatio(AspectRatio);
+		bodies.Add({ ShapeType::Ground, 0.0f, -1.0f, 0.2f, 2.95f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> jitter(0.0f, 0.001f);
+		float spacing = 1.4f / columns;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float x = -0.7f + (i % columns) * spacing + jitter(random);
+			float y = -0.8f + (i / columns) * spacing * 1.7f;
+			if (mixed && (i + i / columns) % 2 == 0)
+			{
+				bodies.Add({ ShapeType::Square, x, y, spacing * 0.85f, spacing * 0.85f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+			}
+			else
+			{
+				bodies.Add({ ShapeType::Circle, x, y, spacing * 2.8f, spacing * 2.8f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+			}
+		}
+	}
+
+	// FNV-1a over the positions, equal hashes mean bit-identical simulations
+	inline uint64_t HashPositions(const BodyStore& bodies)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < bodies.Size(); i++)
+		{
+			for (float value : { bodies.x[i], bodies.y[i] })
+			{
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				hash = (hash ^ bits) * 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+}
\ No newline at end of file
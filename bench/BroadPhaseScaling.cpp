@@ -0,0 +1,102 @@
+// Uniform grid broadphase scaling: build + pair search at 1k, 10k and 100k bodies at constant
+// density, after checking the pairs against brute force on smaller scenes. The serial build is
+// timed on one thread, the parallel build and pair search on every hardware thread (or threads).
+// Usage: BroadPhaseScaling [largest body count, default 100000] [threads, default 0 = all]
+
+#include "Physics/BroadPhase.h"
+#include "Physics/UniformGrid.h"
+#include "Core/JobSystem.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Boxes of half size 0.01 to 0.03 spread so the density stays the same for every count
+	std::vector<AABB> MakeScene(uint32_t count, std::mt19937& random)
+	{
+		float side = std::sqrt(static_cast<float>(count)) * 0.02f;
+		std::uniform_real_distribution<float> position(-side, side);
+		std::uniform_real_distribution<float> halfSize(0.01f, 0.03f);
+
+		std::vector<AABB> bounds(count);
+		for (AABB& box : bounds)
+		{
+			float x = position(random);
+			float y = position(random);
+			float half = halfSize(random);
+			box = { x - half, y - half, x + half, y + half };
+		}
+		return bounds;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t largest = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+	JobSystem jobs((argc > 2) ? static_cast<unsigned int>(std::atoi(argv[2])) : 0);
+	std::mt19937 random(1);
+
+	for (uint32_t count : { 100u, 1000u, 5000u })
+	{
+		std::vector<AABB> bounds = MakeScene(count, random);
+		BruteForceBroadPhase bruteForce;
+		UniformGrid grid, parallelGrid;
+		std::vector<BodyPair> expected, pairs, parallelPairs;
+		bruteForce.Update(bounds);
+		bruteForce.FindPairs(expected);
+		grid.Update(bounds);
+		grid.FindPairs(pairs);
+		parallelGrid.UpdateParallel(bounds, jobs);
+		parallelGrid.FindPairsParallel(parallelPairs, jobs);
+
+		auto same = [](const std::vector<BodyPair>& first, const std::vector<BodyPair>& second)
+			{
+				bool equal = first.size() == second.size();
+				for (size_t i = 0; equal && i < first.size(); i++)
+				{
+					equal = first[i].a == second[i].a && first[i].b == second[i].b;
+				}
+				return equal;
+			};
+		std::printf("%6u bodies: %zu pairs, serial build %s brute force, parallel build %s\n", count, pairs.size(),
+			same(expected, pairs) ? "matches" : "DIFFERS FROM", same(expected, parallelPairs) ? "matches" : "DIFFERS");
+	}
+
+	const int Repeats = 10;
+	for (uint32_t count = 1000; count <= largest; count *= 10)
+	{
+		std::vector<AABB> bounds = MakeScene(count, random);
+		UniformGrid grid;
+		std::vector<BodyPair> pairs;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < Repeats; repeat++)
+		{
+			grid.Update(bounds);
+		}
+		auto built = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < Repeats; repeat++)
+		{
+			grid.UpdateParallel(bounds, jobs);
+		}
+		auto builtParallel = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < Repeats; repeat++)
+		{
+			grid.FindPairsParallel(pairs, jobs);
+		}
+		auto searched = std::chrono::steady_clock::now();
+
+		auto milliseconds = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+			{
+				return std::chrono::duration<double, std::milli>(to - from).count() / Repeats;
+			};
+		std::printf("%6u bodies: build %.3f ms serial, %.3f ms on %u threads, search %.3f ms, %zu pairs\n", count,
+			milliseconds(start, built), milliseconds(built, builtParallel), jobs.GetThreadCount(),
+			milliseconds(builtParallel, searched), pairs.size());
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+// Morton reordering on and off for a zero-gravity gas of circles added in shuffled order, the
+// memory layout a scene ends up with after many spawns and removals. Reports the average step
+// and the slowest one, which is where a reorder and the broadphase rebuild after it land.
+// Usage: MortonReorder [body count, default 20000] [steps, default 300]
+
+#include "BenchScenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// A dense floating grid of small circles drifting in random directions
+	void AddGas(BodyStore& bodies, uint32_t count)
+	{
+		bodies.SetAspectRatio(BenchScenes::AspectRatio);
+		bodies.Add({ ShapeType::Ground, 0.0f, -1.0f, 0.2f, 2.95f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+
+		uint32_t columns = static_cast<uint32_t>(std::sqrt(count * 1.6f));
+		float spacing = 1.5f / columns;
+		std::vector<uint32_t> order(count);
+		std::iota(order.begin(), order.end(), 0u);
+		std::mt19937 random(5);
+		std::shuffle(order.begin(), order.end(), random);
+
+		std::uniform_real_distribution<float> velocity(-0.05f, 0.05f);
+		for (uint32_t i : order)
+		{
+			float x = -0.75f + (i % columns) * spacing;
+			float y = -0.8f + (i / columns) * spacing * BenchScenes::AspectRatio * 0.55f;
+			bodies.Add({ ShapeType::Circle, x, y, 0.008f, 0.008f, 1.0f, 1.0f, 1.0f, 1.0f, velocity(random), velocity(random), false });
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t count = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 20000;
+	int steps = (argc > 2) ? std::atoi(argv[2]) : 300;
+	std::printf("%u bodies, %d steps, one thread\n", count, steps);
+
+	const struct { BroadPhaseType type; const char* name; } BroadPhases[] = {
+		{ BroadPhaseType::UniformGrid, "uniform grid" },
+		{ BroadPhaseType::SweepAndPrune, "sweep and prune" },
+		{ BroadPhaseType::DynamicTree, "dynamic tree" },
+	};
+	for (const auto& broadPhase : BroadPhases)
+	{
+		for (int interval : { 0, 60 })
+		{
+			Physics* physics = BenchScenes::MakePhysics();
+			physics->SetGravity(0.0f);
+			physics->SetThreadCount(1);
+			physics->SetSleepEnabled(false);
+			physics->SetBroadPhase(broadPhase.type);
+			physics->SetReorderInterval(interval);
+			BodyStore bodies;
+			AddGas(bodies, count);
+
+			double total = 0.0;
+			double slowest = 0.0;
+			for (int step = 0; step < steps; step++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				physics->Update(bodies, 1.0f / 60.0f);
+				double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				total += milliseconds;
+				// The first step builds the broadphase from nothing either way
+				if (step > 0)
+				{
+					slowest = std::max(slowest, milliseconds);
+				}
+			}
+			delete physics;
+
+			std::printf("%-16s reorder %-3s %8.3f ms/step, slowest step %8.3f ms\n", broadPhase.name,
+				interval > 0 ? "on" : "off", total / steps, slowest);
+		}
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+// Barnes-Hut n-body gravity on a uniform disk of bodies: tree build and force times from
+// GetNBodyStats, and the error against summing every pair over a sample of bodies, for a few
+// opening angles at 10k bodies and up to the largest count. One thread.
+// Usage: NBodyScaling [largest body count, default 100000] [steps, default 10]
+
+#include "BenchScenes.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace
+{
+	// Bodies spread evenly over a disk of radius 0.45 in the middle of the frame
+	void AddDisk(BodyStore& bodies, uint32_t count)
+	{
+		bodies.SetAspectRatio(BenchScenes::AspectRatio);
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float radius = 0.45f * std::sqrt(unit(random));
+			float angle = 6.2831853f * unit(random);
+			float x = radius * std::cos(angle) / BenchScenes::AspectRatio;
+			float y = radius * std::sin(angle);
+			bodies.Add({ ShapeType::Circle, x, y, 0.004f, 0.004f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t largest = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+	int steps = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+	for (uint32_t count = 10000; count <= largest; count *= 10)
+	{
+		// An opening angle of 0 opens every node, which is only affordable for the small disk
+		for (float openingAngle : { 0.0f, 0.3f, 0.5f, 0.7f })
+		{
+			if (openingAngle == 0.0f && count > 10000)
+			{
+				continue;
+			}
+
+			Physics physics(0.0f, -1.0f, 0.2f, 2.95f, 0.5f, BenchScenes::AspectRatio);
+			physics.SetThreadCount(1);
+			physics.SetGravityMode(GravityMode::NBody);
+			physics.SetGravitationalConstant(1e-4f);
+			physics.SetOpeningAngle(openingAngle);
+			physics.SetSoftening(0.002f);
+			BodyStore bodies;
+			AddDisk(bodies, count);
+
+			double buildMilliseconds = 0.0;
+			double forceMilliseconds = 0.0;
+			for (int step = 0; step < steps; step++)
+			{
+				physics.Update(bodies, 1.0f / 60.0f);
+				buildMilliseconds += physics.GetNBodyStats().buildMilliseconds;
+				forceMilliseconds += physics.GetNBodyStats().forceMilliseconds;
+			}
+
+			const NBodyStats& stats = physics.GetNBodyStats();
+			NBodyError error = physics.MeasureNBodyError(200);
+			std::printf("%6u bodies, opening angle %.1f: build %6.2f ms, forces %7.2f ms, %4.0f interactions per body, "
+				"error rms %.1e max %.1e\n", stats.bodies, openingAngle, buildMilliseconds / steps,
+				forceMilliseconds / steps, stats.interactionsPerBody, error.rmsError, error.maxError);
+		}
+	}
+	return 0;
+}
\ No newline at end of file
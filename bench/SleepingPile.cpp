@@ -0,0 +1,89 @@
+// Step time of a settled pile with one body awake. The pile is stepped until every body sleeps,
+// then one circle is dropped onto it; the steps while it falls are what the sleeping bodies cost,
+// the steps after it lands include the islands it wakes.
+// The pile is columns of squares stacked where they come to rest. A dropped pile this size
+// pours over the walls for longer than it takes to run the benchmark, so it never sleeps.
+// Usage: SleepingPile [body count, default 50000] [steps after the drop, default 240]
+
+#include "BenchScenes.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	// Columns of squares standing on the ground between the walls, as many rows as columns
+	void AddStacks(BodyStore& bodies, uint32_t count)
+	{
+		uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+		float size = 0.9f / columns;
+		float spacing = 1.2f * size / BenchScenes::AspectRatio;
+		bodies.SetAspectRatio(BenchScenes::AspectRatio);
+		bodies.Add({ ShapeType::Ground, 0.0f, -1.0f, 0.2f, 2.95f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float x = -0.5f * spacing * (columns - 1) + (i % columns) * spacing;
+			float y = -0.9f + size * (0.5f + i / columns);
+			bodies.Add({ ShapeType::Square, x, y, size, size, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+		}
+	}
+
+	uint32_t CountAsleep(const BodyStore& bodies)
+	{
+		uint32_t asleep = 0;
+		for (size_t i = 0; i < bodies.Size(); i++)
+		{
+			asleep += bodies.asleep[i];
+		}
+		return asleep;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t count = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 50000;
+	int steps = (argc > 2) ? std::atoi(argv[2]) : 240;
+
+	Physics* physics = BenchScenes::MakePhysics();
+	BodyStore bodies;
+	AddStacks(bodies, count);
+
+	// Everything but the ground has to fall asleep, give up after a minute of simulated time
+	int settleSteps = 0;
+	while (CountAsleep(bodies) + 1 < bodies.Size() && settleSteps < 3600)
+	{
+		physics->Update(bodies, 1.0f / 60.0f);
+		settleSteps++;
+	}
+	std::printf("%zu bodies, %u asleep after %d steps\n", bodies.Size(), CountAsleep(bodies), settleSteps);
+
+	bodies.Add({ ShapeType::Circle, 0.0f, 0.5f, 0.02f, 0.02f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+
+	double fallingMilliseconds = 0.0;
+	int fallingSteps = 0;
+	double totalMilliseconds = 0.0;
+	for (int step = 0; step < steps; step++)
+	{
+		bool falling = CountAsleep(bodies) + 2 == bodies.Size();
+		auto start = std::chrono::steady_clock::now();
+		physics->Update(bodies, 1.0f / 60.0f);
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		totalMilliseconds += milliseconds;
+		if (falling)
+		{
+			fallingMilliseconds += milliseconds;
+			fallingSteps++;
+		}
+	}
+
+	const PairStats& pairs = physics->GetPairStats();
+	std::printf("one body awake: %8.3f ms/step over %d steps\n", fallingSteps ? fallingMilliseconds / fallingSteps : 0.0, fallingSteps);
+	std::printf("after the drop: %8.3f ms/step over %d steps, %u asleep at the end\n", totalMilliseconds / steps, steps,
+		CountAsleep(bodies));
+	std::printf("last step pairs: %u overlapping, %u sleeping, %u tested, %u touching\n", pairs.overlapping, pairs.sleeping,
+		pairs.tested, pairs.touching);
+	delete physics;
+	return 0;
+}
\ No newline at end of file
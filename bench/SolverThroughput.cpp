@@ -0,0 +1,152 @@
+// Contact solver throughput: the scalar and the wide SolveContactVelocities on the same fixed
+// pile, in contacts per millisecond (every contact counted once per iteration). The pile is a
+// lattice of touching circles on the ground, coloured like ContactSolver does so no kernel call
+// sees a body twice. The SolverThroughputSse target builds this without AVX2 to time SSE.
+// Usage: SolverThroughput [columns, default 80] [rows, default 75] [repeats, default 200]
+
+#include "Physics/SimdKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const float AspectRatio = 2560.0f / 1440.0f;
+	const int Iterations = 8;
+
+	struct Pile
+	{
+		ContactColumns contacts;
+		// Start of every colour, plus the end
+		std::vector<size_t> colourStart;
+		std::vector<float> xVcty, yVcty;
+	};
+
+	void AddContact(ContactColumns& contacts, uint32_t a, uint32_t b, float normalX, float normalY)
+	{
+		bool staticB = (b == ContactColumns::StaticContactBody);
+		contacts.a.push_back(a);
+		contacts.b.push_back(b);
+		contacts.normalX.push_back(normalX);
+		contacts.normalY.push_back(normalY);
+		contacts.invMassA.push_back(1.0f);
+		contacts.invMassB.push_back(staticB ? 0.0f : 1.0f);
+		contacts.mass.push_back(staticB ? 1.0f : 0.5f);
+		contacts.friction.push_back(0.4f);
+		contacts.normalImpulse.push_back(0.0f);
+		contacts.tangentImpulse.push_back(0.0f);
+	}
+
+	// Every body touches its right and upper neighbour, the bottom row touches the ground.
+	// Horizontal contacts split by column parity and vertical ones by row parity make four
+	// colours without shared bodies, the ground contacts a fifth
+	Pile MakePile(uint32_t columns, uint32_t rows)
+	{
+		Pile pile;
+		auto body = [columns](uint32_t column, uint32_t row) { return row * columns + column; };
+		for (uint32_t parity = 0; parity < 2; parity++)
+		{
+			pile.colourStart.push_back(pile.contacts.a.size());
+			for (uint32_t row = 0; row < rows; row++)
+			{
+				for (uint32_t column = parity; column + 1 < columns; column += 2)
+				{
+					AddContact(pile.contacts, body(column, row), body(column + 1, row), 1.0f, 0.0f);
+				}
+			}
+		}
+		for (uint32_t parity = 0; parity < 2; parity++)
+		{
+			pile.colourStart.push_back(pile.contacts.a.size());
+			for (uint32_t row = parity; row + 1 < rows; row += 2)
+			{
+				for (uint32_t column = 0; column < columns; column++)
+				{
+					AddContact(pile.contacts, body(column, row), body(column, row + 1), 0.0f, 1.0f);
+				}
+			}
+		}
+		pile.colourStart.push_back(pile.contacts.a.size());
+		for (uint32_t column = 0; column < columns; column++)
+		{
+			AddContact(pile.contacts, body(column, 0), ContactColumns::StaticContactBody, 0.0f, -1.0f);
+		}
+		pile.colourStart.push_back(pile.contacts.a.size());
+
+		// Falling with some sideways jostle so friction and the normal clamp both have work
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> jostle(-0.05f, 0.05f);
+		pile.xVcty.resize(columns * rows);
+		pile.yVcty.resize(columns * rows);
+		for (size_t i = 0; i < pile.xVcty.size(); i++)
+		{
+			pile.xVcty[i] = jostle(random);
+			pile.yVcty[i] = -0.5f + jostle(random);
+		}
+		return pile;
+	}
+
+	// Runs the iterations repeats times from the same starting state, returns the milliseconds
+	// spent in the kernel and leaves the pile as one run left it
+	template<typename Kernel>
+	double Time(const Pile& start, Pile& pile, int repeats, Kernel kernel)
+	{
+		double milliseconds = 0.0;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			pile = start;
+			auto begin = std::chrono::steady_clock::now();
+			for (int iteration = 0; iteration < Iterations; iteration++)
+			{
+				for (size_t colour = 0; colour + 1 < pile.colourStart.size(); colour++)
+				{
+					kernel(pile.contacts, pile.colourStart[colour], pile.colourStart[colour + 1], pile.xVcty.data(),
+						pile.yVcty.data(), AspectRatio);
+				}
+			}
+			milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		return milliseconds;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t columns = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 80;
+	uint32_t rows = (argc > 2) ? static_cast<uint32_t>(std::atoi(argv[2])) : 75;
+	int repeats = (argc > 3) ? std::atoi(argv[3]) : 200;
+
+#if defined(PHYSICS_SIMD_AVX2)
+	const char* wideName = "AVX2";
+#elif defined(PHYSICS_SIMD_SSE)
+	const char* wideName = "SSE";
+#else
+	const char* wideName = "scalar (no SIMD)";
+#endif
+
+	Pile start = MakePile(columns, rows);
+	size_t contactCount = start.contacts.a.size();
+	std::printf("%u bodies, %zu contacts in %zu colours, %d iterations, %d repeats\n", columns * rows, contactCount,
+		start.colourStart.size() - 1, Iterations, repeats);
+
+	Pile scalar, wide;
+	double scalarMilliseconds = Time(start, scalar, repeats, ScalarSolveContactVelocities);
+	double wideMilliseconds = Time(start, wide, repeats, SolveContactVelocities);
+
+	float largestDifference = 0.0f;
+	for (size_t i = 0; i < scalar.xVcty.size(); i++)
+	{
+		largestDifference = std::max(largestDifference, std::abs(scalar.xVcty[i] - wide.xVcty[i]));
+		largestDifference = std::max(largestDifference, std::abs(scalar.yVcty[i] - wide.yVcty[i]));
+	}
+
+	double solved = static_cast<double>(contactCount) * Iterations * repeats;
+	std::printf("scalar: %8.0f contacts/ms\n", solved / scalarMilliseconds);
+	std::printf("%s: %8.0f contacts/ms, %.2fx scalar, velocities within %g of scalar\n", wideName,
+		solved / wideMilliseconds, scalarMilliseconds / wideMilliseconds, largestDifference);
+	return 0;
+}
\ No newline at end of file
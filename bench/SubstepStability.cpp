@@ -0,0 +1,148 @@
+// Stability against cost per frame for the impulse solver and the substepped solver: the worst
+// overlap between any two circles after a pile settles, and the average step time. One thread,
+// no sleeping, so every mode pays for every body on every step.
+// Usage: SubstepStability [steps for the large pile, default 300]
+
+#include "BenchScenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace
+{
+	struct Mode
+	{
+		const char* name;
+		SolverType solver;
+		// Velocity and position iterations for the impulse solver, substeps for the other
+		int first;
+		int second;
+	};
+
+	// The two demo walls as bodies as well as static geometry, like the demo window adds them
+	void AddWalls(BodyStore& bodies)
+	{
+		bodies.Add({ ShapeType::Wall, -0.8f, -0.5f, 1.0f, 0.07f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+		bodies.Add({ ShapeType::Wall, 0.8f, -0.5f, 1.0f, 0.07f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+	}
+
+	// 400 large circles in 20 columns
+	void AddSmallPile(BodyStore& bodies)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> jitter(0.0f, 0.01f);
+		for (int i = 0; i < 400; i++)
+		{
+			float x = -0.6f + (i % 20) * 0.06f + jitter(random);
+			float y = -0.8f + (i / 20) * 0.06f;
+			bodies.Add({ ShapeType::Circle, x, y, 0.1f, 0.1f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+		}
+	}
+
+	// 6000 small circles in 120 columns
+	void AddLargePile(BodyStore& bodies)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> jitter(0.0f, 0.001f);
+		for (int i = 0; i < 6000; i++)
+		{
+			float x = -0.75f + (i % 120) * 1.5f / 120 + jitter(random);
+			float y = -0.85f + (i / 120) * 0.021f;
+			bodies.Add({ ShapeType::Circle, x, y, 0.035f, 0.035f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, false });
+		}
+	}
+
+	// Deepest overlap of any two circles in aspect corrected space, every pair checked
+	float LargestOverlap(const BodyStore& bodies)
+	{
+		float largest = 0.0f;
+		for (size_t i = 0; i < bodies.Size(); i++)
+		{
+			if (bodies.type[i] != ShapeType::Circle)
+			{
+				continue;
+			}
+			for (size_t j = i + 1; j < bodies.Size(); j++)
+			{
+				if (bodies.type[j] != ShapeType::Circle)
+				{
+					continue;
+				}
+				float dx = (bodies.x[i] - bodies.x[j]) * BenchScenes::AspectRatio;
+				float dy = bodies.y[i] - bodies.y[j];
+				float overlap = bodies.halfHeight[i] + bodies.halfHeight[j] - std::sqrt(dx * dx + dy * dy);
+				largest = std::max(largest, overlap);
+			}
+		}
+		return largest;
+	}
+
+	void Run(const Mode& mode, bool largePile, int steps)
+	{
+		Physics* physics = BenchScenes::MakePhysics();
+		physics->SetThreadCount(1);
+		physics->SetSleepEnabled(false);
+		physics->SetSolverType(mode.solver);
+		if (mode.solver == SolverType::Substep)
+		{
+			physics->SetSubsteps(mode.first);
+		}
+		else
+		{
+			physics->SetSolverIterations(mode.first, mode.second);
+		}
+
+		BodyStore bodies;
+		bodies.SetAspectRatio(BenchScenes::AspectRatio);
+		bodies.Add({ ShapeType::Ground, 0.0f, -1.0f, 0.2f, 2.95f, 0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+		AddWalls(bodies);
+		if (largePile)
+		{
+			AddLargePile(bodies);
+		}
+		else
+		{
+			AddSmallPile(bodies);
+		}
+		size_t added = bodies.Size();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int step = 0; step < steps; step++)
+		{
+			physics->Update(bodies, 1.0f / 60.0f);
+		}
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / steps;
+		delete physics;
+
+		std::printf("  %-12s max overlap %.4f, %7.3f ms/frame, %zu of %zu bodies kept\n", mode.name,
+			LargestOverlap(bodies), milliseconds, bodies.Size() - 3, added - 3);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int largeSteps = (argc > 1) ? std::atoi(argv[1]) : 300;
+
+	const Mode Modes[] = {
+		{ "impulse 8/3", SolverType::Impulse, 8, 3 },
+		{ "impulse 4/2", SolverType::Impulse, 4, 2 },
+		{ "substep 4", SolverType::Substep, 4, 0 },
+		{ "substep 8", SolverType::Substep, 8, 0 },
+		{ "substep 16", SolverType::Substep, 16, 0 },
+	};
+
+	std::printf("400 circles, 1200 steps\n");
+	for (const Mode& mode : Modes)
+	{
+		Run(mode, false, 1200);
+	}
+	std::printf("6000 circles, %d steps\n", largeSteps);
+	for (const Mode& mode : Modes)
+	{
+		Run(mode, true, largeSteps);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Step time against thread count for every broadphase on a settling pile of circles, and a hash of
+// the final positions so a thread count that changes the simulation shows up.
+// Usage: ThreadScaling [body count, default 5000] [steps, default 300]
+
+#include "BenchScenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	uint32_t count = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 5000;
+	int steps = (argc > 2) ? std::atoi(argv[2]) : 300;
+
+	// Powers of two up to 8 even on smaller machines so determinism is always checked, then up
+	// to every hardware thread
+	unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads <= std::max(8u, hardwareThreads); threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	if (threadCounts.back() != hardwareThreads && hardwareThreads > 8)
+	{
+		threadCounts.push_back(hardwareThreads);
+	}
+	std::printf("%u bodies, %d steps, %u hardware threads\n", count, steps, hardwareThreads);
+
+	const struct { BroadPhaseType type; const char* name; } BroadPhases[] = {
+		{ BroadPhaseType::UniformGrid, "uniform grid" },
+		{ BroadPhaseType::SweepAndPrune, "sweep and prune" },
+		{ BroadPhaseType::DynamicTree, "dynamic tree" },
+	};
+	for (const auto& broadPhase : BroadPhases)
+	{
+		double singleThreaded = 0.0;
+		uint64_t singleThreadedHash = 0;
+		for (unsigned int threads : threadCounts)
+		{
+			Physics* physics = BenchScenes::MakePhysics();
+			physics->SetBroadPhase(broadPhase.type);
+			physics->SetThreadCount(threads);
+			// A settled pile would fall asleep and leave the threads nothing to do
+			physics->SetSleepEnabled(false);
+			BodyStore bodies;
+			BenchScenes::AddPile(bodies, count, false);
+
+			auto start = std::chrono::steady_clock::now();
+			for (int step = 0; step < steps; step++)
+			{
+				physics->Update(bodies, 1.0f / 60.0f);
+			}
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / steps;
+			uint64_t hash = BenchScenes::HashPositions(bodies);
+			delete physics;
+
+			if (threads == 1)
+			{
+				singleThreaded = milliseconds;
+				singleThreadedHash = hash;
+			}
+			std::printf("%-16s %2u threads: %8.3f ms/step, %5.2fx, hash %016llx%s\n", broadPhase.name, threads, milliseconds,
+				singleThreaded / milliseconds, static_cast<unsigned long long>(hash), hash == singleThreadedHash ? "" : " DIFFERS");
+		}
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+// The broadphase tuner on a large settling pile: what it decided, and what the steps that ran
+// its trials cost next to the others. A trial builds every candidate broadphase from nothing, so
+// the slowest step shows whether any of them stalls on a scene this size.
+// Usage: TunerTrials [body count, default 20000] [steps, default 600]
+
+#include "BenchScenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+	uint32_t count = (argc > 1) ? static_cast<uint32_t>(std::atoi(argv[1])) : 20000;
+	int steps = (argc > 2) ? std::atoi(argv[2]) : 600;
+
+	Physics* physics = BenchScenes::MakePhysics();
+	physics->SetThreadCount(1);
+	physics->SetSleepEnabled(false);
+	physics->SetBroadPhaseAutoTune(true);
+	BodyStore bodies;
+	BenchScenes::AddPile(bodies, count, false);
+	std::printf("%zu bodies, %d steps, one thread\n", bodies.Size(), steps);
+
+	double total = 0.0;
+	double slowest = 0.0;
+	int slowestStep = 0;
+	uint64_t printed = 0;
+	for (int step = 0; step < steps; step++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		physics->Update(bodies, 1.0f / 60.0f);
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		total += milliseconds;
+		if (milliseconds > slowest)
+		{
+			slowest = milliseconds;
+			slowestStep = step;
+		}
+
+		for (const TunerDecision& decision : physics->GetBroadPhaseDecisions())
+		{
+			if (decision.number >= printed)
+			{
+				std::printf("step %3d (%8.3f ms): %s\n", step, milliseconds, decision.reason.c_str());
+				printed = decision.number + 1;
+			}
+		}
+	}
+
+	std::printf("%.3f ms/step, slowest step %d at %.3f ms, ended on %s\n", total / steps, slowestStep, slowest,
+		BroadPhaseTuner::TypeName(physics->GetBroadPhase()));
+	delete physics;
+	return 0;
+}
\ No newline at end of file
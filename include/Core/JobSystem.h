@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool.
+// Every thread has its own deque of jobs: index 0 belongs to the thread that created the
+// system, 1..n-1 to the workers. A thread pushes and pops at the back of its own deque and
+// when that runs dry steals from the front of another one, so jobs spawned together tend to
+// stay on one thread while idle threads still pick up the slack.
+// A thread that waits on a job keeps running queued jobs instead of blocking, which makes
+// it safe to wait from inside a job.
+class JobSystem
+{
+public:
+	struct Job;
+	using JobHandle = std::shared_ptr<Job>;
+	using JobFunction = std::function<void()>;
+	using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	unsigned int m_ThreadCount;
+	std::vector<std::thread> m_Workers;
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+
+	// Idle workers sleep on this until something is queued
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+	std::atomic<int> m_QueuedJobs;
+	std::atomic<bool> m_Stop;
+
+public:
+	// 0 uses every hardware thread. The calling thread counts as one of them
+	explicit JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	unsigned int GetThreadCount() const { return m_ThreadCount; }
+
+	// The job is only queued once every job in dependencies has finished
+	JobHandle Schedule(JobFunction function, const std::vector<JobHandle>& dependencies = {});
+	void Wait(const JobHandle& job);
+
+	// Splits [0, count) into chunks of grainSize and runs function on every chunk, returning
+	// once all of them are done. Chunk boundaries only depend on count and grainSize, never on
+	// the thread count, so per chunk output merged in chunk order is deterministic.
+	void ParallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function);
+
+private:
+	void WorkerLoop(unsigned int index);
+	void Enqueue(const JobHandle& job);
+	JobHandle PopJob(unsigned int index);
+	bool RunPendingJob();
+	void Finish(const JobHandle& job);
+	unsigned int CurrentQueue() const;
+};
\ No newline at end of file
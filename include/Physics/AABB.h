@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// Axis aligned bounding box in physics space (x already divided by the aspect ratio)
+struct AABB
+{
+	float minX, minY;
+	float maxX, maxY;
+};
+
+// Two body indices handed from the broadphase to the narrowphase, always with a < b
+struct BodyPair
+{
+	uint32_t a;
+	uint32_t b;
+};
+
+inline bool Overlaps(const AABB& first, const AABB& second)
+{
+	return first.minX < second.maxX && first.maxX > second.minX &&
+		first.minY < second.maxY && first.maxY > second.minY;
+}
\ No newline at end of file
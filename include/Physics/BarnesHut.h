@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+#include "Physics/AABB.h"
+#include "Physics/BodyStore.h"
+#include "Physics/MortonOrder.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform pulls every body down by the gravity setting, NBody has every body attract every
+// other body instead
+enum class GravityMode { Uniform, NBody };
+
+// What the last n-body step cost and how far the tree was from summing every pair
+struct NBodyStats
+{
+	uint32_t bodies;
+	uint32_t nodes;
+	uint32_t leaves;
+	// Tree nodes and bodies each body was pulled by, on average
+	float interactionsPerBody;
+	double buildMilliseconds;
+	double forceMilliseconds;
+};
+
+// Error of the tree accelerations against summing every pair over a sample of bodies, as a
+// fraction of the root mean square acceleration of the sample
+struct NBodyError
+{
+	uint32_t samples;
+	double rmsError;
+	double maxError;
+};
+
+// Barnes-Hut quadtree for n-body gravity.
+// Every step the bodies that have mass (not static, not sensors) are sorted by Morton code,
+// and the quadtree falls out of the sorted codes: a node at level L is the run of bodies whose
+// codes share the top 2L bits, and its children are the runs that split on the next 2 bits.
+// Nodes keep their total mass and centre of mass. The levels down to SplitLevel are built on
+// one thread, the subtrees below them in parallel into their own node arrays, which are then
+// joined into one array.
+// Forces are worked out per leaf: a node pulls as one point mass when its radius is below the
+// opening angle times its distance to the leaf's bounds, otherwise it is opened, down to the
+// leaves whose bodies pull one by one. The radius is from the centre of mass to the furthest
+// corner of the node's bounds rather than the cell size, which holds up better when the mass
+// sits to one side of the cell. The resulting list is shared by every body in the leaf and
+// summed by the wide attraction kernel. Softening keeps close pairs from blowing up.
+class BarnesHut
+{
+private:
+	struct Node
+	{
+		// Centre of mass and total mass of the bodies under the node, aspect corrected space
+		float massX;
+		float massY;
+		float mass;
+		// Distance from the centre of mass to the furthest corner of the bounds
+		float radius;
+		// Bounds of the node's bodies, tighter than its cell
+		AABB bounds;
+		// The node's bodies are [begin, end) of the sorted columns
+		uint32_t begin;
+		uint32_t end;
+		// Children sit next to each other, a leaf has none
+		uint32_t firstChild;
+		uint32_t childCount;
+	};
+
+	// A subtree at SplitLevel, built by one job
+	struct Subtree
+	{
+		uint32_t node;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	static const uint32_t LeafSize = 16;
+	static const uint32_t MaxLevel = 16;
+	static const uint32_t SplitLevel = 3;
+	static const uint32_t BodiesPerJob = 2048;
+	static const uint32_t LeavesPerJob = 16;
+
+	float m_OpeningAngle;
+	float m_Softening;
+
+	MortonOrder m_MortonOrder;
+	std::vector<float> m_UnsortedX;
+	std::vector<float> m_UnsortedY;
+	std::vector<uint32_t> m_UnsortedBodies;
+
+	// Bodies in code order, positions in aspect corrected space
+	std::vector<float> m_X;
+	std::vector<float> m_Y;
+	std::vector<float> m_Mass;
+	std::vector<uint32_t> m_Bodies;
+	std::vector<float> m_AccelerationX;
+	std::vector<float> m_AccelerationY;
+
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_Leaves;
+	std::vector<Subtree> m_Subtrees;
+	std::vector<std::vector<Node>> m_SubtreeNodes;
+	std::vector<uint64_t> m_ChunkInteractions;
+	NBodyStats m_Stats;
+
+public:
+	BarnesHut();
+
+	// Larger angles open fewer nodes, faster and less accurate; 0 sums every pair
+	void SetOpeningAngle(float angle) { m_OpeningAngle = angle; }
+	float GetOpeningAngle() const { return m_OpeningAngle; }
+	// Distance in aspect corrected space below which the pull stops growing
+	void SetSoftening(float softening) { m_Softening = softening; }
+	float GetSoftening() const { return m_Softening; }
+
+	void Build(const BodyStore& bodies, float aspectRatio, JobSystem& jobs);
+	// Works out the pull on every body in the tree, per unit gravitational constant
+	void ComputeAccelerations(JobSystem& jobs);
+
+	// Bodies in the tree and their acceleration, aspect corrected space
+	size_t Size() const { return m_Bodies.size(); }
+	uint32_t GetBody(size_t index) const { return m_Bodies[index]; }
+	float GetAccelerationX(size_t index) const { return m_AccelerationX[index]; }
+	float GetAccelerationY(size_t index) const { return m_AccelerationY[index]; }
+
+	const NBodyStats& GetStats() const { return m_Stats; }
+	// Sums every pair for sampleCount bodies spread over the tree, in double precision, and
+	// compares against the last ComputeAccelerations
+	NBodyError MeasureError(uint32_t sampleCount) const;
+
+private:
+	// Fills node with the bodies [begin, end) at level, and its children below it into nodes.
+	// Stops at stopLevel, recording the nodes left there as subtrees to build later
+	void BuildNode(std::vector<Node>& nodes, uint32_t node, uint32_t begin, uint32_t end, uint32_t level,
+		uint32_t stopLevel);
+	// Total mass, centre of mass and bounds of a node from its bodies or its children
+	void ComputeMass(std::vector<Node>& nodes, uint32_t node) const;
+};
\ No newline at end of file
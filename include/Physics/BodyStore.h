@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Physics/CollisionFilter.h"
+#include "Rendering/Renderer.h"
+#include <cstdint>
+#include <vector>
+
+// Stable reference to a body. Indices into the columns change when bodies are removed, a
+// handle doesn't: slot picks an entry in the handle table, and generation is bumped every
+// time that slot is freed so handles to a removed body stop resolving instead of quietly
+// pointing at whatever reuses the slot.
+struct BodyHandle
+{
+	uint32_t slot;
+	uint32_t generation;
+};
+
+// Structure of arrays storage for every body in the scene.
+// Physics loops walk the hot columns one field at a time, so they only pull in the cache
+// lines they actually use and the simple ones auto-vectorize. Everything only the renderer
+// needs lives in separate cold columns.
+// Shape is just the description a body is created from, it isn't stored anywhere.
+// Bodies are removed by moving the last body into the hole (swap and pop), so the columns
+// stay dense and removal is O(1); code that has to hold on to a body keeps a BodyHandle.
+class BodyStore
+{
+public:
+	// Hot columns, read and written by Physics every step
+	std::vector<float> x, y;
+	// Position at the start of the last step, rendering blends from here to x / y
+	std::vector<float> prevX, prevY;
+	std::vector<float> xVcty, yVcty;
+	// Precomputed so physics never redoes size / 3.5 or the aspect ratio divide;
+	// halfWidth is already in x units (divided by the aspect ratio)
+	std::vector<float> halfWidth, halfHeight;
+	// 0 for bodies that never move (ground and walls)
+	std::vector<float> invMass;
+	std::vector<ShapeType> type;
+	std::vector<uint8_t> noMovement;
+	// Sensors report overlaps (see Sensors) and are never pushed or push anything, including
+	// the ground and walls
+	std::vector<uint8_t> sensor;
+
+	// Sleep state, owned by Physics. island is the sleeping island a body belongs to and is
+	// only meaningful while asleep is set. restX / restY is where the body was when its sleep
+	// timer last restarted
+	std::vector<uint8_t> asleep;
+	std::vector<float> sleepTime;
+	std::vector<float> restX, restY;
+	std::vector<uint32_t> island;
+
+	// Packed CollisionFilter, read by the broadphase every step
+	std::vector<uint64_t> filter;
+
+	// Cold columns, only read when drawing
+	std::vector<float> size;
+	std::vector<float> width;
+	// RGBA8, red in the lowest byte
+	std::vector<uint32_t> color;
+
+	// Handle table slot of every body
+	std::vector<uint32_t> slot;
+
+	static constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+private:
+	float m_AspectRatio;
+
+	// Per slot: index of the body using it (InvalidIndex when free) and its generation
+	std::vector<uint32_t> m_SlotIndex;
+	std::vector<uint32_t> m_SlotGeneration;
+	std::vector<uint32_t> m_FreeSlots;
+
+public:
+	BodyStore();
+
+	BodyHandle Add(const Shape& shape);
+	// Does nothing for a handle that no longer resolves
+	void Remove(BodyHandle handle);
+	// The last body moves into index; walk backwards when removing during a loop
+	void RemoveAt(uint32_t index);
+	void Clear();
+	// Moves every body to a new index, order[i] is the index of the body that ends up at i.
+	// Handles keep resolving, indices from before don't
+	void Reorder(const std::vector<uint32_t>& order);
+	size_t Size() const { return x.size(); }
+
+	bool IsValid(BodyHandle handle) const;
+	// InvalidIndex for a handle that no longer resolves
+	uint32_t IndexOf(BodyHandle handle) const;
+	BodyHandle HandleAt(uint32_t index) const;
+
+	void SetAspectRatio(float aspectRatio);
+
+	void SetFilter(uint32_t index, const CollisionFilter& bodyFilter) { filter[index] = PackFilter(bodyFilter); }
+	CollisionFilter GetFilter(uint32_t index) const { return UnpackFilter(filter[index]); }
+
+	static uint32_t PackColor(float r, float g, float b, float a);
+	static void UnpackColor(uint32_t color, float& r, float& g, float& b, float& a);
+
+private:
+	void ComputeHalfExtents(uint32_t index);
+
+	template<typename T>
+	static void MoveLastTo(std::vector<T>& column, uint32_t index)
+	{
+		column[index] = column.back();
+		column.pop_back();
+	}
+
+	template<typename T>
+	static void Gather(std::vector<T>& column, const std::vector<uint32_t>& order)
+	{
+		std::vector<T> ordered(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			ordered[i] = column[order[i]];
+		}
+		column.swap(ordered);
+	}
+};
\ No newline at end of file
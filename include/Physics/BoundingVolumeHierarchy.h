@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Physics/AABB.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Bounding volume hierarchy over a fixed set of boxes, built in one go and then only read.
+// Boxes are split at the median of the longer axis until a few are left per leaf, nodes are
+// stored depth first so the left child of a node is the next node. Queries only read, so any
+// number of threads can run them at once.
+class BoundingVolumeHierarchy
+{
+private:
+	struct Node
+	{
+		AABB box;
+		// Leaves have count items from m_Order[first], inner nodes have count 0 and their
+		// right child at first
+		uint32_t first;
+		uint32_t count;
+	};
+
+	std::vector<AABB> m_Bounds;
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_Order;
+	float m_AspectRatio;
+
+	static const uint32_t ItemsPerLeaf = 4;
+
+public:
+	BoundingVolumeHierarchy();
+
+	// Item i is bounds[i]. The aspect ratio decides which side of a box is the longer one
+	void Build(const std::vector<AABB>& bounds, float aspectRatio);
+	void Clear();
+
+	// Items whose bounds touch box, in increasing order
+	void Query(const AABB& box, std::vector<uint32_t>& items) const;
+
+	// Walks the tree and calls visit(item) for the items of every leaf reached. enterNode(box)
+	// returns how far along the query first reaches a node's box, or a negative number if it
+	// doesn't. It is asked again before a node is opened, so a query that narrows as it finds
+	// things (a cast keeping its nearest hit) prunes the rest of the walk, and of two children
+	// the nearer one is opened first
+	template <typename EnterNode, typename Visit>
+	void Traverse(EnterNode enterNode, Visit visit) const
+	{
+		if (m_Nodes.empty())
+		{
+			return;
+		}
+
+		// Explicit stack, the tree is balanced so 64 levels is far more than needed
+		uint32_t stack[64];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0)
+		{
+			uint32_t nodeIndex = stack[--top];
+			const Node& node = m_Nodes[nodeIndex];
+			if (enterNode(node.box) < 0.0f)
+			{
+				continue;
+			}
+
+			if (node.count > 0)
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					visit(m_Order[i]);
+				}
+				continue;
+			}
+
+			// The farther child goes on the stack first so the nearer one is opened next
+			uint32_t near = nodeIndex + 1;
+			uint32_t far = node.first;
+			float nearDistance = enterNode(m_Nodes[near].box);
+			float farDistance = enterNode(m_Nodes[far].box);
+			if (farDistance >= 0.0f && (nearDistance < 0.0f || farDistance < nearDistance))
+			{
+				std::swap(near, far);
+				std::swap(nearDistance, farDistance);
+			}
+
+			if (farDistance >= 0.0f)
+			{
+				stack[top++] = far;
+			}
+			if (nearDistance >= 0.0f)
+			{
+				stack[top++] = near;
+			}
+		}
+	}
+
+	size_t Size() const { return m_Bounds.size(); }
+	const AABB& GetBounds(uint32_t item) const { return m_Bounds[item]; }
+
+private:
+	void BuildNode(uint32_t begin, uint32_t end);
+};
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+#include "Physics/AABB.h"
+#include "Physics/CollisionFilter.h"
+#include <atomic>
+#include <vector>
+
+enum class BroadPhaseType { BruteForce, UniformGrid, SweepAndPrune, DynamicTree };
+
+// Finds the pairs of bodies whose bounds overlap so the narrowphase only runs on those.
+// Proxy ids are indices into the bounds array and must stay stable between updates;
+// implementations that keep state across steps rely on it.
+// Pairs whose collision filters don't match are dropped where they are found, so they never
+// reach the narrowphase.
+class BroadPhase
+{
+protected:
+	// Packed CollisionFilter of every proxy, null lets every pair through
+	const uint64_t* m_Filters;
+	// Pairs the filters dropped since SetFilters, chunks add their count once when done
+	mutable std::atomic<uint32_t> m_FilteredPairs;
+
+public:
+	BroadPhase() : m_Filters(nullptr), m_FilteredPairs(0) {}
+	virtual ~BroadPhase() {}
+
+	// Filters indexed like the bounds, they have to stay alive until the pairs are found.
+	// Also restarts the filtered pair count
+	void SetFilters(const uint64_t* filters)
+	{
+		m_Filters = filters;
+		m_FilteredPairs.store(0, std::memory_order_relaxed);
+	}
+	uint32_t GetFilteredPairCount() const { return m_FilteredPairs.load(std::memory_order_relaxed); }
+
+	virtual void Update(const std::vector<AABB>& bounds) = 0;
+	// Same result as Update for any thread count, implementations that can split the build
+	// override this
+	virtual void UpdateParallel(const std::vector<AABB>& bounds, JobSystem& /*jobs*/) { Update(bounds); }
+	// Pairs come out sorted by (a, b), the same order the old nested pair loop used
+	virtual void FindPairs(std::vector<BodyPair>& pairs) const = 0;
+	// Same result as FindPairs for any thread count, implementations that can split the
+	// search override this
+	virtual void FindPairsParallel(std::vector<BodyPair>& pairs, JobSystem& /*jobs*/) const { FindPairs(pairs); }
+	// Drops whatever was kept from earlier steps, for when the proxy ids have all changed (the
+	// bodies were reordered). The next Update starts from nothing
+	virtual void Reset() {}
+
+protected:
+	bool Accepts(uint32_t first, uint32_t second) const
+	{
+		return !m_Filters || CanCollide(m_Filters[first], m_Filters[second]);
+	}
+	void AddFilteredPairs(uint32_t count) const
+	{
+		if (count > 0)
+		{
+			m_FilteredPairs.fetch_add(count, std::memory_order_relaxed);
+		}
+	}
+};
+
+// The original O(n^2) pair loop, kept around to compare the other broadphases against
+class BruteForceBroadPhase : public BroadPhase
+{
+private:
+	const std::vector<AABB>* m_Bounds;
+
+public:
+	BruteForceBroadPhase();
+
+	void Update(const std::vector<AABB>& bounds) override;
+	void FindPairs(std::vector<BodyPair>& pairs) const override;
+};
+
+BroadPhase* CreateBroadPhase(BroadPhaseType type);
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Physics/AABB.h"
+#include "Physics/BroadPhase.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// One broadphase setting. cellSize is only used by the grid, 0 sizes cells by the largest body
+struct BroadPhaseConfig
+{
+	BroadPhaseType type;
+	float cellSize;
+};
+
+// Something the tuner did and why, with the numbers it was based on. Decisions are numbered in
+// the order they were made, so readers can tell which ones they have seen after old ones are
+// dropped
+struct TunerDecision
+{
+	uint64_t number;
+	uint64_t step;
+	BroadPhaseConfig config;
+	std::string reason;
+};
+
+// Picks the broadphase and grid cell size while the simulation runs.
+// Every step it is told what the broadphase and the pair tests cost, and it samples the bodies:
+// how many, their mean and largest size and how much of the occupied area they cover. Every
+// CheckInterval steps it looks at whether the scene has drifted from what it was tuned for
+// (or RetuneInterval steps have passed). If it has, and the broadphase is a big enough share of
+// the collision time to be worth it, every candidate is run for TrialSteps steps: the grid at a
+// few cell sizes around the bodies' sizes, sweep and prune, the dynamic tree, and brute force
+// for small scenes. Candidates that are clearly slower than the best so far are cut short, and
+// types that lost badly last time are left out while the body count is about the same. The
+// fastest one is kept if it beats the current setting by Hysteresis.
+// The broadphases all return the same pairs, so switching never changes the simulation.
+class BroadPhaseTuner
+{
+public:
+	struct Features
+	{
+		uint32_t bodies;
+		float meanExtent;
+		float largestExtent;
+		// Summed body area over the area of the box around all bodies
+		float density;
+	};
+
+private:
+	static const int BroadPhaseTypeCount = 4;
+
+	BroadPhaseConfig m_Current;
+	Features m_Features;
+	Features m_TunedFeatures;
+	uint64_t m_Step;
+	uint64_t m_LastTuneStep;
+
+	// Per step averages with the current setting
+	double m_BroadPhaseMilliseconds;
+	double m_PairTestMilliseconds;
+
+	// Trial state, m_Trial is the candidate running now
+	bool m_Trialling;
+	std::vector<BroadPhaseConfig> m_Candidates;
+	// Summed time and steps measured per candidate
+	std::vector<double> m_CandidateMilliseconds;
+	std::vector<int> m_CandidateSteps;
+
+	// How many times slower than the winner each type was in the last trials, and with how many
+	// bodies. Types far behind aren't tried again until the body count has changed a lot
+	double m_TypeSlowdown[BroadPhaseTypeCount];
+	uint32_t m_TypeBodies[BroadPhaseTypeCount];
+	size_t m_Trial;
+	int m_TrialStep;
+
+	// The latest MaxDecisions decisions, and how many were made in all
+	std::deque<TunerDecision> m_Decisions;
+	uint64_t m_DecisionCount;
+
+	static const int CheckInterval = 120;
+	static const int RetuneInterval = 1800;
+	// The first trial step of a candidate builds it from nothing, so it isn't counted
+	static const int TrialSteps = 6;
+	static const uint32_t BruteForceBodies = 128;
+	static const size_t MaxDecisions = 64;
+	static constexpr float Drift = 0.25f;
+	static constexpr float Hysteresis = 0.1f;
+	// A candidate this much slower than the best so far is dropped after one measured step
+	static constexpr float GiveUp = 1.5f;
+	static constexpr float SkipSlowdown = 2.0f;
+	// Broadphases taking less of the collision time than this aren't worth trials
+	static constexpr float MinShare = 0.1f;
+
+public:
+	BroadPhaseTuner();
+
+	// Starts tuning from config, the tuner takes it as what is running now
+	void Reset(const BroadPhaseConfig& config);
+	// Call once per step after the collision phase with what it cost. Returns the setting to
+	// use from the next step on
+	BroadPhaseConfig Sample(const std::vector<AABB>& bounds, double broadPhaseMilliseconds,
+		double pairTestMilliseconds);
+
+	const Features& GetFeatures() const { return m_Features; }
+	const std::deque<TunerDecision>& GetDecisions() const { return m_Decisions; }
+
+	static const char* TypeName(BroadPhaseType type);
+
+private:
+	static Features Measure(const std::vector<AABB>& bounds);
+	bool HasDrifted() const;
+	void StartTrials();
+	void FinishTrials();
+	void Log(const BroadPhaseConfig& config, const std::string& reason);
+};
\ No newline at end of file
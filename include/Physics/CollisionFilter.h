@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Decides which bodies collide at all.
+// A body belongs to the categories set in category and collides with the categories set in
+// mask; two bodies collide only if each one's mask has a category of the other. A non-zero
+// group overrides that between bodies of the same group: a positive group always collides, a
+// negative one never does (parts of one object that shouldn't push each other apart).
+struct CollisionFilter
+{
+	uint16_t category;
+	uint16_t mask;
+	int32_t group;
+};
+
+// What every body starts with: collides with everything
+constexpr CollisionFilter DefaultCollisionFilter = { 0x0001, 0xFFFF, 0 };
+
+// Packed as category | mask << 16 | group << 32 so the broadphase reads one word per body
+inline uint64_t PackFilter(const CollisionFilter& filter)
+{
+	return uint64_t(filter.category) | (uint64_t(filter.mask) << 16) |
+		(uint64_t(static_cast<uint32_t>(filter.group)) << 32);
+}
+
+inline CollisionFilter UnpackFilter(uint64_t packed)
+{
+	return { static_cast<uint16_t>(packed), static_cast<uint16_t>(packed >> 16),
+		static_cast<int32_t>(static_cast<uint32_t>(packed >> 32)) };
+}
+
+inline bool CanCollide(uint64_t first, uint64_t second)
+{
+	// Swapping the halves of second lines its mask up with the category of first and its
+	// category with the mask of first, one AND then tests both directions
+	uint32_t bits = static_cast<uint32_t>(second);
+	bits = static_cast<uint32_t>(first) & ((bits << 16) | (bits >> 16));
+	bool categories = ((bits & 0xFFFF) != 0) & ((bits >> 16) != 0);
+
+	// The group is an equality test whose answer depends on its sign, so it can't join the AND;
+	// it is combined without branching instead, pair loops then have nothing to mispredict
+	uint32_t group = static_cast<uint32_t>(first >> 32);
+	bool sameGroup = (group != 0) & (group == static_cast<uint32_t>(second >> 32));
+	bool positive = static_cast<int32_t>(group) > 0;
+	return (sameGroup & positive) | (!sameGroup & categories);
+}
\ No newline at end of file
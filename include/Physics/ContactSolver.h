@@ -0,0 +1,182 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+#include "Physics/BodyStore.h"
+#include "Physics/SimdKernels.h"
+#include <cstdint>
+#include <vector>
+
+// One contact point between two bodies, or between a body and static geometry (ground or a
+// wall, b is StaticBody). Bodies only translate, so one point along the normal is the whole
+// manifold.
+struct ContactConstraint
+{
+	uint32_t a;
+	uint32_t b;
+	// Identifies the contact across steps: body slots, or the body slot and the static feature
+	uint64_t key;
+	uint32_t generationA;
+	uint32_t generationB;
+
+	// Normal from a to b in aspect corrected space, overlap is the depth when it was found
+	float normalX;
+	float normalY;
+	float overlap;
+	float restitution;
+
+	// Filled in by Prepare
+	float invMassA;
+	float invMassB;
+	float normalMass;
+	// Relative normal velocity before any impulses, what the bounce is worked out from
+	float approachVelocity;
+	float normalImpulse;
+	// Friction along the normal turned a quarter, (-normalY, normalX)
+	float tangentImpulse;
+};
+
+// Impulse runs velocity iterations then position iterations once per step. Substep splits the
+// step into several short ones and moves the bodies apart directly in each (XPBD), solving
+// every contact once per substep
+enum class SolverType { Impulse, Substep };
+
+// What the last velocity solve cost, contacts per millisecond counts every contact once per
+// iteration (or substep)
+struct SolverStats
+{
+	uint32_t contacts;
+	uint32_t colours;
+	uint32_t overflow;
+	int velocityIterations;
+	double velocityMilliseconds;
+	double contactsPerMillisecond;
+};
+
+// Sequential impulse contact solver.
+// Contacts are found at the start of the step. The velocity pass pushes the relative normal
+// velocity of every contact towards zero over several iterations, clamping the impulse each
+// contact has accumulated so far so it can only push. The accumulated impulses are kept between
+// steps keyed by body pair and applied up front the next step (warm starting), so a resting
+// stack starts out already holding itself up instead of rebuilding the support from nothing
+// every step. Bounces are added in one pass afterwards and left out of the kept impulses,
+// otherwise a bounce would be applied again on the next step. The position pass then removes
+// whatever overlap is left, a fraction per iteration.
+// Before solving, contacts are coloured so that no two contacts of one colour share a body.
+// A colour can then be solved across threads without locks, colour after colour. Contacts
+// of bodies touching too many others to find a free colour go in an overflow colour that is
+// solved on one thread. Colouring doesn't depend on the thread count, so neither does the result.
+// The velocity iterations run on a copy of the hot contact data laid out in columns, so the
+// SIMD kernel can take 8 (AVX2) or 4 (SSE) contacts of one colour at a time: they never share
+// a body, so their velocities can be gathered, solved side by side and scattered back.
+// The same contacts can instead be solved in substeps (extended position based dynamics).
+// Each substep the caller moves the bodies, the position pass pushes them apart in one go
+// (softened by the compliance), the caller turns the distance moved into velocities, and the
+// velocity pass adds friction and bounces. Contacts are not searched for again between
+// substeps, their overlap is tracked from how far the bodies moved.
+class ContactSolver
+{
+public:
+	static constexpr uint32_t StaticBody = 0xFFFFFFFF;
+
+private:
+	struct CachedImpulse
+	{
+		uint64_t key;
+		uint32_t generationA;
+		uint32_t generationB;
+		float normalImpulse;
+		float tangentImpulse;
+	};
+
+	float m_AspectRatio;
+	int m_VelocityIterations;
+	int m_PositionIterations;
+	bool m_WarmStarting;
+	float m_Friction;
+	// Contact softness for the substep solver, 0 is rigid
+	float m_Compliance;
+	// Fastest the substep solver pushes overlapping bodies apart, in units per second
+	float m_MaxPushVelocity;
+
+	// Slower approaches than this don't bounce, otherwise resting contacts never settle
+	float m_RestitutionThreshold;
+	// Overlap left alone so contacts stay touching between steps
+	float m_Slop;
+	// Fraction of the overlap removed per position iteration, and the most moved at once
+	float m_Baumgarte;
+	float m_MaxCorrection;
+
+	std::vector<ContactConstraint> m_Contacts;
+	// Impulses from the last step, sorted by key
+	std::vector<CachedImpulse> m_Cache;
+
+	// Colours used by the contacts of each body as a bit mask, and where each colour starts in
+	// m_Contacts once sorted. The colour after the last real one is the overflow
+	static const uint32_t ColourCount = 16;
+	static const uint32_t ContactsPerJob = 256;
+	std::vector<uint32_t> m_BodyColours;
+	std::vector<uint8_t> m_ContactColour;
+	std::vector<uint32_t> m_ColourStart;
+	std::vector<ContactConstraint> m_SortedContacts;
+
+	// m_Contacts in columns for the velocity kernel, impulses are copied back after solving
+	ContactColumns m_Columns;
+	SolverStats m_Stats;
+
+public:
+	explicit ContactSolver(float aspectRatio);
+
+	void SetIterations(int velocityIterations, int positionIterations);
+	void SetWarmStarting(bool enabled);
+	// Coulomb friction, the tangent impulse is kept within friction times the normal impulse
+	void SetFriction(float friction);
+	void SetCompliance(float compliance);
+	int GetVelocityIterations() const { return m_VelocityIterations; }
+	int GetPositionIterations() const { return m_PositionIterations; }
+
+	// Contacts are built with these and added, possibly from per thread buffers.
+	// feature tells apart the pieces of static geometry a body can touch
+	static ContactConstraint MakeContact(const BodyStore& bodies, uint32_t a, uint32_t b,
+		float normalX, float normalY, float overlap, float restitution);
+	static ContactConstraint MakeStaticContact(const BodyStore& bodies, uint32_t a, uint32_t feature,
+		float normalX, float normalY, float overlap, float restitution);
+
+	void Clear() { m_Contacts.clear(); }
+	void AddContact(const ContactConstraint& contact) { m_Contacts.push_back(contact); }
+	void AddContacts(const std::vector<ContactConstraint>& contacts);
+
+	const std::vector<ContactConstraint>& GetContacts() const { return m_Contacts; }
+
+	// Call order for a step: Prepare after gravity, SolveVelocities (bounces included), move
+	// the bodies, SolvePositions, then StoreImpulses
+	void Prepare(BodyStore& bodies, JobSystem& jobs);
+	void SolveVelocities(BodyStore& bodies, JobSystem& jobs);
+	// Overlap is tracked from how far the bodies moved since prevX / prevY
+	void SolvePositions(BodyStore& bodies, JobSystem& jobs);
+	void StoreImpulses();
+
+	// Call order for a substep step: PrepareSubsteps once, then every substep
+	// StoreApproachVelocities, move the bodies, SolveSubstepPositions, set the velocities from
+	// how far the bodies moved and SolveSubstepVelocities
+	void PrepareSubsteps(BodyStore& bodies, JobSystem& jobs);
+	void StoreApproachVelocities(const BodyStore& bodies, JobSystem& jobs);
+	void SolveSubstepPositions(BodyStore& bodies, JobSystem& jobs, float h);
+	void SolveSubstepVelocities(BodyStore& bodies, JobSystem& jobs, float h, float gravity);
+
+	// Colours in use this step, not counting the overflow, and how many contacts overflowed
+	uint32_t GetColourCount() const;
+	uint32_t GetOverflowCount() const;
+	const SolverStats& GetStats() const { return m_Stats; }
+
+private:
+	void Colour(uint32_t bodyCount);
+	// Calls function on ranges of m_Contacts, one colour at a time
+	void ForEachColour(JobSystem& jobs, const JobSystem::RangeFunction& function);
+	// Relative velocity of b to a along the normal, in aspect corrected space
+	float NormalVelocity(const BodyStore& bodies, const ContactConstraint& contact) const;
+	// Overlap now, from the overlap when found and how far the bodies moved since prevX / prevY
+	float CurrentOverlap(const BodyStore& bodies, const ContactConstraint& contact) const;
+	// Adds one velocity pass that took milliseconds to the stats
+	void RecordPass(double milliseconds);
+	void ApplyImpulse(BodyStore& bodies, const ContactConstraint& contact, float normalImpulse, float tangentImpulse);
+};
\ No newline at end of file
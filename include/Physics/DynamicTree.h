@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Physics/BroadPhase.h"
+#include <vector>
+
+// Dynamic bounding volume tree broadphase.
+// Every proxy is a leaf holding a fattened copy of its bounds, so a body that stays inside
+// its fat box costs nothing to update. When it leaves, the leaf is removed and reinserted
+// and the path back to the root is rebalanced with tree rotations. Unlike the grid it
+// doesn't care how much body sizes vary.
+// Nodes live in one flat pool and link to each other by index; freed nodes are chained
+// into a free list and reused.
+class DynamicTree : public BroadPhase
+{
+private:
+	static constexpr int32_t NullNode = -1;
+
+	struct Node
+	{
+		AABB box;
+		// Parent link, or the next free node while the node is on the free list
+		int32_t parent;
+		int32_t child1;
+		int32_t child2;
+		// Leaf = 0, free node = -1
+		int32_t height;
+		uint32_t proxy;
+	};
+
+	std::vector<Node> m_Nodes;
+	int32_t m_Root;
+	int32_t m_FreeList;
+
+	std::vector<int32_t> m_ProxyLeaf;
+	const std::vector<AABB>* m_Bounds;
+	mutable std::vector<std::vector<BodyPair>> m_ChunkPairs;
+
+	// How far the stored boxes are grown past the real bounds
+	float m_Margin;
+
+	// Proxies queried per job in FindPairsParallel
+	static const uint32_t ProxiesPerJob = 256;
+
+public:
+	DynamicTree();
+
+	void Update(const std::vector<AABB>& bounds) override;
+	void FindPairs(std::vector<BodyPair>& pairs) const override;
+	void FindPairsParallel(std::vector<BodyPair>& pairs, JobSystem& jobs) const override;
+	void Reset() override;
+
+	// Queries against the bounds passed to the last Update, all O(log n) for small results
+	void QueryPoint(float x, float y, std::vector<uint32_t>& proxies) const;
+	void QueryAABB(const AABB& box, std::vector<uint32_t>& proxies) const;
+	void QueryRay(float x1, float y1, float x2, float y2, std::vector<uint32_t>& proxies) const;
+
+	int32_t GetHeight() const;
+	void SetMargin(float margin);
+	bool IsEmpty() const { return m_Root == NullNode; }
+
+	// For trees kept by hand instead of through Update, where the proxy ids don't have to be
+	// dense. bounds is read like the one passed to Update and has to outlive the tree
+	void SetBounds(const std::vector<AABB>& bounds) { m_Bounds = &bounds; }
+	// Puts the proxy in at its current bounds, moving it if it's already in
+	void InsertProxy(uint32_t proxy);
+	// Returns false, doing nothing, for a proxy that isn't in
+	bool RemoveProxy(uint32_t proxy);
+
+private:
+	int32_t AllocateNode();
+	void FreeNode(int32_t node);
+
+	void CreateProxy(uint32_t proxy);
+	void DestroyProxy(uint32_t proxy);
+
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	void Refit(int32_t node);
+	int32_t Balance(int32_t node);
+	void FindPairsForProxies(uint32_t firstProxy, uint32_t lastProxy, std::vector<BodyPair>& pairs) const;
+
+	bool IsLeaf(int32_t node) const { return m_Nodes[node].child1 == NullNode; }
+	AABB Fatten(const AABB& box) const;
+};
\ No newline at end of file
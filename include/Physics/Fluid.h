@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+#include "Physics/AABB.h"
+#include "Physics/SimdKernels.h"
+#include "Physics/StaticGeometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What the last fluid step did. densityError is the average compression of the particles
+// over the rest density, which stays small while the stiffness and substeps are right
+struct FluidStats
+{
+	uint32_t particles;
+	float neighboursPerParticle;
+	float densityError;
+	double milliseconds;
+};
+
+// Smoothed particle hydrodynamics fluid (weakly compressible).
+// Every particle carries a share of the fluid's mass. Density is summed from the neighbours
+// within the smoothing radius (spiky kernel), pressure follows from how far it is above the
+// rest density, and particles are pushed by the pressure difference (gradient of the same
+// kernel) and dragged towards their neighbours' velocity (viscosity kernel). The fluid collides
+// with the ground and walls but not with bodies.
+// Neighbours are found with a cell linked list: a grid with cells as large as the smoothing
+// radius, and the particle columns themselves sorted by cell every substep (counting sort).
+// A cell's particles are then one run of the columns, and so is every row of three cells
+// around a particle, so the neighbour loops read memory in order.
+// Pressure needs small steps to stay stable, so each Step runs several substeps; the density
+// and force passes split the particles across threads and only write their own particles,
+// and run the wide kernels from SimdKernels over each run of neighbours.
+class Fluid
+{
+public:
+	// Particle columns in physics space (x already divided by the aspect ratio), like BodyStore.
+	// Reordered every substep, so a particle index is only good until the next Step
+	std::vector<float> x, y;
+	// Position at the start of the last step, rendering blends from here to x / y
+	std::vector<float> prevX, prevY;
+	std::vector<float> xVcty, yVcty;
+
+private:
+	static const uint32_t ParticlesPerJob = 1024;
+
+	float m_AspectRatio;
+	// Aspect corrected space
+	float m_SmoothingRadius;
+	float m_RestDensity;
+	float m_Stiffness;
+	float m_Viscosity;
+	int m_Substeps;
+	// Worked out from the smoothing radius so particles at rest spacing sit at rest density
+	float m_ParticleMass;
+	float m_Spacing;
+
+	// Neighbour grid over the particles' bounds, rebuilt every substep
+	float m_GridMinX;
+	float m_GridMinY;
+	uint32_t m_CellsX;
+	uint32_t m_CellsY;
+	std::vector<uint32_t> m_CellStart;
+	std::vector<uint32_t> m_ParticleCell;
+	std::vector<uint32_t> m_Order;
+	std::vector<float> m_Scratch;
+
+	std::vector<float> m_InverseDensity;
+	// Pressure over density squared, what the force kernel wants
+	std::vector<float> m_PressureTerm;
+	std::vector<float> m_AccelerationX;
+	std::vector<float> m_AccelerationY;
+	std::vector<uint32_t> m_ChunkNeighbours;
+	std::vector<float> m_ChunkDensityError;
+	FluidStats m_Stats;
+
+public:
+	explicit Fluid(float aspectRatio);
+
+	void AddParticle(float particleX, float particleY, float particleXVcty, float particleYVcty);
+	// Fills the box with particles at rest spacing, centre and size in physics space
+	void AddBlock(float centreX, float centreY, float width, float height);
+	void Clear();
+	size_t Size() const { return x.size(); }
+
+	// Changing the smoothing radius changes the rest spacing and the particle mass with it
+	void SetSmoothingRadius(float radius);
+	void SetStiffness(float stiffness) { m_Stiffness = stiffness; }
+	void SetViscosity(float viscosity) { m_Viscosity = viscosity; }
+	void SetSubsteps(int substeps) { m_Substeps = substeps; }
+	// Half the rest spacing, what a particle is drawn and collides as
+	float GetParticleRadius() const { return m_Spacing * 0.5f; }
+	const FluidStats& GetStats() const { return m_Stats; }
+
+	// ground is the ground's box in physics space; like the bodies, particles below its top
+	// within its width are pushed up onto it
+	void Step(float dt, float gravity, const AABB& ground, const StaticGeometry& walls, JobSystem& jobs);
+
+private:
+	// Sorts the particle columns by grid cell and fills m_CellStart
+	void SortIntoCells();
+	// The runs of particles in the three cell rows around a point in aspect corrected space
+	FluidRuns FindNeighbourRuns(float particleX, float particleY) const;
+	void ComputeDensities(JobSystem& jobs);
+	void ComputeAccelerations(float gravity, JobSystem& jobs);
+	void Integrate(float h, const AABB& ground, const StaticGeometry& walls, JobSystem& jobs);
+	void RemoveOutOfFrame();
+	void Gather(std::vector<float>& column);
+};
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+#include "Physics/AABB.h"
+#include "Physics/StaticGeometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What the last grid fluid step cost and how well the pressure solve did. Divergence is the
+// root mean square over the fluid cells, in cells per step, before and after the projection
+struct GridFluidStats
+{
+	uint32_t cellsX;
+	uint32_t cellsY;
+	uint32_t levels;
+	int vCycles;
+	float divergenceBefore;
+	float divergenceAfter;
+	double advectMilliseconds;
+	double projectMilliseconds;
+	double milliseconds;
+};
+
+// Eulerian fluid on a grid (stable fluids), for wind and smoke rather than water.
+// Velocities live on the cell faces (a MAC grid): u on the vertical faces, v on the horizontal
+// ones, dye in the cell centres, all in aspect corrected space on square cells. The grid spans
+// physics x from -1 to 1 and goes up from y = -1, the ground and walls are solid cells and the
+// edges of the grid are closed.
+// A step moves the velocities along themselves (semi-Lagrangian: every sample traces back
+// along the velocity and takes the bilinear value it lands on, which is stable for any step),
+// then makes the field divergence free by solving for a pressure and subtracting its gradient,
+// then moves the dye along the new field.
+// The pressure solve is a multigrid V-cycle: red-black Gauss-Seidel smoothing, the residual
+// summed into a grid of half the resolution, solved there the same way down to a few cells,
+// and the correction added back. Solid faces have weight 0 in the pressure equation, coarse
+// faces average the two fine faces they cover. The pressure is kept between steps as the
+// starting guess, so one V-cycle a step is usually enough.
+// Advection samples a row at a time with SampleGrid and the smoothing relaxes a row at a time
+// with RelaxPressureRow, both SIMD kernels. Every pass splits the rows across the job system;
+// red and black cells never read each other, so a colour is safe to update in parallel.
+class GridFluid
+{
+private:
+	// One level of the multigrid hierarchy, level 0 is the grid itself
+	struct Level
+	{
+		uint32_t cellsX;
+		uint32_t cellsY;
+		// Face weights in the pressure equation, 1 between two fluid cells and 0 next to a solid
+		// or the edge. weightX has (cellsX + 1) * cellsY faces, weightY cellsX * (cellsY + 1)
+		std::vector<float> weightX;
+		std::vector<float> weightY;
+		// Sum of a cell's face weights, 0 for solid cells, and its inverse (also 0 for solids)
+		std::vector<float> diagonal;
+		std::vector<float> inverseDiagonal;
+		std::vector<float> pressure;
+		std::vector<float> rhs;
+		std::vector<float> residual;
+	};
+
+	static const uint32_t RowsPerJob = 16;
+	static const uint32_t CoarsestCells = 64;
+	static const int CoarsestIterations = 50;
+
+	float m_AspectRatio;
+	uint32_t m_CellsX;
+	uint32_t m_CellsY;
+	// Aspect corrected space
+	float m_CellSize;
+	float m_OriginX;
+	float m_OriginY;
+
+	// Velocities in aspect corrected units per second
+	std::vector<float> m_U;
+	std::vector<float> m_V;
+	std::vector<float> m_Dye;
+	std::vector<float> m_PreviousU;
+	std::vector<float> m_PreviousV;
+	std::vector<float> m_PreviousDye;
+	std::vector<uint8_t> m_Solid;
+	std::vector<Level> m_Levels;
+	// Scratch rows for the advection and partial sums, one per chunk of rows
+	std::vector<std::vector<float>> m_ChunkRows;
+	std::vector<double> m_ChunkSums;
+	uint32_t m_FluidCells;
+
+	int m_VCycles;
+	int m_Smoothing;
+	// Fraction of the dye left after a second
+	float m_DyeFade;
+	GridFluidStats m_Stats;
+
+public:
+	// cellsX cells across the width of the screen, cellsY cells of the same size upwards. With
+	// 0 cells nothing is allocated, the grid can't be used until SetResolution
+	GridFluid(float aspectRatio, uint32_t cellsX, uint32_t cellsY);
+
+	void SetResolution(uint32_t cellsX, uint32_t cellsY);
+	uint32_t GetCellsX() const { return m_CellsX; }
+	uint32_t GetCellsY() const { return m_CellsY; }
+	float GetCellSize() const { return m_CellSize; }
+	void SetVCycles(int vCycles) { m_VCycles = vCycles; }
+	void SetDyeFade(float fade) { m_DyeFade = fade; }
+	const GridFluidStats& GetStats() const { return m_Stats; }
+
+	// Marks the cells under the ground and walls (physics space) as solid
+	void SetObstacles(const AABB& ground, const StaticGeometry& walls);
+	// Sets the velocity (physics units per second) of the fluid faces within radius of a point,
+	// or adds dye to the cells there. Positions in physics space, the radius in y units
+	void AddVelocity(float x, float y, float radius, float xVcty, float yVcty);
+	void AddDye(float x, float y, float radius, float amount);
+	void Clear();
+
+	// Velocity at a point in physics space and physics units per second, 0 outside the grid
+	void SampleVelocity(float x, float y, float& xVcty, float& yVcty) const;
+	// Dye of a cell, cells are numbered from the bottom left
+	float GetDye(uint32_t cellX, uint32_t cellY) const { return m_Dye[cellY * m_CellsX + cellX]; }
+	// Centre of a cell in physics space
+	float GetCellX(uint32_t cellX) const { return (m_OriginX + (cellX + 0.5f) * m_CellSize) / m_AspectRatio; }
+	float GetCellY(uint32_t cellY) const { return m_OriginY + (cellY + 0.5f) * m_CellSize; }
+
+	void Step(float dt, JobSystem& jobs);
+
+private:
+	void BuildLevels();
+	void AdvectVelocity(float dt, JobSystem& jobs);
+	void AdvectDye(float dt, JobSystem& jobs);
+	void Project(float dt, JobSystem& jobs);
+	// Fills level 0's rhs with the divergence of every fluid cell (0 for solids) and returns
+	// its root mean square over the fluid cells
+	float ComputeDivergence(JobSystem& jobs);
+
+	// Multigrid pieces, all on one level
+	void Smooth(Level& level, int iterations, JobSystem& jobs);
+	void ComputeResidual(Level& level, JobSystem& jobs);
+	void Restrict(const Level& fine, Level& coarse, JobSystem& jobs);
+	void Prolong(const Level& coarse, Level& fine, JobSystem& jobs);
+	void VCycle(uint32_t levelIndex, JobSystem& jobs);
+};
\ No newline at end of file
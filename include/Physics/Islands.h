@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Groups bodies into islands, sets of bodies connected through contacts.
+// Contacts are merged with a union-find (union by size, path halving) and the result is laid
+// out like the grid cells: every island is a contiguous run of m_IslandBodies starting at
+// m_IslandStart[island], bodies in the order they were passed to Build.
+class Islands
+{
+private:
+	std::vector<uint32_t> m_Parent;
+	std::vector<uint32_t> m_Size;
+
+	// Island of each root body, and of each body passed to Build
+	std::vector<uint32_t> m_RootIsland;
+	std::vector<uint32_t> m_ListedIsland;
+	std::vector<uint32_t> m_IslandStart;
+	std::vector<uint32_t> m_IslandBodies;
+
+public:
+	// Every body starts out as its own island
+	void Reset(uint32_t bodyCount);
+	void Link(uint32_t first, uint32_t second);
+	uint32_t Find(uint32_t body);
+
+	// Lays the islands out; only the bodies listed in bodies are included
+	void Build(const std::vector<uint32_t>& bodies);
+
+	uint32_t IslandCount() const { return static_cast<uint32_t>(m_IslandStart.size()) - 1; }
+	const uint32_t* IslandBegin(uint32_t island) const { return m_IslandBodies.data() + m_IslandStart[island]; }
+	const uint32_t* IslandEnd(uint32_t island) const { return m_IslandBodies.data() + m_IslandStart[island + 1]; }
+};
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sorts bodies along a Z-order (Morton) curve of their positions.
+// Positions are snapped to a 65536 x 65536 grid over the bounds of all bodies, with square
+// cells in aspect corrected space, and the bits of the two cell coordinates are interleaved
+// into one 32 bit code. Bodies close in space get close codes, so once the body columns are
+// in code order the bodies a broadphase cell or a contact touches sit next to each other in
+// memory. The sort is a least significant digit radix sort, 8 bits per pass, O(n) and stable.
+class MortonOrder
+{
+private:
+	std::vector<uint32_t> m_Codes;
+	std::vector<uint32_t> m_CodeScratch;
+	std::vector<uint32_t> m_Order;
+	std::vector<uint32_t> m_OrderScratch;
+	// Side of the square the grid covers, in aspect corrected space
+	float m_Extent;
+
+public:
+	MortonOrder() : m_Extent(0.0f) {}
+
+	// Works out the code of every position. Returns the fraction of neighbouring bodies that
+	// are out of code order, 0 when the bodies are already sorted
+	float Compute(const float* x, const float* y, size_t count, float aspectRatio);
+	// Body indices in code order, ties keep their current order. Call after Compute
+	const std::vector<uint32_t>& Sort();
+	// The codes, in code order once sorted
+	const std::vector<uint32_t>& GetCodes() const { return m_Codes; }
+	float GetExtent() const { return m_Extent; }
+
+	// Interleaves the low 16 bits of x and y, x in the even bits
+	static uint32_t Encode(uint32_t x, uint32_t y);
+};
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Physics/AABB.h"
+#include "Physics/BodyStore.h"
+#include "Physics/SimdKernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Exact contact tests between bodies.
+// Only circles and squares collide with each other, so a candidate pair is one of three kinds.
+// The broadphase pairs are sorted into one bucket per kind first, then each bucket goes to the
+// kernel for its kind through a table built at compile time. A kernel only ever sees one pair
+// of shapes, so its loop has no shape branches, and circle pairs keep the wide kernel.
+// Every kernel appends contacts in pair order with the normal from a to b in aspect corrected
+// space; pairs less than margin apart count too, with a negative overlap.
+
+enum class PairType : uint8_t { CircleCircle, CircleSquare, SquareSquare };
+
+// Where the body pairs of the last step went. overlapping is every pair the broadphase found,
+// filtered the ones dropped by collision filters, sleeping the ones between an awake and a
+// sleeping body (found in the tree of sleeping bodies rather than by the broadphase) and sensor
+// the ones only tested for sensor events; tested went through the narrowphase and touching
+// came out as contacts
+struct PairStats
+{
+	uint32_t overlapping;
+	uint32_t filtered;
+	uint32_t sleeping;
+	uint32_t sensor;
+	uint32_t tested;
+	uint32_t touching;
+};
+static constexpr uint32_t PairTypeCount = 3;
+static constexpr uint32_t NoPairType = PairTypeCount;
+
+// Index of the shapes in the pair table, NoPairType for shapes bodies don't collide with
+constexpr uint32_t ShapeIndex(ShapeType type)
+{
+	return type == ShapeType::Circle ? 0 : (type == ShapeType::Square ? 1 : NoPairType);
+}
+
+// Bucket of a pair of shapes. Mixed pairs are stored circle first, swap is set when the pair
+// has to be turned round for that
+constexpr uint32_t GetPairType(ShapeType first, ShapeType second, bool& swap)
+{
+	uint32_t firstIndex = ShapeIndex(first);
+	uint32_t secondIndex = ShapeIndex(second);
+	swap = firstIndex > secondIndex;
+	if (firstIndex == NoPairType || secondIndex == NoPairType)
+	{
+		return NoPairType;
+	}
+
+	// Circle + circle is 0, circle + square 1, square + square 2, the PairType order
+	return firstIndex + secondIndex;
+}
+
+// Tests count pairs whose first body is shape First and second body shape Second
+template <ShapeType First, ShapeType Second>
+void CollidePairs(const BodyStore& bodies, const BodyPair* pairs, size_t count, float aspectRatio, float margin,
+	std::vector<PairContact>& contacts);
+
+template <>
+void CollidePairs<ShapeType::Circle, ShapeType::Circle>(const BodyStore& bodies, const BodyPair* pairs, size_t count,
+	float aspectRatio, float margin, std::vector<PairContact>& contacts);
+template <>
+void CollidePairs<ShapeType::Circle, ShapeType::Square>(const BodyStore& bodies, const BodyPair* pairs, size_t count,
+	float aspectRatio, float margin, std::vector<PairContact>& contacts);
+template <>
+void CollidePairs<ShapeType::Square, ShapeType::Square>(const BodyStore& bodies, const BodyPair* pairs, size_t count,
+	float aspectRatio, float margin, std::vector<PairContact>& contacts);
+
+using CollideFunction = void (*)(const BodyStore& bodies, const BodyPair* pairs, size_t count, float aspectRatio,
+	float margin, std::vector<PairContact>& contacts);
+
+// Kernel of each bucket, in PairType order
+inline constexpr CollideFunction CollideFunctions[PairTypeCount] =
+{
+	&CollidePairs<ShapeType::Circle, ShapeType::Circle>,
+	&CollidePairs<ShapeType::Circle, ShapeType::Square>,
+	&CollidePairs<ShapeType::Square, ShapeType::Square>,
+};
\ No newline at end of file
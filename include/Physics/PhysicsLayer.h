@@ -1,19 +1,29 @@
 #pragma once
 
 #include "Rendering/Renderer.h"
+#include "Core/JobSystem.h"
+#include "Physics/AABB.h"
+#include "Physics/BarnesHut.h"
+#include "Physics/BodyStore.h"
+#include "Physics/BroadPhase.h"
+#include "Physics/BroadPhaseTuner.h"
+#include "Physics/ContactSolver.h"
+#include "Physics/DynamicTree.h"
+#include "Physics/Fluid.h"
+#include "Physics/GridFluid.h"
+#include "Physics/Islands.h"
+#include "Physics/MortonOrder.h"
+#include "Physics/Narrowphase.h"
+#include "Physics/Sensors.h"
+#include "Physics/SimdKernels.h"
+#include "Physics/SpatialQuery.h"
+#include "Physics/StaticGeometry.h"
 #include <vector>
 
-struct Wall
-{
-	float xPosition;
-	float yPosition;
-	float width;
-	float height;
-};
-
 class Physics
 {
 private:
+	// Units per second squared, applied scaled by the step dt
 	float m_Gravity;
 	float m_GroundPosition;
 	float m_GroundHeight;
@@ -21,42 +31,259 @@ private:
 	float m_BounceLevel;
 	float m_AspectRatio;
 	float m_Restitution;
-	float m_VelocityThreshold;
 
-	std::vector<Wall> m_Walls;
+	StaticGeometry m_StaticGeometry;
+	// What the spatial queries run against, taken by SnapshotQueries
+	QuerySnapshot m_QuerySnapshot;
+
+	// Worker threads the step is split across
+	JobSystem* m_Jobs;
+
+	// Broadphase state, reused every step to avoid reallocating
+	BroadPhase* m_BroadPhase;
+	BroadPhaseType m_BroadPhaseType;
+	// 0 sizes grid cells by the largest body
+	float m_GridCellSize;
+	bool m_AutoTuneBroadPhase;
+	BroadPhaseTuner m_BroadPhaseTuner;
+	std::vector<AABB> m_Bounds;
+	std::vector<uint32_t> m_BoundsOwner;
+	// Packed collision filter of every proxy, handed to the broadphase with the bounds
+	std::vector<uint64_t> m_ProxyFilters;
+	std::vector<BodyPair> m_Pairs;
+	PairStats m_PairStats;
+
+	// Candidate pairs bucketed by pair type, each bucket goes to its own narrowphase kernel
+	std::vector<BodyPair> m_PairBuckets[PairTypeCount];
+	std::vector<PairContact> m_PairContacts;
+	std::vector<std::vector<PairContact>> m_ChunkContacts;
+	// Pairs between awake proxies and sleeping bodies, found per chunk of proxies
+	std::vector<std::vector<BodyPair>> m_ChunkSleepingPairs;
+	// Pairs with a sensor in them, sensor events come from these instead of contacts
+	std::vector<BodyPair> m_SensorPairs;
+	Sensors m_Sensors;
+
+	// Ground and wall contacts, found per chunk of bodies then joined in chunk order
+	std::vector<std::vector<ContactConstraint>> m_ChunkStaticContacts;
+	ContactSolver m_Solver;
+	SolverType m_SolverType;
+	int m_Substeps;
+	// Contacts are found this far before bodies touch, the margin is only used with substeps
+	float m_SpeculativeMargin;
+	float m_ContactMargin;
+	// Where the bodies started the current substep, their velocity is how far they got from it
+	std::vector<float> m_SubstepX;
+	std::vector<float> m_SubstepY;
+
+	// Contacts between bodies found this step (body indices), the islands are built from them
+	std::vector<BodyPair> m_Contacts;
+
+	// Continuous collision. Bodies that move further than m_SweepFraction of their half size in
+	// a step are swept against the ground and walls so they can't pass through them
+	bool m_ContinuousCollision;
+	float m_SweepFraction;
+
+	// Body reordering. Every m_ReorderInterval steps the bodies are checked against Morton order
+	// and sorted into it once more than m_ReorderThreshold of them are out of place, so bodies
+	// close in space stay close in memory however many were spawned and removed
+	MortonOrder m_MortonOrder;
+	int m_ReorderInterval;
+	int m_StepsSinceReorder;
+	float m_ReorderThreshold;
+
+	// N-body gravity. In NBody mode the Barnes-Hut tree is rebuilt every step and its pull,
+	// scaled by m_GravitationalConstant, replaces the uniform gravity. Per body, in x / y units
+	GravityMode m_GravityMode;
+	float m_GravitationalConstant;
+	BarnesHut m_BarnesHut;
+	std::vector<float> m_NBodyX;
+	std::vector<float> m_NBodyY;
+
+	// SPH fluid stepped alongside the bodies, it collides with the ground and walls only
+	Fluid m_Fluid;
+	// Grid fluid (wind) stepped alongside the bodies when enabled. It pulls the bodies towards
+	// its velocity at m_GridFluidDrag per second, but only the ground and walls are obstacles to it.
+	// The grid is allocated the first time it is enabled
+	GridFluid m_GridFluid;
+	bool m_GridFluidEnabled;
+	bool m_GridObstaclesDirty;
+	float m_GridFluidDrag;
+
+	// Sleeping. Bodies averaging under m_SleepVelocity for m_TimeToSleep seconds count as resting,
+	// and an island (bodies linked by contacts) falls asleep once every body in it is resting.
+	// Sleeping islands keep their members as handles so one touch can wake the whole island
+	bool m_SleepEnabled;
+	bool m_WakeAll;
+	float m_SleepVelocity;
+	float m_TimeToSleep;
+	Islands m_Islands;
+	std::vector<uint32_t> m_AwakeBodies;
+	std::vector<std::vector<BodyHandle>> m_SleepingIslands;
+	std::vector<uint32_t> m_FreeSleepingIslands;
+	// Sleeping bodies aren't broadphase proxies. Their bounds go into this tree, keyed by handle
+	// slot, when their island falls asleep and come out when it wakes, and only the awake
+	// proxies query it. m_SleepingHandles is the body each slot's leaf belongs to
+	DynamicTree m_SleepingTree;
+	std::vector<AABB> m_SleepingBounds;
+	std::vector<BodyHandle> m_SleepingHandles;
+	// Bodies woken since they were last taken out of the tree
+	std::vector<BodyHandle> m_WokenBodies;
+	// An island slept or woke, so the broadphase proxies aren't the same bodies any more
+	bool m_ProxiesChanged;
+
+	// Work per job for the parallel loops, small scenes stay on the calling thread
+	static const uint32_t BodiesPerJob = 1024;
+	static const uint32_t PairsPerJob = 2048;
+	// Gap left between a swept body and what it hit
+	static constexpr float SweepSkin = 1e-5f;
+	// Grid fluid resolution, cells of 5 x 5 pixels in the 2560 x 1440 window
+	static const uint32_t GridFluidCellsX = 512;
+	static const uint32_t GridFluidCellsY = 288;
 
 public:
 	Physics(float gravity, float groundPosition, float groundHeight, float groundWidth, float bounceLevel, float aspectRatio);
 	~Physics();
 
-	void Update(std::vector<Shape>& shapes, float dt);
+	void Update(BodyStore& bodies, float dt);
 	void SetGravity(float gravity);
 	void SetBounceLevel(float bounceLevel);
+	// Picking the broadphase or cell size by hand turns the tuner off
+	void SetBroadPhase(BroadPhaseType type);
+	BroadPhaseType GetBroadPhase() const { return m_BroadPhaseType; }
+	void SetGridCellSize(float cellSize);
+	float GetGridCellSize() const { return m_GridCellSize; }
+	void SetBroadPhaseAutoTune(bool enabled);
+	bool GetBroadPhaseAutoTune() const { return m_AutoTuneBroadPhase; }
+	// Everything the tuner decided, oldest first
+	const std::deque<TunerDecision>& GetBroadPhaseDecisions() const { return m_BroadPhaseTuner.GetDecisions(); }
+	// 0 uses every hardware thread
+	void SetThreadCount(unsigned int threadCount);
+	unsigned int GetThreadCount() const { return m_Jobs->GetThreadCount(); }
+
+	// Solver functions
+	void SetSolverIterations(int velocityIterations, int positionIterations);
+	void SetWarmStarting(bool enabled);
+	void SetFriction(float friction);
+	void SetSolverType(SolverType type);
+	SolverType GetSolverType() const { return m_SolverType; }
+	void SetSubsteps(int substeps);
+	int GetSubsteps() const { return m_Substeps; }
+	const SolverStats& GetSolverStats() const { return m_Solver.GetStats(); }
+
+	// Continuous collision functions
+	void SetContinuousCollision(bool enabled);
+	bool GetContinuousCollision() const { return m_ContinuousCollision; }
+	void SetSweepFraction(float fraction);
+
+	// Reordering functions, an interval of 0 turns reordering off
+	void SetReorderInterval(int steps);
+	void SetReorderThreshold(float fraction);
+
+	// Sleep functions
+	void SetSleepEnabled(bool enabled);
+	void WakeBody(BodyStore& bodies, uint32_t index);
+	void ApplyImpulse(BodyStore& bodies, uint32_t index, float impulseX, float impulseY);
+
+	// Collision filter functions. Setting a filter through Physics wakes the body, so it starts
+	// or stops colliding with sleeping bodies straight away
+	void SetCollisionFilter(BodyStore& bodies, uint32_t index, const CollisionFilter& filter);
+	const PairStats& GetPairStats() const { return m_PairStats; }
+
+	// N-body functions. Masses are the body masses (the size), distances are in aspect
+	// corrected space
+	void SetGravityMode(GravityMode mode);
+	GravityMode GetGravityMode() const { return m_GravityMode; }
+	void SetGravitationalConstant(float constant);
+	void SetOpeningAngle(float angle) { m_BarnesHut.SetOpeningAngle(angle); }
+	void SetSoftening(float softening) { m_BarnesHut.SetSoftening(softening); }
+	const NBodyStats& GetNBodyStats() const { return m_BarnesHut.GetStats(); }
+	// Checks the last step's tree against summing every pair, O(bodies * samples)
+	NBodyError MeasureNBodyError(uint32_t sampleCount) const { return m_BarnesHut.MeasureError(sampleCount); }
+
+	// Sensor functions. Sensors still move with their velocity and gravity, give them
+	// noMovement to keep them in place. Overlaps are found with the contacts, where the bodies
+	// started the last step, and the events are what changed since the step before
+	void SetSensor(BodyStore& bodies, uint32_t index, bool sensor);
+	const std::vector<SensorEvent>& GetSensorEvents() const { return m_Sensors.GetEvents(); }
+	const std::vector<SensorOverlap>& GetSensorOverlaps() const { return m_Sensors.GetOverlaps(); }
+
+	// Fluid functions. The fluid steps with Update even while every body sleeps
+	Fluid& GetFluid() { return m_Fluid; }
+	const Fluid& GetFluid() const { return m_Fluid; }
+	const FluidStats& GetFluidStats() const { return m_Fluid.GetStats(); }
+
+	// Grid fluid functions. Off by default, and its grid isn't allocated until it is first
+	// enabled; the drag is the fraction of the velocity difference
+	// to the fluid a body loses per second, the same for every body since the mass is the size
+	void SetGridFluidEnabled(bool enabled);
+	bool GetGridFluidEnabled() const { return m_GridFluidEnabled; }
+	void SetGridFluidDrag(float drag);
+	GridFluid& GetGridFluid() { return m_GridFluid; }
+	const GridFluid& GetGridFluid() const { return m_GridFluid; }
+	const GridFluidStats& GetGridFluidStats() const { return m_GridFluid.GetStats(); }
 
 	// Wall functions
 	void AddWall(float xPosition, float yPosition, float width, float height);
 	void ClearWalls();
+	const StaticGeometry& GetStaticGeometry() const { return m_StaticGeometry; }
+
+	// Spatial query functions. Queries run against the bodies, ground and walls as they were at
+	// the last SnapshotQueries, so take a snapshot after stepping and before querying. The
+	// batch versions split the queries across the physics threads
+	void SnapshotQueries(const BodyStore& bodies);
+	const QuerySnapshot& GetQuerySnapshot() const { return m_QuerySnapshot; }
+	bool RayCast(float startX, float startY, float endX, float endY, CastHit& hit) const;
+	bool ShapeCast(const CastQuery& query, CastHit& hit) const;
+	void QueryOverlap(const AABB& box, std::vector<QueryItem>& items) const;
+	void QueryContaining(float x, float y, std::vector<QueryItem>& items) const;
+	void CastBatch(const std::vector<CastQuery>& queries, std::vector<CastHit>& hits) const;
+	void QueryOverlapBatch(const std::vector<AABB>& boxes, QueryResults& results) const;
+	void QueryContainingBatch(const std::vector<QueryPoint>& points, QueryResults& results) const;
 
 private:
-	void ApplyGravity(Shape& shape);
-	void UpdatePosition(Shape& shape, float dt);
-	void ApplyGroundCollision(Shape& shape);
-	void ApplyWallCollision(Shape& shape);
-	void ApplyFriction(Shape& shape, std::vector<Shape>& shapes);
+	// The ground's box in physics space
+	AABB GetGroundBox() const;
+	void ComputeNBodyGravity(const BodyStore& bodies);
+	// Pulls the bodies towards the grid fluid's velocity, waking the ones it would move
+	void ApplyGridFluid(BodyStore& bodies, float dt);
+	void UpdateVelocity(BodyStore& bodies, float dt);
+	void UpdatePosition(BodyStore& bodies, float dt);
+	// The substep solver's replacement for the velocity, solve and position calls of a step
+	void SolveSubsteps(BodyStore& bodies, float dt);
+	void FindGroundContact(BodyStore& bodies, uint32_t index, std::vector<ContactConstraint>& contacts);
+	// nearbyWalls is scratch space, one per thread
+	void FindWallContacts(BodyStore& bodies, uint32_t index, std::vector<uint32_t>& nearbyWalls,
+		std::vector<ContactConstraint>& contacts);
+	void FindStaticContacts(BodyStore& bodies);
 
 	// Collision functions
 
-	bool IsTouchingAnything(Shape& shape, std::vector<Shape>& shapes);
-	bool IsOnGround(Shape& shape);
+	void AddPairContact(BodyStore& bodies, const PairContact& contact);
+	// Tests one pair through the same kernel as its bucket, returns true if it woke an island
+	bool FindPairContact(BodyStore& bodies, uint32_t first, uint32_t second);
+	void FindObjectContacts(BodyStore& bodies);
+	void UpdateSensors(const BodyStore& bodies);
+	AABB ComputeBounds(const BodyStore& bodies, uint32_t index);
+
+	void UseBroadPhase(const BroadPhaseConfig& config);
 
-	bool CheckCircleCollision(Shape& circle1, Shape& circle2);
-	bool Physics::CheckSquareCollision(Shape& square1, Shape& square2);
-	bool Physics::CheckCircleSquareCollision(Shape& circle, Shape& square);
+	void DeleteObjectsOutOfFrame(BodyStore& bodies);
+	// Sorts the bodies into Morton order when it's due and they've drifted out of it
+	void ReorderBodies(BodyStore& bodies);
 
-	void ApplyCircleCollision(Shape& circle1, Shape& circle2);
-	void ApplySquareCollision(Shape& square1, Shape& square2);
-	void ApplyCircleSquareCollision(Shape& circle, Shape& square);
-	void UpdateObjectCollisions(std::vector<Shape>& shapes);
+	// Sweeps the fast bodies from where they started moving (startX, startY) to where they are,
+	// stopping them where they first hit the ground or a wall
+	void SweepFastBodies(BodyStore& bodies, const std::vector<float>& startX, const std::vector<float>& startY);
+	// Earliest time of impact in [0, 1] of a box moving from start to end against the ground and
+	// walls, with the normal of the face hit pointing back out
+	bool SweepStatic(float startX, float startY, float endX, float endY, float halfWidth, float halfHeight,
+		std::vector<uint32_t>& nearbyWalls, float& timeOfImpact, float& normalX, float& normalY) const;
 
-	void DeleteObjectsOutOfFrame(std::vector<Shape>& shapes);
+	void UpdateSleep(BodyStore& bodies, float dt);
+	void WakeIsland(BodyStore& bodies, uint32_t island);
+	// Takes the woken bodies out of the sleeping tree. With findContacts each one first tests
+	// what it still overlaps in the tree, its own island included, waking whatever it touches
+	void RemoveWokenBodies(BodyStore& bodies, bool findContacts);
+	// Returns true if either body was asleep
+	bool WakeTouching(BodyStore& bodies, uint32_t first, uint32_t second);
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Physics/BodyStore.h"
+#include <cstdint>
+#include <vector>
+
+// A sensor body overlapping another body. Handles, so the pair still means the same bodies
+// after removals and reordering
+struct SensorOverlap
+{
+	BodyHandle sensor;
+	BodyHandle visitor;
+};
+
+enum class SensorEventType : uint8_t { Begin, End };
+
+struct SensorEvent
+{
+	SensorEventType type;
+	BodyHandle sensor;
+	BodyHandle visitor;
+};
+
+// Turns the sensor overlaps of each step into begin and end events.
+// The overlaps of a step are collected in any order, sorted, and merged against the sorted
+// overlaps of the step before: pairs only in the new list began, pairs only in the old one
+// ended. The events of a step come out as one array, begins and ends in pair order, so the
+// caller walks it once instead of taking a callback per pair. A body that was removed shows up
+// as an end event with a handle that no longer resolves.
+class Sensors
+{
+private:
+	std::vector<SensorOverlap> m_Overlaps;
+	std::vector<SensorOverlap> m_PreviousOverlaps;
+	std::vector<SensorEvent> m_Events;
+
+public:
+	// Starts collecting the overlaps of a new step
+	void BeginStep();
+	void AddOverlap(BodyHandle sensor, BodyHandle visitor) { m_Overlaps.push_back({ sensor, visitor }); }
+	// Works out the events from the overlaps added since BeginStep
+	void EndStep();
+	// For steps where nothing moved: no events, the overlaps stay as they were
+	void ClearEvents() { m_Events.clear(); }
+	void Clear();
+
+	const std::vector<SensorEvent>& GetEvents() const { return m_Events; }
+	// Sorted by sensor, then visitor
+	const std::vector<SensorOverlap>& GetOverlaps() const { return m_Overlaps; }
+};
\ No newline at end of file
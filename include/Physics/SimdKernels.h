@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Physics/AABB.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Wide kernels for the hot physics loops. The widest instruction set the build allows is
+// picked at compile time: AVX2 (8 lanes, what /arch:AVX2 turns on), SSE2 (4 lanes) or
+// plain scalar code. The Scalar* versions are always compiled so the wide paths can be
+// checked against them; they agree up to the rounding of the rsqrt refinement.
+
+#if defined(__AVX2__)
+#define PHYSICS_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHYSICS_SIMD_SSE 1
+#endif
+
+// Result of testing one body pair (any shapes), only written for pairs that touch
+struct PairContact
+{
+	uint32_t a;
+	uint32_t b;
+	// Normal from a to b in aspect corrected space
+	float normalX;
+	float normalY;
+	float overlap;
+};
+
+// Hot contact data for the wide solver, one column per field so lanes load with plain vector
+// loads. Contacts against static geometry have b set to StaticContactBody. Contacts handed to a
+// kernel call must not share bodies, which colouring guarantees (see ContactSolver)
+struct ContactColumns
+{
+	static constexpr uint32_t StaticContactBody = 0xFFFFFFFF;
+
+	std::vector<uint32_t> a, b;
+	// Normal from a to b in aspect corrected space
+	std::vector<float> normalX, normalY;
+	std::vector<float> invMassA, invMassB;
+	// Bodies don't rotate, so one effective mass serves the normal and the tangent
+	std::vector<float> mass;
+	std::vector<float> friction;
+	std::vector<float> normalImpulse, tangentImpulse;
+
+	void Resize(size_t count);
+};
+
+// Particle columns the fluid kernels read, positions and velocities in physics space.
+// pressureTerm is pressure over density squared, count is the length of every column
+struct FluidColumns
+{
+	uint32_t count;
+	const float* x;
+	const float* y;
+	const float* xVcty;
+	const float* yVcty;
+	const float* pressureTerm;
+	const float* inverseDensity;
+};
+
+// Ranges [begin, end) of particle indices the fluid kernels sum over, one per row of cells
+// around a particle
+struct FluidRuns
+{
+	uint32_t begin[3];
+	uint32_t end[3];
+	uint32_t count;
+};
+
+// Applies gravity (an acceleration) to every body that isn't flagged noMovement or asleep
+void IntegrateVelocities(float* yVcty, const uint8_t* noMovement, const uint8_t* asleep, size_t count,
+	float gravity, float dt);
+void ScalarIntegrateVelocities(float* yVcty, const uint8_t* noMovement, const uint8_t* asleep, size_t count,
+	float gravity, float dt);
+
+// Moves every body that isn't flagged noMovement or asleep by its velocity
+void IntegratePositions(float* x, float* y, const float* xVcty, const float* yVcty, const uint8_t* noMovement,
+	const uint8_t* asleep, size_t count, float dt);
+void ScalarIntegratePositions(float* x, float* y, const float* xVcty, const float* yVcty, const uint8_t* noMovement,
+	const uint8_t* asleep, size_t count, float dt);
+
+// Tests circle pairs (body indices) with a squared distance early-out and appends a contact
+// for every overlapping pair, in pair order. radius is the circle radius column. Pairs less
+// than margin apart count too, their overlap comes out negative.
+void CollideCirclePairs(const float* x, const float* y, const float* radius, const BodyPair* pairs,
+	size_t count, float aspectRatio, float margin, std::vector<PairContact>& contacts);
+void ScalarCollideCirclePairs(const float* x, const float* y, const float* radius, const BodyPair* pairs,
+	size_t count, float aspectRatio, float margin, std::vector<PairContact>& contacts);
+
+// Single pair version, returns false if the circles are further than margin apart
+bool ScalarCollideCirclePair(const float* x, const float* y, const float* radius, const BodyPair& pair,
+	float aspectRatio, float margin, PairContact& contact);
+
+// One velocity iteration over contacts [begin, end): friction first, clamped to the friction
+// cone of the accumulated normal impulse, then the normal impulse, clamped so it only pushes.
+// Velocities are gathered once per lane group and scattered back at the end
+void SolveContactVelocities(ContactColumns& contacts, size_t begin, size_t end, float* xVcty, float* yVcty,
+	float aspectRatio);
+void ScalarSolveContactVelocities(ContactColumns& contacts, size_t begin, size_t end, float* xVcty, float* yVcty,
+	float aspectRatio);
+
+// Adds the pull of count point masses on a body at (bodyX, bodyY), everything in aspect
+// corrected space: the sum of mass * d / (|d|^2 + softeningSquared)^1.5, d from the body to the
+// point. Points exactly at the body are skipped, so a body's own entry can be in the list
+void AccumulateAttraction(float bodyX, float bodyY, const float* x, const float* y, const float* mass, size_t count,
+	float softeningSquared, float& accelerationX, float& accelerationY);
+void ScalarAccumulateAttraction(float bodyX, float bodyY, const float* x, const float* y, const float* mass,
+	size_t count, float softeningSquared, float& accelerationX, float& accelerationY);
+
+// Fluid density around a particle at (particleX, particleY), aspect corrected: the sum of
+// (smoothingRadius - r)^2 over the particles in runs closer than smoothingRadius, the particle
+// itself included. neighbours is increased by how many that was. count is the length of the
+// columns, the wide versions read past the end of a run but never past count
+float SumFluidDensity(const float* x, const float* y, uint32_t count, const FluidRuns& runs, float particleX,
+	float particleY, float aspectRatio, float smoothingRadius, uint32_t& neighbours);
+float ScalarSumFluidDensity(const float* x, const float* y, const FluidRuns& runs, float particleX, float particleY,
+	float aspectRatio, float smoothingRadius, uint32_t& neighbours);
+
+// Pressure and viscosity sums on particle i from the particles in runs within smoothingRadius,
+// in aspect corrected space and without the kernel constants. Pressure adds
+// (term i + term j) (h - r) / r along the direction away from j, viscosity adds the velocity
+// difference times (h - r) / density j. Particles on exactly the same spot as i are taken as a
+// tiny distance apart along x, the lower index on the left, so they still push apart
+void AccumulateFluidForces(const FluidColumns& particles, uint32_t i, const FluidRuns& runs, float aspectRatio,
+	float smoothingRadius, float& pressureX, float& pressureY, float& viscosityX, float& viscosityY);
+void ScalarAccumulateFluidForces(const FluidColumns& particles, uint32_t i, const FluidRuns& runs, float aspectRatio,
+	float smoothingRadius, float& pressureX, float& pressureY, float& viscosityX, float& viscosityY);
+
+// Bilinear samples of a grid of width * height values (rows of width, value (i, j) sitting at
+// (i, j)) at count points in grid coordinates. Points off the grid are clamped onto it, the
+// grid needs at least 2 values each way
+void SampleGrid(const float* field, uint32_t width, uint32_t height, const float* sampleX, const float* sampleY,
+	size_t count, float* values);
+void ScalarSampleGrid(const float* field, uint32_t width, uint32_t height, const float* sampleX, const float* sampleY,
+	size_t count, float* values);
+
+// One row of the pressure equation on a grid, every pointer at the start of the row. Cell i
+// has faces weightX[i] and weightX[i + 1] across x, weightBelow[i] and weightAbove[i] across y
+struct PressureRow
+{
+	const float* weightX;
+	const float* weightBelow;
+	const float* weightAbove;
+	const float* below;
+	const float* above;
+	const float* rhs;
+	const float* inverseDiagonal;
+	float* pressure;
+};
+
+// Gauss-Seidel update of the cells in [begin, end) whose index has the parity given, from
+// their neighbours across the four faces. The cells either side of the range are read, so
+// begin must be at least 1 and end at most the row length - 1
+void RelaxPressureRow(const PressureRow& row, uint32_t begin, uint32_t end, uint32_t parity);
+void ScalarRelaxPressureRow(const PressureRow& row, uint32_t begin, uint32_t end, uint32_t parity);
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+#include "Physics/AABB.h"
+#include "Physics/BodyStore.h"
+#include "Physics/BoundingVolumeHierarchy.h"
+#include "Physics/StaticGeometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Something a query found: a body, or for the ground and walls a static feature numbered like
+// static contacts, 0 for the ground and 1 + index for walls
+struct QueryItem
+{
+	static constexpr uint32_t NoFeature = 0xFFFFFFFF;
+
+	BodyHandle body;
+	uint32_t feature;
+};
+
+// A circle moved in a straight line from start to end, radius 0 casts a ray. Positions are in
+// body coordinates (like BodyStore x / y), the radius in aspect corrected units like a circle's
+struct CastQuery
+{
+	float startX;
+	float startY;
+	float endX;
+	float endY;
+	float radius;
+};
+
+struct CastHit
+{
+	bool hit;
+	QueryItem item;
+	// Fraction of the way from start to end where the circle first touches, 0 if it starts
+	// touching, and where its centre is then
+	float fraction;
+	float x;
+	float y;
+	// Surface normal at the touch in aspect corrected space, pointing back out at the caster
+	float normalX;
+	float normalY;
+};
+
+struct QueryPoint
+{
+	float x;
+	float y;
+};
+
+// Results of a batch of overlap or point queries, query i found items[start[i]] up to
+// items[start[i + 1]]
+struct QueryResults
+{
+	std::vector<uint32_t> start;
+	std::vector<QueryItem> items;
+};
+
+// Read only copy of the colliding shapes for spatial queries.
+// Build copies the circles and squares of a body store, the ground and the walls, and puts
+// all of them in one bounding volume hierarchy. Nothing changes it afterwards, so queries can
+// run on any number of threads, and the snapshot stays usable while the bodies move on: the
+// results name bodies by handle. Casts walk the tree shrinking the segment to the nearest hit
+// so far; overlap and point queries test exact shapes (circles as circles) after the boxes.
+// The batch versions split the queries over a job system, results come out in query order.
+class QuerySnapshot
+{
+private:
+	float m_AspectRatio;
+	// Per shape, circles have a radius (aspect corrected), boxes a radius of 0
+	std::vector<float> m_X, m_Y;
+	std::vector<float> m_HalfWidth, m_HalfHeight;
+	std::vector<float> m_Radius;
+	std::vector<QueryItem> m_Items;
+	BoundingVolumeHierarchy m_Tree;
+
+	static const uint32_t QueriesPerJob = 64;
+
+public:
+	explicit QuerySnapshot(float aspectRatio);
+
+	// groundBox is the ground in body coordinates
+	void Build(const BodyStore& bodies, const StaticGeometry& walls, const AABB& groundBox);
+	size_t Size() const { return m_Items.size(); }
+
+	// Nearest thing the circle touches on its way, hit.hit is false if there is none
+	bool Cast(const CastQuery& query, CastHit& hit) const;
+	// Everything whose shape overlaps box (body coordinates) or contains the point, in
+	// snapshot order
+	void Overlap(const AABB& box, std::vector<QueryItem>& items) const;
+	void Contains(const QueryPoint& point, std::vector<QueryItem>& items) const;
+
+	void CastBatch(const std::vector<CastQuery>& queries, std::vector<CastHit>& hits, JobSystem& jobs) const;
+	void OverlapBatch(const std::vector<AABB>& boxes, QueryResults& results, JobSystem& jobs) const;
+	void ContainsBatch(const std::vector<QueryPoint>& points, QueryResults& results, JobSystem& jobs) const;
+
+private:
+	void Add(float x, float y, float halfWidth, float halfHeight, float radius, const QueryItem& item);
+	// Casts against shape, keeping the hit if it is nearer than the one already in hit
+	void CastShape(uint32_t shape, const CastQuery& query, CastHit& hit) const;
+	// Runs a query with a variable number of results per input over the job system
+	template <typename Input, typename Function>
+	void RunBatch(const std::vector<Input>& inputs, QueryResults& results, JobSystem& jobs, Function function) const;
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Physics/AABB.h"
+#include "Physics/BoundingVolumeHierarchy.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A wall as Physics::AddWall takes it: centre, and width / height in screen units
+struct Wall
+{
+	float xPosition;
+	float yPosition;
+	float width;
+	float height;
+};
+
+// The walls of the level, kept in one place for the physics and for drawing.
+// Walls don't move, so instead of a tree that can be updated they get a bounding volume
+// hierarchy built in one go. Adding or clearing walls marks it for a rebuild, which Build does
+// before the next queries.
+class StaticGeometry
+{
+private:
+	float m_AspectRatio;
+	std::vector<Wall> m_Walls;
+	// Bounds of every wall in physics space
+	std::vector<AABB> m_Bounds;
+
+	BoundingVolumeHierarchy m_Tree;
+	bool m_Dirty;
+
+public:
+	explicit StaticGeometry(float aspectRatio);
+
+	// Returns the index of the wall, which stays the same until Clear
+	uint32_t Add(const Wall& wall);
+	void Clear();
+	// Rebuilds the tree if walls changed. Queries are only safe from several threads at once
+	// after this
+	void Build();
+
+	// Walls whose bounds touch box, by index in increasing order
+	void Query(const AABB& box, std::vector<uint32_t>& walls) const;
+
+	size_t Size() const { return m_Walls.size(); }
+	const Wall& GetWall(uint32_t index) const { return m_Walls[index]; }
+	const AABB& GetBounds(uint32_t index) const { return m_Bounds[index]; }
+	const std::vector<Wall>& GetWalls() const { return m_Walls; }
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Physics/BroadPhase.h"
+#include <unordered_set>
+#include <vector>
+
+// Incremental sweep and prune broadphase.
+// The min/max endpoints of every proxy are kept sorted on both axes between steps. Bodies
+// barely move from one step to the next, so re-sorting with insertion sort is close to
+// linear, and every swap it makes is exactly one pair starting or stopping to overlap on
+// that axis. Those swaps keep a persistent hashed set of overlapping pairs up to date, so
+// no step has to find pairs from nothing.
+// Starting out, or when many proxies arrive at once, there is no order worth keeping: the
+// endpoints are sorted with one std::sort and the pairs found with a single sweep instead.
+class SweepAndPrune : public BroadPhase
+{
+private:
+	struct Endpoint
+	{
+		float value;
+		// proxy << 1, low bit set for a min endpoint
+		uint32_t data;
+	};
+
+	std::vector<Endpoint> m_EndpointsX;
+	std::vector<Endpoint> m_EndpointsY;
+	std::unordered_set<uint64_t> m_Pairs;
+
+	const std::vector<AABB>* m_Bounds;
+	uint32_t m_ProxyCount;
+
+	// Every new endpoint crosses about half of the others to get into place, past this many new
+	// proxies sorting everything again is cheaper
+	static const uint32_t RebuildProxyCount = 32;
+
+public:
+	SweepAndPrune();
+
+	void Update(const std::vector<AABB>& bounds) override;
+	void FindPairs(std::vector<BodyPair>& pairs) const override;
+	void Reset() override;
+
+private:
+	// Sorts the endpoints of proxies [0, proxyCount) from scratch and sweeps x for the pairs
+	void Rebuild(uint32_t proxyCount);
+	void AddProxies(uint32_t first, uint32_t last);
+	void RemoveProxies(uint32_t first);
+	void RefreshEndpoints(std::vector<Endpoint>& endpoints, bool xAxis);
+	void InsertionSort(std::vector<Endpoint>& endpoints);
+};
\ No newline at end of file
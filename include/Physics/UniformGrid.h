@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Physics/BroadPhase.h"
+#include <vector>
+
+// Uniform grid broadphase rebuilt from scratch every step.
+// Instead of a std::vector per cell the grid is stored as one flat array sorted by cell
+// (counting sort), so a rebuild is a few linear passes over the bodies:
+//   1. count how many cells every body overlaps and prefix sum that into entry offsets
+//   2. write one (cell, body) entry per overlapped cell
+//   3. count entries per cell, prefix sum into m_CellStart and scatter into m_CellBodies
+// UpdateParallel splits every pass across the job system: the counts and entries per chunk of
+// bodies, then pass 3 per band of rows after the entries are bucketed by band. It builds exactly
+// the same grid as Update.
+class UniformGrid : public BroadPhase
+{
+private:
+	struct CellEntry
+	{
+		uint32_t cell;
+		uint32_t body;
+	};
+
+	struct Extent
+	{
+		float minX;
+		float minY;
+		float maxX;
+		float maxY;
+		// Largest width or height of a body
+		float largest;
+	};
+
+	// 0 means pick the cell size from the largest body every build
+	float m_CellSize;
+	float m_ActiveCellSize;
+	float m_OriginX;
+	float m_OriginY;
+	int m_CellsX;
+	int m_CellsY;
+
+	const AABB* m_Bounds;
+	std::vector<uint32_t> m_EntryOffsets;
+	std::vector<CellEntry> m_Entries;
+	std::vector<uint32_t> m_CellStart;
+	std::vector<uint32_t> m_CellBodies;
+	mutable std::vector<std::vector<BodyPair>> m_ChunkPairs;
+
+	// Scratch for UpdateParallel: per chunk of bodies, the extent and the entry count (prefix
+	// summed); per chunk of entries and band, where the chunk writes its entries of the band
+	std::vector<Extent> m_ChunkExtents;
+	std::vector<uint32_t> m_ChunkCounts;
+	std::vector<uint32_t> m_BandCounts;
+	std::vector<uint32_t> m_BandStart;
+	std::vector<CellEntry> m_BandEntries;
+
+	// Caps the number of cells relative to the number of bodies so a stray body far away
+	// can't blow up memory; the cell size grows instead
+	static const unsigned int MaxCellsPerBody = 4;
+	// Roughly how many cells one job scans in FindPairsParallel
+	static const unsigned int CellsPerJob = 1024;
+	// Work per job in UpdateParallel, and at most this many bands of rows for the last pass
+	static const uint32_t BodiesPerJob = 4096;
+	static const uint32_t EntriesPerJob = 8192;
+	static const uint32_t MaxBands = 64;
+
+public:
+	UniformGrid();
+
+	void Update(const std::vector<AABB>& bounds) override;
+	void UpdateParallel(const std::vector<AABB>& bounds, JobSystem& jobs) override;
+	void FindPairs(std::vector<BodyPair>& pairs) const override;
+	void FindPairsParallel(std::vector<BodyPair>& pairs, JobSystem& jobs) const override;
+
+	void SetCellSize(float cellSize);
+	float GetCellSize() const { return m_ActiveCellSize; }
+
+private:
+	int CellX(float x) const;
+	int CellY(float y) const;
+
+	// Build steps shared by Update and UpdateParallel, all on bodies or cells [first, last).
+	// BeginBuild returns false when there is nothing to build
+	bool BeginBuild(const std::vector<AABB>& bounds);
+	Extent MeasureBounds(uint32_t first, uint32_t last) const;
+	void SizeCells(const Extent& extent, uint32_t bodyCount);
+	// Writes every body's entry count to m_EntryOffsets[i] and returns their sum, OffsetEntries
+	// then turns the counts into offsets from start. Chunks never touch each other's slots
+	uint32_t CountEntries(uint32_t first, uint32_t last);
+	void OffsetEntries(uint32_t first, uint32_t last, uint32_t start);
+	void WriteEntries(uint32_t first, uint32_t last);
+	// Counting sort of entries [begin, end), all in cells [firstCell, lastCell), into the same
+	// range of m_CellBodies
+	void SortCells(const CellEntry* entries, uint32_t begin, uint32_t end, uint32_t firstCell, uint32_t lastCell);
+	void FindPairsInRows(int firstRow, int lastRow, std::vector<BodyPair>& pairs) const;
+};
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "Rendering/Renderer.h"
 #include "Physics/PhysicsLayer.h"
+#include "Physics/BodyStore.h"
 
 class PhysicsEngine
 {
@@ -13,12 +14,20 @@ private:
 	int m_Height;
 	GLFWwindow* m_Window;
 
-	// Struct Holding: shape, xPos, yPos, size/radius, r, g, b, a)
-	std::vector<Shape> m_Shapes;
+	// Every body in the scene, stored as columns (see BodyStore)
+	BodyStore m_Bodies;
 	Physics* m_PhysicsLayer;
 
-	float m_Dt;
-	float m_LastFrameTime;
+	// Fixed timestep: physics always advances by m_FixedDt, the accumulator carries frame time
+	// that hasn't been simulated yet and rendering blends the last two states by what is left.
+	// Time is kept in doubles so it doesn't lose precision in long sessions
+	double m_FixedDt;
+	double m_Accumulator;
+	double m_LastFrameTime;
+	int m_MaxStepsPerFrame;
+
+	// Number of the next broadphase tuner decision to write to the console
+	uint64_t m_PrintedDecisions;
 
 public:
 	PhysicsEngine(int width, int height, const char* title);
@@ -27,7 +36,12 @@ public:
 	bool Init(const char* title);
 	int Run();
 
+	void SetStepRate(double stepsPerSecond);
+	void SetMaxStepsPerFrame(int maxSteps);
+
 	void OnMouseLeftClick(double clickXPos, double clickYPos);
+	void OnKeyPress(int key);
 
 	static void MouseLeftClickCallBack(GLFWwindow* window, int button, int action, int mods);
+	static void KeyCallBack(GLFWwindow* window, int key, int scancode, int action, int mods);
 };
\ No newline at end of file
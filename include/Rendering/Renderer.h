@@ -43,6 +43,7 @@ struct Vertex {
 	float isCircle;
 };
 
+// Description a body is created from, Physics and the renderer read the BodyStore columns
 struct Shape {
 	ShapeType shape;
 	float x, y;
@@ -66,8 +67,11 @@ private:
 	unsigned int QuadCount;
 	float m_AspectRatio;
 
-	// Just a number to max out number of quads so there's no performance issues
-	static const unsigned int MaxQuads = 1000;
+	// Quads per draw call, a full batch is drawn and a new one started
+	static const unsigned int MaxQuads = 10000;
+
+	// Draws the quads batched so far and empties the batch
+	void Flush();
 public:
 	Renderer();
 	~Renderer();
@@ -0,0 +1,234 @@
+#include "Core/JobSystem.h"
+#include <algorithm>
+
+struct JobSystem::Job
+{
+	JobFunction function;
+	// Starts at 1 so the job can't be queued while Schedule is still adding dependencies
+	std::atomic<int> pendingDependencies;
+	std::atomic<bool> finished;
+
+	std::mutex dependentsMutex;
+	std::vector<JobHandle> dependents;
+};
+
+namespace
+{
+	// Which system and queue the current thread belongs to, threads the system doesn't know
+	// about use queue 0
+	thread_local const JobSystem* t_System = nullptr;
+	thread_local unsigned int t_QueueIndex = 0;
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+	: m_ThreadCount(threadCount), m_QueuedJobs(0), m_Stop(false)
+{
+	if (m_ThreadCount == 0)
+	{
+		m_ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (unsigned int i = 0; i < m_ThreadCount; i++)
+	{
+		m_Queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+
+	for (unsigned int i = 1; i < m_ThreadCount; i++)
+	{
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_Stop = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+JobSystem::JobHandle JobSystem::Schedule(JobFunction function, const std::vector<JobHandle>& dependencies)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->function = std::move(function);
+	job->pendingDependencies = 1;
+	job->finished = false;
+
+	for (const JobHandle& dependency : dependencies)
+	{
+		std::lock_guard<std::mutex> lock(dependency->dependentsMutex);
+		if (!dependency->finished)
+		{
+			dependency->dependents.push_back(job);
+			job->pendingDependencies++;
+		}
+	}
+
+	if (--job->pendingDependencies == 0)
+	{
+		Enqueue(job);
+	}
+
+	return job;
+}
+
+void JobSystem::Wait(const JobHandle& job)
+{
+	while (!job->finished)
+	{
+		if (!RunPendingJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	grainSize = std::max(1u, grainSize);
+	uint32_t chunkCount = (count - 1) / grainSize + 1;
+
+	// Chunks are handed out from a shared counter, so a thread that finishes early just takes more
+	std::atomic<uint32_t> nextChunk(0);
+	auto runChunks = [&]()
+	{
+		for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+		{
+			uint32_t begin = chunk * grainSize;
+			uint32_t end = std::min(count, begin + grainSize);
+			function(begin, end);
+		}
+	};
+
+	uint32_t helperCount = std::min(chunkCount, m_ThreadCount) - 1;
+	std::vector<JobHandle> helpers;
+	helpers.reserve(helperCount);
+	for (uint32_t i = 0; i < helperCount; i++)
+	{
+		helpers.push_back(Schedule(runChunks));
+	}
+
+	runChunks();
+
+	// The helpers reference this stack frame, so they all have to be done before returning
+	for (const JobHandle& helper : helpers)
+	{
+		Wait(helper);
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	t_System = this;
+	t_QueueIndex = index;
+
+	while (true)
+	{
+		if (RunPendingJob())
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_WakeMutex);
+		m_WakeCondition.wait(lock, [this]() { return m_Stop || m_QueuedJobs > 0; });
+		if (m_Stop)
+		{
+			return;
+		}
+	}
+}
+
+void JobSystem::Enqueue(const JobHandle& job)
+{
+	WorkQueue& queue = *m_Queues[CurrentQueue()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+
+	m_QueuedJobs++;
+	{
+		// Taking the lock makes sure a worker can't miss the wake up between checking and sleeping
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+	}
+	m_WakeCondition.notify_one();
+}
+
+JobSystem::JobHandle JobSystem::PopJob(unsigned int index)
+{
+	// Newest job from our own queue first, it is the most likely to still be in cache
+	{
+		WorkQueue& queue = *m_Queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			JobHandle job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			m_QueuedJobs--;
+			return job;
+		}
+	}
+
+	// Then steal the oldest job from the other queues
+	for (unsigned int offset = 1; offset < m_ThreadCount; offset++)
+	{
+		WorkQueue& queue = *m_Queues[(index + offset) % m_ThreadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			JobHandle job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			m_QueuedJobs--;
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+bool JobSystem::RunPendingJob()
+{
+	JobHandle job = PopJob(CurrentQueue());
+	if (!job)
+	{
+		return false;
+	}
+
+	job->function();
+	Finish(job);
+	return true;
+}
+
+void JobSystem::Finish(const JobHandle& job)
+{
+	std::vector<JobHandle> dependents;
+	{
+		std::lock_guard<std::mutex> lock(job->dependentsMutex);
+		job->finished = true;
+		dependents.swap(job->dependents);
+	}
+
+	for (const JobHandle& dependent : dependents)
+	{
+		if (--dependent->pendingDependencies == 0)
+		{
+			Enqueue(dependent);
+		}
+	}
+}
+
+unsigned int JobSystem::CurrentQueue() const
+{
+	return (t_System == this) ? t_QueueIndex : 0;
+}
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "Physics/BarnesHut.h"
+#include "Physics/SimdKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Subtrees are built all the way down
+	const uint32_t NoStopLevel = 0xFFFFFFFF;
+}
+
+BarnesHut::BarnesHut()
+	: m_OpeningAngle(0.5f), m_Softening(0.01f), m_Stats()
+{
+}
+
+void BarnesHut::Build(const BodyStore& bodies, float aspectRatio, JobSystem& jobs)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Static bodies have no mass to speak of and sensors don't take part in anything physical
+	m_UnsortedX.clear();
+	m_UnsortedY.clear();
+	m_UnsortedBodies.clear();
+	for (uint32_t i = 0; i < bodies.Size(); i++)
+	{
+		if (bodies.invMass[i] > 0.0f && !bodies.sensor[i])
+		{
+			m_UnsortedX.push_back(bodies.x[i]);
+			m_UnsortedY.push_back(bodies.y[i]);
+			m_UnsortedBodies.push_back(i);
+		}
+	}
+
+	uint32_t count = static_cast<uint32_t>(m_UnsortedBodies.size());
+	m_MortonOrder.Compute(m_UnsortedX.data(), m_UnsortedY.data(), count, aspectRatio);
+	const std::vector<uint32_t>& order = m_MortonOrder.Sort();
+
+	m_X.resize(count);
+	m_Y.resize(count);
+	m_Mass.resize(count);
+	m_Bodies.resize(count);
+	m_AccelerationX.assign(count, 0.0f);
+	m_AccelerationY.assign(count, 0.0f);
+	jobs.ParallelFor(count, BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				uint32_t body = m_UnsortedBodies[order[i]];
+				m_X[i] = m_UnsortedX[order[i]] * aspectRatio;
+				m_Y[i] = m_UnsortedY[order[i]];
+				m_Mass[i] = 1.0f / bodies.invMass[body];
+				m_Bodies[i] = body;
+			}
+		});
+
+	m_Nodes.clear();
+	m_Subtrees.clear();
+	m_Leaves.clear();
+	if (count > 0)
+	{
+		m_Nodes.resize(1);
+		BuildNode(m_Nodes, 0, 0, count, 0, SplitLevel);
+		uint32_t topCount = static_cast<uint32_t>(m_Nodes.size());
+
+		// The subtrees only read the sorted bodies, so each can be built on its own
+		uint32_t subtreeCount = static_cast<uint32_t>(m_Subtrees.size());
+		if (m_SubtreeNodes.size() < subtreeCount)
+		{
+			m_SubtreeNodes.resize(subtreeCount);
+		}
+		jobs.ParallelFor(subtreeCount, 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t subtree = begin; subtree < end; subtree++)
+				{
+					std::vector<Node>& nodes = m_SubtreeNodes[subtree];
+					nodes.resize(1);
+					BuildNode(nodes, 0, m_Subtrees[subtree].begin, m_Subtrees[subtree].end, SplitLevel, NoStopLevel);
+
+					// Children always come after their parent
+					for (uint32_t node = static_cast<uint32_t>(nodes.size()); node-- > 0;)
+					{
+						ComputeMass(nodes, node);
+					}
+				}
+			});
+
+		// Each subtree root replaces its placeholder, the rest goes on the end with the child
+		// indices moved along
+		std::vector<uint32_t> bases(subtreeCount);
+		uint32_t nodeCount = topCount;
+		for (uint32_t subtree = 0; subtree < subtreeCount; subtree++)
+		{
+			bases[subtree] = nodeCount;
+			nodeCount += static_cast<uint32_t>(m_SubtreeNodes[subtree].size()) - 1;
+		}
+		m_Nodes.resize(nodeCount);
+
+		jobs.ParallelFor(subtreeCount, 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t subtree = begin; subtree < end; subtree++)
+				{
+					const std::vector<Node>& nodes = m_SubtreeNodes[subtree];
+					uint32_t base = bases[subtree];
+					for (uint32_t node = 0; node < nodes.size(); node++)
+					{
+						Node moved = nodes[node];
+						if (moved.childCount > 0)
+						{
+							moved.firstChild = base + moved.firstChild - 1;
+						}
+						m_Nodes[node == 0 ? m_Subtrees[subtree].node : base + node - 1] = moved;
+					}
+				}
+			});
+
+		for (uint32_t node = topCount; node-- > 0;)
+		{
+			ComputeMass(m_Nodes, node);
+		}
+
+		for (uint32_t node = 0; node < m_Nodes.size(); node++)
+		{
+			if (m_Nodes[node].childCount == 0)
+			{
+				m_Leaves.push_back(node);
+			}
+		}
+	}
+
+	m_Stats.bodies = count;
+	m_Stats.nodes = static_cast<uint32_t>(m_Nodes.size());
+	m_Stats.leaves = static_cast<uint32_t>(m_Leaves.size());
+	m_Stats.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BarnesHut::BuildNode(std::vector<Node>& nodes, uint32_t node, uint32_t begin, uint32_t end, uint32_t level,
+	uint32_t stopLevel)
+{
+	Node& filled = nodes[node];
+	filled.begin = begin;
+	filled.end = end;
+	filled.firstChild = 0;
+	filled.childCount = 0;
+
+	if (end - begin <= LeafSize || level == MaxLevel)
+	{
+		return;
+	}
+	if (level == stopLevel)
+	{
+		m_Subtrees.push_back({ node, begin, end });
+		return;
+	}
+
+	// The bodies are sorted, so each quadrant (the next 2 bits of the code) is one run of them
+	const std::vector<uint32_t>& codes = m_MortonOrder.GetCodes();
+	uint32_t shift = 30 - 2 * level;
+	uint32_t quadrantStart[5] = { begin, 0, 0, 0, end };
+	for (uint32_t quadrant = 1; quadrant < 4; quadrant++)
+	{
+		auto first = codes.begin() + quadrantStart[quadrant - 1];
+		auto last = codes.begin() + end;
+		quadrantStart[quadrant] = static_cast<uint32_t>(std::partition_point(first, last, [&](uint32_t code)
+			{
+				return ((code >> shift) & 3) < quadrant;
+			}) - codes.begin());
+	}
+
+	uint32_t childCount = 0;
+	for (uint32_t quadrant = 0; quadrant < 4; quadrant++)
+	{
+		childCount += (quadrantStart[quadrant + 1] > quadrantStart[quadrant]) ? 1 : 0;
+	}
+
+	// nodes can grow while the children are built, so the node is only reached by index
+	uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+	nodes.resize(nodes.size() + childCount);
+	nodes[node].firstChild = firstChild;
+	nodes[node].childCount = childCount;
+
+	uint32_t child = firstChild;
+	for (uint32_t quadrant = 0; quadrant < 4; quadrant++)
+	{
+		if (quadrantStart[quadrant + 1] > quadrantStart[quadrant])
+		{
+			BuildNode(nodes, child++, quadrantStart[quadrant], quadrantStart[quadrant + 1], level + 1, stopLevel);
+		}
+	}
+}
+
+void BarnesHut::ComputeMass(std::vector<Node>& nodes, uint32_t node) const
+{
+	Node& computed = nodes[node];
+	float mass = 0.0f;
+	float momentX = 0.0f;
+	float momentY = 0.0f;
+	AABB& bounds = computed.bounds;
+	if (computed.childCount == 0)
+	{
+		bounds = { m_X[computed.begin], m_Y[computed.begin], m_X[computed.begin], m_Y[computed.begin] };
+		for (uint32_t i = computed.begin; i < computed.end; i++)
+		{
+			mass += m_Mass[i];
+			momentX += m_Mass[i] * m_X[i];
+			momentY += m_Mass[i] * m_Y[i];
+			bounds.minX = std::min(bounds.minX, m_X[i]);
+			bounds.minY = std::min(bounds.minY, m_Y[i]);
+			bounds.maxX = std::max(bounds.maxX, m_X[i]);
+			bounds.maxY = std::max(bounds.maxY, m_Y[i]);
+		}
+	}
+	else
+	{
+		bounds = nodes[computed.firstChild].bounds;
+		for (uint32_t child = computed.firstChild; child < computed.firstChild + computed.childCount; child++)
+		{
+			const Node& childNode = nodes[child];
+			mass += childNode.mass;
+			momentX += childNode.mass * childNode.massX;
+			momentY += childNode.mass * childNode.massY;
+			bounds.minX = std::min(bounds.minX, childNode.bounds.minX);
+			bounds.minY = std::min(bounds.minY, childNode.bounds.minY);
+			bounds.maxX = std::max(bounds.maxX, childNode.bounds.maxX);
+			bounds.maxY = std::max(bounds.maxY, childNode.bounds.maxY);
+		}
+	}
+
+	computed.mass = mass;
+	computed.massX = momentX / mass;
+	computed.massY = momentY / mass;
+	float cornerX = std::max(computed.massX - bounds.minX, bounds.maxX - computed.massX);
+	float cornerY = std::max(computed.massY - bounds.minY, bounds.maxY - computed.massY);
+	computed.radius = std::sqrt(cornerX * cornerX + cornerY * cornerY);
+}
+
+void BarnesHut::ComputeAccelerations(JobSystem& jobs)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	uint32_t leafCount = static_cast<uint32_t>(m_Leaves.size());
+	uint32_t chunkCount = (leafCount + LeavesPerJob - 1) / LeavesPerJob;
+	m_ChunkInteractions.assign(chunkCount, 0);
+
+	float openingAngleSquared = m_OpeningAngle * m_OpeningAngle;
+	float softeningSquared = m_Softening * m_Softening;
+	jobs.ParallelFor(leafCount, LeavesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			// What pulls on the current leaf: far nodes as point masses and near bodies one by one
+			std::vector<float> pointX;
+			std::vector<float> pointY;
+			std::vector<float> pointMass;
+			std::vector<uint32_t> stack;
+			uint64_t interactions = 0;
+
+			for (uint32_t leaf = begin; leaf < end; leaf++)
+			{
+				const Node& leafNode = m_Nodes[m_Leaves[leaf]];
+				const AABB& leafBounds = leafNode.bounds;
+
+				pointX.clear();
+				pointY.clear();
+				pointMass.clear();
+				stack.clear();
+				stack.push_back(0);
+				while (!stack.empty())
+				{
+					const Node& node = m_Nodes[stack.back()];
+					stack.pop_back();
+
+					// Distance from the centre of mass to the nearest body the leaf could hold.
+					// Nodes holding the leaf itself are always opened
+					float dx = std::max(std::max(leafBounds.minX - node.massX, node.massX - leafBounds.maxX), 0.0f);
+					float dy = std::max(std::max(leafBounds.minY - node.massY, node.massY - leafBounds.maxY), 0.0f);
+					bool holdsLeaf = leafNode.begin >= node.begin && leafNode.begin < node.end;
+					if (!holdsLeaf && node.radius * node.radius < openingAngleSquared * (dx * dx + dy * dy))
+					{
+						pointX.push_back(node.massX);
+						pointY.push_back(node.massY);
+						pointMass.push_back(node.mass);
+					}
+					else if (node.childCount == 0)
+					{
+						pointX.insert(pointX.end(), m_X.begin() + node.begin, m_X.begin() + node.end);
+						pointY.insert(pointY.end(), m_Y.begin() + node.begin, m_Y.begin() + node.end);
+						pointMass.insert(pointMass.end(), m_Mass.begin() + node.begin, m_Mass.begin() + node.end);
+					}
+					else
+					{
+						for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++)
+						{
+							stack.push_back(child);
+						}
+					}
+				}
+
+				for (uint32_t i = leafNode.begin; i < leafNode.end; i++)
+				{
+					float accelerationX = 0.0f;
+					float accelerationY = 0.0f;
+					AccumulateAttraction(m_X[i], m_Y[i], pointX.data(), pointY.data(), pointMass.data(), pointX.size(),
+						softeningSquared, accelerationX, accelerationY);
+					m_AccelerationX[i] = accelerationX;
+					m_AccelerationY[i] = accelerationY;
+				}
+				interactions += static_cast<uint64_t>(pointX.size()) * (leafNode.end - leafNode.begin);
+			}
+
+			m_ChunkInteractions[begin / LeavesPerJob] = interactions;
+		});
+
+	uint64_t interactions = 0;
+	for (uint64_t chunkInteractions : m_ChunkInteractions)
+	{
+		interactions += chunkInteractions;
+	}
+	m_Stats.interactionsPerBody = m_Bodies.empty() ? 0.0f :
+		static_cast<float>(static_cast<double>(interactions) / static_cast<double>(m_Bodies.size()));
+	m_Stats.forceMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+NBodyError BarnesHut::MeasureError(uint32_t sampleCount) const
+{
+	NBodyError error = { 0, 0.0, 0.0 };
+	size_t count = m_Bodies.size();
+	if (count == 0)
+	{
+		return error;
+	}
+
+	double softeningSquared = static_cast<double>(m_Softening) * m_Softening;
+	double sumSquared = 0.0;
+	double sumDifferenceSquared = 0.0;
+	double maxDifferenceSquared = 0.0;
+	sampleCount = static_cast<uint32_t>(std::min<size_t>(sampleCount, count));
+	for (uint32_t sample = 0; sample < sampleCount; sample++)
+	{
+		size_t body = sample * count / sampleCount;
+		double accelerationX = 0.0;
+		double accelerationY = 0.0;
+		for (size_t other = 0; other < count; other++)
+		{
+			double dx = static_cast<double>(m_X[other]) - m_X[body];
+			double dy = static_cast<double>(m_Y[other]) - m_Y[body];
+			double distanceSquared = dx * dx + dy * dy;
+			if (distanceSquared == 0.0)
+			{
+				continue;
+			}
+
+			double inverseDistance = 1.0 / std::sqrt(distanceSquared + softeningSquared);
+			double strength = m_Mass[other] * inverseDistance * inverseDistance * inverseDistance;
+			accelerationX += dx * strength;
+			accelerationY += dy * strength;
+		}
+
+		double differenceX = m_AccelerationX[body] - accelerationX;
+		double differenceY = m_AccelerationY[body] - accelerationY;
+		double differenceSquared = differenceX * differenceX + differenceY * differenceY;
+		sumDifferenceSquared += differenceSquared;
+		sumSquared += accelerationX * accelerationX + accelerationY * accelerationY;
+		maxDifferenceSquared = std::max(maxDifferenceSquared, differenceSquared);
+	}
+
+	// Against the typical pull rather than each body's own, which can be close to nothing
+	// wherever the pulls from both sides cancel out
+	double typicalSquared = sumSquared / sampleCount;
+	error.samples = sampleCount;
+	error.rmsError = (typicalSquared > 0.0) ? std::sqrt(sumDifferenceSquared / sampleCount / typicalSquared) : 0.0;
+	error.maxError = (typicalSquared > 0.0) ? std::sqrt(maxDifferenceSquared / typicalSquared) : 0.0;
+	return error;
+}
\ No newline at end of file
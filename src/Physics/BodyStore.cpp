@@ -0,0 +1,232 @@
+#include "Physics/BodyStore.h"
+#include <algorithm>
+
+BodyStore::BodyStore()
+	: m_AspectRatio(1.0f)
+{
+}
+
+BodyHandle BodyStore::Add(const Shape& shape)
+{
+	uint32_t index = static_cast<uint32_t>(x.size());
+
+	uint32_t bodySlot;
+	if (!m_FreeSlots.empty())
+	{
+		bodySlot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		bodySlot = static_cast<uint32_t>(m_SlotIndex.size());
+		m_SlotIndex.push_back(InvalidIndex);
+		m_SlotGeneration.push_back(0);
+	}
+	m_SlotIndex[bodySlot] = index;
+
+	x.push_back(shape.x);
+	y.push_back(shape.y);
+	prevX.push_back(shape.x);
+	prevY.push_back(shape.y);
+	xVcty.push_back(shape.xVcty);
+	yVcty.push_back(shape.yVcty);
+	halfWidth.push_back(0.0f);
+	halfHeight.push_back(0.0f);
+	type.push_back(shape.shape);
+	noMovement.push_back(shape.noMovement);
+	sensor.push_back(0);
+	asleep.push_back(0);
+	sleepTime.push_back(0.0f);
+	restX.push_back(shape.x);
+	restY.push_back(shape.y);
+	island.push_back(0);
+	filter.push_back(PackFilter(DefaultCollisionFilter));
+
+	// Mass is the size of the body, like the old impulse maths used
+	bool isStatic = (shape.shape == ShapeType::Ground || shape.shape == ShapeType::Wall);
+	invMass.push_back(isStatic ? 0.0f : 1.0f / shape.size);
+
+	size.push_back(shape.size);
+	width.push_back(shape.width);
+	color.push_back(PackColor(shape.r, shape.g, shape.b, shape.a));
+	slot.push_back(bodySlot);
+
+	ComputeHalfExtents(index);
+	return { bodySlot, m_SlotGeneration[bodySlot] };
+}
+
+void BodyStore::Remove(BodyHandle handle)
+{
+	uint32_t index = IndexOf(handle);
+	if (index != InvalidIndex)
+	{
+		RemoveAt(index);
+	}
+}
+
+void BodyStore::RemoveAt(uint32_t index)
+{
+	// Retire the slot first, then let the last body take over index
+	uint32_t removedSlot = slot[index];
+	m_SlotIndex[removedSlot] = InvalidIndex;
+	m_SlotGeneration[removedSlot]++;
+	m_FreeSlots.push_back(removedSlot);
+
+	uint32_t last = static_cast<uint32_t>(x.size()) - 1;
+	if (index != last)
+	{
+		m_SlotIndex[slot[last]] = index;
+	}
+
+	MoveLastTo(x, index);
+	MoveLastTo(y, index);
+	MoveLastTo(prevX, index);
+	MoveLastTo(prevY, index);
+	MoveLastTo(xVcty, index);
+	MoveLastTo(yVcty, index);
+	MoveLastTo(halfWidth, index);
+	MoveLastTo(halfHeight, index);
+	MoveLastTo(invMass, index);
+	MoveLastTo(type, index);
+	MoveLastTo(noMovement, index);
+	MoveLastTo(sensor, index);
+	MoveLastTo(asleep, index);
+	MoveLastTo(sleepTime, index);
+	MoveLastTo(restX, index);
+	MoveLastTo(restY, index);
+	MoveLastTo(island, index);
+	MoveLastTo(filter, index);
+	MoveLastTo(size, index);
+	MoveLastTo(width, index);
+	MoveLastTo(color, index);
+	MoveLastTo(slot, index);
+}
+
+void BodyStore::Reorder(const std::vector<uint32_t>& order)
+{
+	Gather(x, order);
+	Gather(y, order);
+	Gather(prevX, order);
+	Gather(prevY, order);
+	Gather(xVcty, order);
+	Gather(yVcty, order);
+	Gather(halfWidth, order);
+	Gather(halfHeight, order);
+	Gather(invMass, order);
+	Gather(type, order);
+	Gather(noMovement, order);
+	Gather(sensor, order);
+	Gather(asleep, order);
+	Gather(sleepTime, order);
+	Gather(restX, order);
+	Gather(restY, order);
+	Gather(island, order);
+	Gather(filter, order);
+	Gather(size, order);
+	Gather(width, order);
+	Gather(color, order);
+	Gather(slot, order);
+
+	for (uint32_t i = 0; i < slot.size(); i++)
+	{
+		m_SlotIndex[slot[i]] = i;
+	}
+}
+
+bool BodyStore::IsValid(BodyHandle handle) const
+{
+	return handle.slot < m_SlotIndex.size() && m_SlotGeneration[handle.slot] == handle.generation &&
+		m_SlotIndex[handle.slot] != InvalidIndex;
+}
+
+uint32_t BodyStore::IndexOf(BodyHandle handle) const
+{
+	return IsValid(handle) ? m_SlotIndex[handle.slot] : InvalidIndex;
+}
+
+BodyHandle BodyStore::HandleAt(uint32_t index) const
+{
+	return { slot[index], m_SlotGeneration[slot[index]] };
+}
+
+void BodyStore::Clear()
+{
+	// Every live slot is retired so no handle from before the clear resolves afterwards
+	for (uint32_t bodySlot : slot)
+	{
+		m_SlotIndex[bodySlot] = InvalidIndex;
+		m_SlotGeneration[bodySlot]++;
+		m_FreeSlots.push_back(bodySlot);
+	}
+
+	x.clear();
+	y.clear();
+	prevX.clear();
+	prevY.clear();
+	xVcty.clear();
+	yVcty.clear();
+	halfWidth.clear();
+	halfHeight.clear();
+	invMass.clear();
+	type.clear();
+	noMovement.clear();
+	sensor.clear();
+	asleep.clear();
+	sleepTime.clear();
+	restX.clear();
+	restY.clear();
+	island.clear();
+	filter.clear();
+	size.clear();
+	width.clear();
+	color.clear();
+	slot.clear();
+}
+
+void BodyStore::SetAspectRatio(float aspectRatio)
+{
+	m_AspectRatio = aspectRatio;
+	for (uint32_t i = 0; i < x.size(); i++)
+	{
+		ComputeHalfExtents(i);
+	}
+}
+
+void BodyStore::ComputeHalfExtents(uint32_t index)
+{
+	// Circles are drawn with a radius of size / 3.5 and squares are size across, the
+	// rectangle types (ground, walls) use width for their horizontal extent
+	if (type[index] == ShapeType::Circle)
+	{
+		halfHeight[index] = size[index] / 3.5f;
+		halfWidth[index] = halfHeight[index] / m_AspectRatio;
+	}
+	else if (type[index] == ShapeType::Square)
+	{
+		halfHeight[index] = size[index] / 2.0f;
+		halfWidth[index] = halfHeight[index] / m_AspectRatio;
+	}
+	else
+	{
+		halfHeight[index] = size[index] / 2.0f;
+		halfWidth[index] = (width[index] / 2.0f) / m_AspectRatio;
+	}
+}
+
+uint32_t BodyStore::PackColor(float r, float g, float b, float a)
+{
+	auto toByte = [](float channel)
+		{
+			return static_cast<uint32_t>(std::min(std::max(channel, 0.0f), 1.0f) * 255.0f + 0.5f);
+		};
+
+	return toByte(r) | (toByte(g) << 8) | (toByte(b) << 16) | (toByte(a) << 24);
+}
+
+void BodyStore::UnpackColor(uint32_t color, float& r, float& g, float& b, float& a)
+{
+	r = (color & 0xFF) / 255.0f;
+	g = ((color >> 8) & 0xFF) / 255.0f;
+	b = ((color >> 16) & 0xFF) / 255.0f;
+	a = ((color >> 24) & 0xFF) / 255.0f;
+}
\ No newline at end of file
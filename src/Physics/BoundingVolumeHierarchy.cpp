@@ -0,0 +1,98 @@
+#include "Physics/BoundingVolumeHierarchy.h"
+#include <algorithm>
+
+namespace
+{
+	inline AABB Combine(const AABB& first, const AABB& second)
+	{
+		return { std::min(first.minX, second.minX), std::min(first.minY, second.minY),
+			std::max(first.maxX, second.maxX), std::max(first.maxY, second.maxY) };
+	}
+
+	// Touching counts, the exact tests afterwards decide
+	inline bool Touches(const AABB& first, const AABB& second)
+	{
+		return first.minX <= second.maxX && first.maxX >= second.minX &&
+			first.minY <= second.maxY && first.maxY >= second.minY;
+	}
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+	: m_AspectRatio(1.0f)
+{
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<AABB>& bounds, float aspectRatio)
+{
+	m_Bounds = bounds;
+	m_AspectRatio = aspectRatio;
+	m_Nodes.clear();
+	m_Order.resize(m_Bounds.size());
+	for (uint32_t i = 0; i < m_Order.size(); i++)
+	{
+		m_Order[i] = i;
+	}
+
+	if (!m_Order.empty())
+	{
+		m_Nodes.reserve(2 * m_Order.size() / ItemsPerLeaf + 1);
+		BuildNode(0, static_cast<uint32_t>(m_Order.size()));
+	}
+}
+
+void BoundingVolumeHierarchy::Clear()
+{
+	m_Bounds.clear();
+	m_Nodes.clear();
+	m_Order.clear();
+}
+
+void BoundingVolumeHierarchy::BuildNode(uint32_t begin, uint32_t end)
+{
+	uint32_t node = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.push_back({ m_Bounds[m_Order[begin]], begin, end - begin });
+
+	AABB box = m_Bounds[m_Order[begin]];
+	for (uint32_t i = begin + 1; i < end; i++)
+	{
+		box = Combine(box, m_Bounds[m_Order[i]]);
+	}
+	m_Nodes[node].box = box;
+
+	if (end - begin <= ItemsPerLeaf)
+	{
+		return;
+	}
+
+	// Split the centres at the median of the longer side, halves of equal size keep the depth at log n
+	bool splitX = (box.maxX - box.minX) * m_AspectRatio > (box.maxY - box.minY);
+	uint32_t middle = begin + (end - begin) / 2;
+	std::nth_element(m_Order.begin() + begin, m_Order.begin() + middle, m_Order.begin() + end,
+		[&](uint32_t first, uint32_t second)
+		{
+			const AABB& a = m_Bounds[first];
+			const AABB& b = m_Bounds[second];
+			return splitX ? (a.minX + a.maxX < b.minX + b.maxX) : (a.minY + a.maxY < b.minY + b.maxY);
+		});
+
+	BuildNode(begin, middle);
+	m_Nodes[node].first = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes[node].count = 0;
+	BuildNode(middle, end);
+}
+
+void BoundingVolumeHierarchy::Query(const AABB& box, std::vector<uint32_t>& items) const
+{
+	items.clear();
+	Traverse([&](const AABB& nodeBox) { return Touches(nodeBox, box) ? 0.0f : -1.0f; },
+		[&](uint32_t item)
+		{
+			if (Touches(m_Bounds[item], box))
+			{
+				items.push_back(item);
+			}
+		});
+
+	// Same order as looping over every item
+	std::sort(items.begin(), items.end());
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "Physics/BroadPhase.h"
+#include "Physics/UniformGrid.h"
+#include "Physics/SweepAndPrune.h"
+#include "Physics/DynamicTree.h"
+
+BruteForceBroadPhase::BruteForceBroadPhase()
+	: m_Bounds(nullptr)
+{
+}
+
+void BruteForceBroadPhase::Update(const std::vector<AABB>& bounds)
+{
+	m_Bounds = &bounds;
+}
+
+void BruteForceBroadPhase::FindPairs(std::vector<BodyPair>& pairs) const
+{
+	pairs.clear();
+	if (!m_Bounds)
+	{
+		return;
+	}
+
+	const std::vector<AABB>& bounds = *m_Bounds;
+	uint32_t filtered = 0;
+	for (uint32_t i = 0; i < bounds.size(); i++)
+	{
+		for (uint32_t j = i + 1; j < bounds.size(); j++)
+		{
+			if (Overlaps(bounds[i], bounds[j]))
+			{
+				if (Accepts(i, j))
+				{
+					pairs.push_back({ i, j });
+				}
+				else
+				{
+					filtered++;
+				}
+			}
+		}
+	}
+	AddFilteredPairs(filtered);
+}
+
+BroadPhase* CreateBroadPhase(BroadPhaseType type)
+{
+	switch (type)
+	{
+	case BroadPhaseType::BruteForce:
+		return new BruteForceBroadPhase();
+	case BroadPhaseType::SweepAndPrune:
+		return new SweepAndPrune();
+	case BroadPhaseType::DynamicTree:
+		return new DynamicTree();
+	case BroadPhaseType::UniformGrid:
+	default:
+		return new UniformGrid();
+	}
+}
\ No newline at end of file
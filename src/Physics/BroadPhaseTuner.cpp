@@ -0,0 +1,320 @@
+#include "Physics/BroadPhaseTuner.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+	inline bool Changed(float now, float tunedFor, float drift)
+	{
+		return std::abs(now - tunedFor) > drift * std::max(tunedFor, 1e-6f);
+	}
+
+	// Grid cell sizes within 10% of each other count as the same setting
+	inline bool SameConfig(const BroadPhaseConfig& first, const BroadPhaseConfig& second)
+	{
+		if (first.type != second.type || first.type != BroadPhaseType::UniformGrid)
+		{
+			return first.type == second.type;
+		}
+
+		bool firstAutomatic = first.cellSize <= 0.0f;
+		bool secondAutomatic = second.cellSize <= 0.0f;
+		return firstAutomatic == secondAutomatic && (firstAutomatic || !Changed(first.cellSize, second.cellSize, 0.1f));
+	}
+
+	std::string ConfigName(const BroadPhaseConfig& config)
+	{
+		std::ostringstream name;
+		name << BroadPhaseTuner::TypeName(config.type);
+		if (config.type == BroadPhaseType::UniformGrid)
+		{
+			if (config.cellSize > 0.0f)
+			{
+				name << " (cell " << config.cellSize << ")";
+			}
+			else
+			{
+				name << " (cell = largest body)";
+			}
+		}
+		return name.str();
+	}
+}
+
+BroadPhaseTuner::BroadPhaseTuner()
+	: m_Current({ BroadPhaseType::UniformGrid, 0.0f }), m_Features(), m_TunedFeatures(), m_Step(0), m_LastTuneStep(0),
+	m_BroadPhaseMilliseconds(0.0), m_PairTestMilliseconds(0.0), m_Trialling(false),
+	m_Trial(0), m_TrialStep(0), m_DecisionCount(0)
+{
+	for (int type = 0; type < BroadPhaseTypeCount; type++)
+	{
+		m_TypeSlowdown[type] = 1.0;
+		m_TypeBodies[type] = 0;
+	}
+}
+
+void BroadPhaseTuner::Reset(const BroadPhaseConfig& config)
+{
+	// Nothing tuned for yet, so the first check always counts as drifted
+	m_Current = config;
+	m_TunedFeatures = Features();
+	m_LastTuneStep = m_Step;
+	m_BroadPhaseMilliseconds = 0.0;
+	m_PairTestMilliseconds = 0.0;
+	m_Trialling = false;
+}
+
+const char* BroadPhaseTuner::TypeName(BroadPhaseType type)
+{
+	switch (type)
+	{
+	case BroadPhaseType::BruteForce:
+		return "Brute Force";
+	case BroadPhaseType::SweepAndPrune:
+		return "Sweep And Prune";
+	case BroadPhaseType::DynamicTree:
+		return "Dynamic AABB Tree";
+	case BroadPhaseType::UniformGrid:
+	default:
+		return "Uniform Grid";
+	}
+}
+
+BroadPhaseConfig BroadPhaseTuner::Sample(const std::vector<AABB>& bounds, double broadPhaseMilliseconds,
+	double pairTestMilliseconds)
+{
+	m_Step++;
+	m_Features = Measure(bounds);
+
+	if (m_Trialling)
+	{
+		if (m_TrialStep > 0)
+		{
+			m_CandidateMilliseconds[m_Trial] += broadPhaseMilliseconds;
+			m_CandidateSteps[m_Trial]++;
+		}
+
+		bool givingUp = false;
+		if (m_Trial > 0 && m_CandidateSteps[m_Trial] > 0)
+		{
+			double best = m_CandidateMilliseconds[0] / m_CandidateSteps[0];
+			for (size_t i = 1; i < m_Trial; i++)
+			{
+				best = std::min(best, m_CandidateMilliseconds[i] / m_CandidateSteps[i]);
+			}
+			givingUp = m_CandidateMilliseconds[m_Trial] / m_CandidateSteps[m_Trial] > best * GiveUp;
+		}
+
+		if (++m_TrialStep < TrialSteps && !givingUp)
+		{
+			return m_Current;
+		}
+
+		m_TrialStep = 0;
+		if (++m_Trial < m_Candidates.size())
+		{
+			m_Current = m_Candidates[m_Trial];
+			return m_Current;
+		}
+
+		FinishTrials();
+		return m_Current;
+	}
+
+	// Averaged over roughly the last 16 steps
+	if (m_BroadPhaseMilliseconds == 0.0 && m_PairTestMilliseconds == 0.0)
+	{
+		m_BroadPhaseMilliseconds = broadPhaseMilliseconds;
+		m_PairTestMilliseconds = pairTestMilliseconds;
+	}
+	m_BroadPhaseMilliseconds += (broadPhaseMilliseconds - m_BroadPhaseMilliseconds) * 0.0625;
+	m_PairTestMilliseconds += (pairTestMilliseconds - m_PairTestMilliseconds) * 0.0625;
+
+	if (m_Step % CheckInterval != 0 || m_Features.bodies < 2)
+	{
+		return m_Current;
+	}
+
+	bool drifted = HasDrifted();
+	if (!drifted && m_Step - m_LastTuneStep < RetuneInterval)
+	{
+		return m_Current;
+	}
+
+	double collisionMilliseconds = m_BroadPhaseMilliseconds + m_PairTestMilliseconds;
+	double share = (collisionMilliseconds > 0.0) ? m_BroadPhaseMilliseconds / collisionMilliseconds : 0.0;
+	if (share < MinShare)
+	{
+		std::ostringstream reason;
+		reason << (drifted ? "scene changed" : "retune due") << " but the broadphase is only "
+			<< static_cast<int>(share * 100.0) << "% of " << collisionMilliseconds << " ms collision time, kept";
+		Log(m_Current, reason.str());
+
+		m_TunedFeatures = m_Features;
+		m_LastTuneStep = m_Step;
+		return m_Current;
+	}
+
+	StartTrials();
+	return m_Current;
+}
+
+BroadPhaseTuner::Features BroadPhaseTuner::Measure(const std::vector<AABB>& bounds)
+{
+	Features features = Features();
+	features.bodies = static_cast<uint32_t>(bounds.size());
+	if (bounds.empty())
+	{
+		return features;
+	}
+
+	float minX = bounds[0].minX, minY = bounds[0].minY;
+	float maxX = bounds[0].maxX, maxY = bounds[0].maxY;
+	double extentSum = 0.0;
+	double areaSum = 0.0;
+	for (const AABB& box : bounds)
+	{
+		minX = std::min(minX, box.minX);
+		minY = std::min(minY, box.minY);
+		maxX = std::max(maxX, box.maxX);
+		maxY = std::max(maxY, box.maxY);
+
+		float width = box.maxX - box.minX;
+		float height = box.maxY - box.minY;
+		float extent = std::max(width, height);
+		extentSum += extent;
+		areaSum += static_cast<double>(width) * height;
+		features.largestExtent = std::max(features.largestExtent, extent);
+	}
+
+	double occupied = static_cast<double>(maxX - minX) * (maxY - minY);
+	features.meanExtent = static_cast<float>(extentSum / bounds.size());
+	features.density = (occupied > 0.0) ? static_cast<float>(areaSum / occupied) : 0.0f;
+	return features;
+}
+
+bool BroadPhaseTuner::HasDrifted() const
+{
+	return m_TunedFeatures.bodies == 0 ||
+		Changed(static_cast<float>(m_Features.bodies), static_cast<float>(m_TunedFeatures.bodies), Drift) ||
+		Changed(m_Features.meanExtent, m_TunedFeatures.meanExtent, Drift) ||
+		Changed(m_Features.largestExtent, m_TunedFeatures.largestExtent, Drift) ||
+		Changed(m_Features.density, m_TunedFeatures.density, Drift);
+}
+
+void BroadPhaseTuner::StartTrials()
+{
+	// The current setting runs first so it is timed on the same scene as the others
+	m_Candidates.clear();
+	m_Candidates.push_back(m_Current);
+
+	std::vector<BroadPhaseConfig> options =
+	{
+		{ BroadPhaseType::UniformGrid, 0.0f },
+		{ BroadPhaseType::UniformGrid, m_Features.meanExtent },
+		{ BroadPhaseType::UniformGrid, m_Features.meanExtent * 2.0f },
+		{ BroadPhaseType::SweepAndPrune, 0.0f },
+		{ BroadPhaseType::DynamicTree, 0.0f },
+	};
+	if (m_Features.bodies <= BruteForceBodies)
+	{
+		options.push_back({ BroadPhaseType::BruteForce, 0.0f });
+	}
+
+	std::ostringstream skipped;
+	for (const BroadPhaseConfig& option : options)
+	{
+		// Grids are cheap to try, a type that lost badly with about this many bodies isn't
+		int type = static_cast<int>(option.type);
+		bool lostBadly = option.type != BroadPhaseType::UniformGrid && option.type != m_Current.type &&
+			m_TypeSlowdown[type] > SkipSlowdown && m_Features.bodies < m_TypeBodies[type] * 2 &&
+			m_Features.bodies * 2 > m_TypeBodies[type];
+		if (lostBadly)
+		{
+			skipped << ", skipping " << TypeName(option.type) << " (" << m_TypeSlowdown[type] << "x slower last time)";
+			continue;
+		}
+
+		// Cell sizes close to the largest body are what the automatic size does already
+		bool nearLargest = option.type == BroadPhaseType::UniformGrid && option.cellSize > 0.0f &&
+			!Changed(option.cellSize, m_Features.largestExtent, 0.2f);
+		bool listed = std::any_of(m_Candidates.begin(), m_Candidates.end(),
+			[&](const BroadPhaseConfig& candidate) { return SameConfig(candidate, option); });
+		if (!nearLargest && !listed)
+		{
+			m_Candidates.push_back(option);
+		}
+	}
+
+	m_CandidateMilliseconds.assign(m_Candidates.size(), 0.0);
+	m_CandidateSteps.assign(m_Candidates.size(), 0);
+	m_Trial = 0;
+	m_TrialStep = 0;
+	m_Trialling = true;
+
+	std::ostringstream reason;
+	reason << "trying " << m_Candidates.size() << " settings: " << m_Features.bodies << " bodies, mean size "
+		<< m_Features.meanExtent << ", largest " << m_Features.largestExtent << ", density " << m_Features.density
+		<< ", broadphase " << m_BroadPhaseMilliseconds << " ms, pair tests " << m_PairTestMilliseconds << " ms"
+		<< skipped.str();
+	Log(m_Current, reason.str());
+}
+
+void BroadPhaseTuner::FinishTrials()
+{
+	m_Trialling = false;
+
+	size_t best = 0;
+	for (size_t i = 0; i < m_Candidates.size(); i++)
+	{
+		m_CandidateMilliseconds[i] /= m_CandidateSteps[i];
+		if (m_CandidateMilliseconds[i] < m_CandidateMilliseconds[best])
+		{
+			best = i;
+		}
+	}
+
+	for (size_t i = 0; i < m_Candidates.size(); i++)
+	{
+		m_TypeSlowdown[static_cast<int>(m_Candidates[i].type)] = 0.0;
+	}
+	for (size_t i = 0; i < m_Candidates.size(); i++)
+	{
+		// Grids keep their best cell size
+		int type = static_cast<int>(m_Candidates[i].type);
+		double slowdown = m_CandidateMilliseconds[i] / std::max(m_CandidateMilliseconds[best], 1e-9);
+		m_TypeSlowdown[type] = (m_TypeSlowdown[type] == 0.0) ? slowdown : std::min(m_TypeSlowdown[type], slowdown);
+		m_TypeBodies[type] = m_Features.bodies;
+	}
+
+	// Candidate 0 is what ran before, only move off it for a clear win
+	bool switching = m_CandidateMilliseconds[best] < m_CandidateMilliseconds[0] * (1.0 - Hysteresis);
+	size_t chosen = switching ? best : 0;
+	m_Current = m_Candidates[chosen];
+
+	std::ostringstream reason;
+	reason << (switching ? "switched, " : "kept, ") << ConfigName(m_Current) << " took "
+		<< m_CandidateMilliseconds[chosen] << " ms;";
+	for (size_t i = 0; i < m_Candidates.size(); i++)
+	{
+		if (i != chosen)
+		{
+			reason << " " << ConfigName(m_Candidates[i]) << " " << m_CandidateMilliseconds[i] << " ms;";
+		}
+	}
+	Log(m_Current, reason.str());
+
+	m_TunedFeatures = m_Features;
+	m_LastTuneStep = m_Step;
+	m_BroadPhaseMilliseconds = m_CandidateMilliseconds[chosen];
+}
+
+void BroadPhaseTuner::Log(const BroadPhaseConfig& config, const std::string& reason)
+{
+	m_Decisions.push_back({ m_DecisionCount++, m_Step, config, reason });
+	if (m_Decisions.size() > MaxDecisions)
+	{
+		m_Decisions.pop_front();
+	}
+}
\ No newline at end of file
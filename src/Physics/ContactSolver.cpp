@@ -0,0 +1,543 @@
+#include "Physics/ContactSolver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+	// Static features are counted down from the top so they can't be mistaken for a body slot
+	uint64_t StaticKey(uint32_t slot, uint32_t feature)
+	{
+		return (static_cast<uint64_t>(slot) << 32) | (ContactSolver::StaticBody - feature);
+	}
+}
+
+ContactSolver::ContactSolver(float aspectRatio)
+	: m_AspectRatio(aspectRatio), m_VelocityIterations(8), m_PositionIterations(3), m_WarmStarting(true),
+	m_Friction(0.2f), m_Compliance(1e-6f), m_MaxPushVelocity(1.0f), m_RestitutionThreshold(0.2f), m_Slop(0.0005f), m_Baumgarte(0.2f), m_MaxCorrection(0.05f),
+	m_ColourStart(ColourCount + 2, 0), m_Stats()
+{
+}
+
+void ContactSolver::SetIterations(int velocityIterations, int positionIterations)
+{
+	m_VelocityIterations = std::max(1, velocityIterations);
+	m_PositionIterations = std::max(0, positionIterations);
+}
+
+void ContactSolver::SetWarmStarting(bool enabled)
+{
+	m_WarmStarting = enabled;
+	if (!enabled)
+	{
+		m_Cache.clear();
+	}
+}
+
+void ContactSolver::SetFriction(float friction)
+{
+	m_Friction = std::max(0.0f, friction);
+}
+
+void ContactSolver::SetCompliance(float compliance)
+{
+	m_Compliance = std::max(0.0f, compliance);
+}
+
+ContactConstraint ContactSolver::MakeContact(const BodyStore& bodies, uint32_t a, uint32_t b,
+	float normalX, float normalY, float overlap, float restitution)
+{
+	// The impulses are the same whichever way round the pair is (the normal and the tangent both
+	// flip), so the key only has to be stable, not ordered by index
+	uint32_t slotA = bodies.slot[a];
+	uint32_t slotB = bodies.slot[b];
+	BodyHandle handleA = bodies.HandleAt(a);
+	BodyHandle handleB = bodies.HandleAt(b);
+	if (slotA > slotB)
+	{
+		std::swap(slotA, slotB);
+		std::swap(handleA, handleB);
+	}
+
+	ContactConstraint contact = {};
+	contact.a = a;
+	contact.b = b;
+	contact.key = (static_cast<uint64_t>(slotA) << 32) | slotB;
+	contact.generationA = handleA.generation;
+	contact.generationB = handleB.generation;
+	contact.normalX = normalX;
+	contact.normalY = normalY;
+	contact.overlap = overlap;
+	contact.restitution = restitution;
+	return contact;
+}
+
+ContactConstraint ContactSolver::MakeStaticContact(const BodyStore& bodies, uint32_t a, uint32_t feature,
+	float normalX, float normalY, float overlap, float restitution)
+{
+	ContactConstraint contact = {};
+	contact.a = a;
+	contact.b = StaticBody;
+	contact.key = StaticKey(bodies.slot[a], feature);
+	contact.generationA = bodies.HandleAt(a).generation;
+	contact.generationB = 0;
+	contact.normalX = normalX;
+	contact.normalY = normalY;
+	contact.overlap = overlap;
+	contact.restitution = restitution;
+	return contact;
+}
+
+void ContactSolver::AddContacts(const std::vector<ContactConstraint>& contacts)
+{
+	m_Contacts.insert(m_Contacts.end(), contacts.begin(), contacts.end());
+}
+
+void ContactSolver::Prepare(BodyStore& bodies, JobSystem& jobs)
+{
+	Colour(static_cast<uint32_t>(bodies.Size()));
+	m_Columns.Resize(m_Contacts.size());
+
+	// Only reads the bodies, so every contact can be set up in parallel
+	jobs.ParallelFor(static_cast<uint32_t>(m_Contacts.size()), ContactsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				ContactConstraint& contact = m_Contacts[i];
+				bool staticB = (contact.b == StaticBody);
+
+				contact.invMassA = bodies.noMovement[contact.a] ? 0.0f : bodies.invMass[contact.a];
+				contact.invMassB = (staticB || bodies.noMovement[contact.b]) ? 0.0f : bodies.invMass[contact.b];
+				float invMassSum = contact.invMassA + contact.invMassB;
+				contact.normalMass = invMassSum > 0.0f ? 1.0f / invMassSum : 0.0f;
+
+				// Bounces are worked out from the approach speed before any impulses, like the old
+				// collision response
+				contact.approachVelocity = NormalVelocity(bodies, contact);
+
+				contact.normalImpulse = 0.0f;
+				contact.tangentImpulse = 0.0f;
+				if (m_WarmStarting)
+				{
+					auto cached = std::lower_bound(m_Cache.begin(), m_Cache.end(), contact.key,
+						[](const CachedImpulse& entry, uint64_t key) { return entry.key < key; });
+
+					// A slot reused by a new body has a new generation, its old impulses don't carry over
+					if (cached != m_Cache.end() && cached->key == contact.key &&
+						cached->generationA == contact.generationA && cached->generationB == contact.generationB)
+					{
+						contact.normalImpulse = cached->normalImpulse;
+						contact.tangentImpulse = cached->tangentImpulse;
+					}
+				}
+
+				m_Columns.a[i] = contact.a;
+				m_Columns.b[i] = contact.b;
+				m_Columns.normalX[i] = contact.normalX;
+				m_Columns.normalY[i] = contact.normalY;
+				m_Columns.invMassA[i] = contact.invMassA;
+				m_Columns.invMassB[i] = contact.invMassB;
+				m_Columns.mass[i] = contact.normalMass;
+				m_Columns.friction[i] = m_Friction;
+				m_Columns.normalImpulse[i] = contact.normalImpulse;
+				m_Columns.tangentImpulse[i] = contact.tangentImpulse;
+			}
+		});
+
+	if (m_WarmStarting)
+	{
+		ForEachColour(jobs, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					ApplyImpulse(bodies, m_Contacts[i], m_Contacts[i].normalImpulse, m_Contacts[i].tangentImpulse);
+				}
+			});
+	}
+}
+
+void ContactSolver::SolveVelocities(BodyStore& bodies, JobSystem& jobs)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	uint32_t overflowStart = m_ColourStart[ColourCount];
+	for (int iteration = 0; iteration < m_VelocityIterations; iteration++)
+	{
+		ForEachColour(jobs, [&](uint32_t begin, uint32_t end)
+			{
+				// Overflow contacts can share bodies within a lane group, so they stay scalar
+				if (begin >= overflowStart)
+				{
+					ScalarSolveContactVelocities(m_Columns, begin, end, bodies.xVcty.data(), bodies.yVcty.data(),
+						m_AspectRatio);
+				}
+				else
+				{
+					SolveContactVelocities(m_Columns, begin, end, bodies.xVcty.data(), bodies.yVcty.data(),
+						m_AspectRatio);
+				}
+			});
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_Stats = SolverStats();
+	for (int iteration = 0; iteration < m_VelocityIterations; iteration++)
+	{
+		RecordPass(milliseconds / m_VelocityIterations);
+	}
+
+	for (size_t i = 0; i < m_Contacts.size(); i++)
+	{
+		m_Contacts[i].normalImpulse = m_Columns.normalImpulse[i];
+		m_Contacts[i].tangentImpulse = m_Columns.tangentImpulse[i];
+	}
+
+	// Bounce the contacts that were hit fast enough and are still pushing
+	ForEachColour(jobs, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const ContactConstraint& contact = m_Contacts[i];
+				if (contact.restitution == 0.0f || contact.approachVelocity > -m_RestitutionThreshold ||
+					contact.normalImpulse == 0.0f)
+				{
+					continue;
+				}
+
+				float normalVelocity = NormalVelocity(bodies, contact);
+				float impulse = -contact.normalMass * (normalVelocity + contact.restitution * contact.approachVelocity);
+				impulse = std::max(impulse, -contact.normalImpulse);
+				ApplyImpulse(bodies, contact, impulse, 0.0f);
+			}
+		});
+}
+
+void ContactSolver::SolvePositions(BodyStore& bodies, JobSystem& jobs)
+{
+	for (int iteration = 0; iteration < m_PositionIterations; iteration++)
+	{
+		// Largest overlap any range saw, merged with a compare exchange once per range
+		std::atomic<float> maxOverlap(0.0f);
+		ForEachColour(jobs, [&](uint32_t begin, uint32_t end)
+			{
+				float rangeMaxOverlap = 0.0f;
+				for (uint32_t i = begin; i < end; i++)
+				{
+					const ContactConstraint& contact = m_Contacts[i];
+					uint32_t a = contact.a;
+					uint32_t b = contact.b;
+					bool staticB = (b == StaticBody);
+
+					float overlap = CurrentOverlap(bodies, contact);
+					rangeMaxOverlap = std::max(rangeMaxOverlap, overlap);
+
+					float correction = std::min(m_Baumgarte * (overlap - m_Slop), m_MaxCorrection);
+					if (correction <= 0.0f)
+					{
+						continue;
+					}
+
+					float push = correction * contact.normalMass;
+					float pushX = contact.normalX * push / m_AspectRatio;
+					float pushY = contact.normalY * push;
+
+					bodies.x[a] -= pushX * contact.invMassA;
+					bodies.y[a] -= pushY * contact.invMassA;
+					if (!staticB)
+					{
+						bodies.x[b] += pushX * contact.invMassB;
+						bodies.y[b] += pushY * contact.invMassB;
+					}
+				}
+
+				float current = maxOverlap.load();
+				while (rangeMaxOverlap > current && !maxOverlap.compare_exchange_weak(current, rangeMaxOverlap))
+				{
+				}
+			});
+
+		// Good enough, leave the rest of the slop for the next step
+		if (maxOverlap.load() <= 3.0f * m_Slop)
+		{
+			break;
+		}
+	}
+}
+
+void ContactSolver::StoreImpulses()
+{
+	if (!m_WarmStarting)
+	{
+		return;
+	}
+
+	m_Cache.resize(m_Contacts.size());
+	for (size_t i = 0; i < m_Contacts.size(); i++)
+	{
+		const ContactConstraint& contact = m_Contacts[i];
+		m_Cache[i] = { contact.key, contact.generationA, contact.generationB, contact.normalImpulse,
+			contact.tangentImpulse };
+	}
+
+	std::sort(m_Cache.begin(), m_Cache.end(),
+		[](const CachedImpulse& first, const CachedImpulse& second) { return first.key < second.key; });
+}
+
+void ContactSolver::PrepareSubsteps(BodyStore& bodies, JobSystem& jobs)
+{
+	Colour(static_cast<uint32_t>(bodies.Size()));
+	m_Stats = SolverStats();
+
+	// Substeps are short enough that nothing is carried over from the last step
+	jobs.ParallelFor(static_cast<uint32_t>(m_Contacts.size()), ContactsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				ContactConstraint& contact = m_Contacts[i];
+				bool staticB = (contact.b == StaticBody);
+
+				contact.invMassA = bodies.noMovement[contact.a] ? 0.0f : bodies.invMass[contact.a];
+				contact.invMassB = (staticB || bodies.noMovement[contact.b]) ? 0.0f : bodies.invMass[contact.b];
+				float invMassSum = contact.invMassA + contact.invMassB;
+				contact.normalMass = invMassSum > 0.0f ? 1.0f / invMassSum : 0.0f;
+				contact.normalImpulse = 0.0f;
+				contact.tangentImpulse = 0.0f;
+			}
+		});
+}
+
+void ContactSolver::StoreApproachVelocities(const BodyStore& bodies, JobSystem& jobs)
+{
+	jobs.ParallelFor(static_cast<uint32_t>(m_Contacts.size()), ContactsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				m_Contacts[i].approachVelocity = NormalVelocity(bodies, m_Contacts[i]);
+			}
+		});
+}
+
+void ContactSolver::SolveSubstepPositions(BodyStore& bodies, JobSystem& jobs, float h)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// One pass, the substeps do the converging. normalImpulse holds this substep's positional
+	// impulse, which friction is limited by
+	float softness = m_Compliance / (h * h);
+	float maxPush = m_MaxPushVelocity * h;
+	ForEachColour(jobs, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				ContactConstraint& contact = m_Contacts[i];
+				contact.normalImpulse = 0.0f;
+
+				// The slop stays so the contact is still overlapping, and found, next step. Deep
+				// overlaps come out a little each substep, the distance becomes velocity
+				float overlap = std::min(CurrentOverlap(bodies, contact) - m_Slop, maxPush);
+				float invMassSum = contact.invMassA + contact.invMassB;
+				if (overlap <= 0.0f || invMassSum == 0.0f)
+				{
+					continue;
+				}
+
+				float push = overlap / (invMassSum + softness);
+				contact.normalImpulse = push;
+
+				float pushX = contact.normalX * push / m_AspectRatio;
+				float pushY = contact.normalY * push;
+				bodies.x[contact.a] -= pushX * contact.invMassA;
+				bodies.y[contact.a] -= pushY * contact.invMassA;
+				if (contact.b != StaticBody)
+				{
+					bodies.x[contact.b] += pushX * contact.invMassB;
+					bodies.y[contact.b] += pushY * contact.invMassB;
+				}
+			}
+		});
+
+	m_Stats.velocityMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ContactSolver::SolveSubstepVelocities(BodyStore& bodies, JobSystem& jobs, float h, float gravity)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Approaches slower than gravity adds over a couple of substeps are resting, not bouncing
+	float restingVelocity = std::max(2.0f * gravity * h, m_RestitutionThreshold);
+	ForEachColour(jobs, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const ContactConstraint& contact = m_Contacts[i];
+				if (contact.normalImpulse == 0.0f)
+				{
+					continue;
+				}
+
+				uint32_t a = contact.a;
+				uint32_t b = contact.b;
+				bool staticB = (b == StaticBody);
+				float relativeX = ((staticB ? 0.0f : bodies.xVcty[b]) - bodies.xVcty[a]) * m_AspectRatio;
+				float relativeY = (staticB ? 0.0f : bodies.yVcty[b]) - bodies.yVcty[a];
+				float normalVelocity = relativeX * contact.normalX + relativeY * contact.normalY;
+				float tangentVelocity = -relativeX * contact.normalY + relativeY * contact.normalX;
+
+				// Sliding slows by at most friction times the normal force over the substep, the
+				// velocity that force gives the pair is the positional impulse over h and the mass
+				float maxFriction = m_Friction * contact.normalImpulse / (h * contact.normalMass);
+				float frictionChange = -std::min(std::max(tangentVelocity, -maxFriction), maxFriction);
+
+				// Replace whatever the position pass left along the normal with the bounce, if any
+				float bounce = contact.approachVelocity < -restingVelocity ?
+					-contact.restitution * contact.approachVelocity : 0.0f;
+				float normalChange = bounce - normalVelocity;
+
+				ApplyImpulse(bodies, contact, normalChange * contact.normalMass, frictionChange * contact.normalMass);
+			}
+		});
+
+	RecordPass(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+uint32_t ContactSolver::GetColourCount() const
+{
+	uint32_t colours = 0;
+	for (uint32_t colour = 0; colour < ColourCount; colour++)
+	{
+		if (m_ColourStart[colour + 1] > m_ColourStart[colour])
+		{
+			colours = colour + 1;
+		}
+	}
+	return colours;
+}
+
+uint32_t ContactSolver::GetOverflowCount() const
+{
+	return m_ColourStart[ColourCount + 1] - m_ColourStart[ColourCount];
+}
+
+void ContactSolver::Colour(uint32_t bodyCount)
+{
+	// Greedy: every contact takes the lowest colour neither of its bodies uses yet. Static
+	// geometry is never written, so it doesn't take part
+	const uint32_t allColours = (1u << ColourCount) - 1;
+	m_BodyColours.assign(bodyCount, 0);
+	m_ContactColour.resize(m_Contacts.size());
+	m_ColourStart.assign(ColourCount + 2, 0);
+
+	for (size_t i = 0; i < m_Contacts.size(); i++)
+	{
+		uint32_t a = m_Contacts[i].a;
+		uint32_t b = m_Contacts[i].b;
+		bool staticB = (b == StaticBody);
+
+		uint32_t used = m_BodyColours[a] | (staticB ? 0 : m_BodyColours[b]);
+		uint32_t colour = ColourCount;
+		if (used != allColours)
+		{
+			colour = 0;
+			while (used & (1u << colour))
+			{
+				colour++;
+			}
+
+			m_BodyColours[a] |= 1u << colour;
+			if (!staticB)
+			{
+				m_BodyColours[b] |= 1u << colour;
+			}
+		}
+
+		m_ContactColour[i] = static_cast<uint8_t>(colour);
+		m_ColourStart[colour + 1]++;
+	}
+
+	// Counting sort, contacts keep their order within a colour
+	for (uint32_t colour = 0; colour <= ColourCount; colour++)
+	{
+		m_ColourStart[colour + 1] += m_ColourStart[colour];
+	}
+
+	m_SortedContacts.resize(m_Contacts.size());
+	uint32_t next[ColourCount + 1];
+	std::copy(m_ColourStart.begin(), m_ColourStart.end() - 1, next);
+	for (size_t i = 0; i < m_Contacts.size(); i++)
+	{
+		m_SortedContacts[next[m_ContactColour[i]]++] = m_Contacts[i];
+	}
+	m_Contacts.swap(m_SortedContacts);
+}
+
+void ContactSolver::ForEachColour(JobSystem& jobs, const JobSystem::RangeFunction& function)
+{
+	for (uint32_t colour = 0; colour < ColourCount; colour++)
+	{
+		uint32_t start = m_ColourStart[colour];
+		uint32_t count = m_ColourStart[colour + 1] - start;
+		jobs.ParallelFor(count, ContactsPerJob, [&](uint32_t begin, uint32_t end)
+			{
+				function(start + begin, start + end);
+			});
+	}
+
+	// Overflow contacts can share bodies, so they run in order on this thread
+	function(m_ColourStart[ColourCount], m_ColourStart[ColourCount + 1]);
+}
+
+float ContactSolver::NormalVelocity(const BodyStore& bodies, const ContactConstraint& contact) const
+{
+	uint32_t a = contact.a;
+	uint32_t b = contact.b;
+	bool staticB = (b == StaticBody);
+
+	float velocityBX = staticB ? 0.0f : bodies.xVcty[b];
+	float velocityBY = staticB ? 0.0f : bodies.yVcty[b];
+	return (velocityBX - bodies.xVcty[a]) * m_AspectRatio * contact.normalX +
+		(velocityBY - bodies.yVcty[a]) * contact.normalY;
+}
+
+float ContactSolver::CurrentOverlap(const BodyStore& bodies, const ContactConstraint& contact) const
+{
+	// No need to test the shapes again, only how far the bodies moved along the normal matters
+	uint32_t a = contact.a;
+	uint32_t b = contact.b;
+	float movedX = -(bodies.x[a] - bodies.prevX[a]);
+	float movedY = -(bodies.y[a] - bodies.prevY[a]);
+	if (b != StaticBody)
+	{
+		movedX += bodies.x[b] - bodies.prevX[b];
+		movedY += bodies.y[b] - bodies.prevY[b];
+	}
+
+	return contact.overlap - (movedX * m_AspectRatio * contact.normalX + movedY * contact.normalY);
+}
+
+void ContactSolver::RecordPass(double milliseconds)
+{
+	m_Stats.contacts = static_cast<uint32_t>(m_Contacts.size());
+	m_Stats.colours = GetColourCount();
+	m_Stats.overflow = GetOverflowCount();
+	m_Stats.velocityIterations++;
+	m_Stats.velocityMilliseconds += milliseconds;
+	m_Stats.contactsPerMillisecond = m_Stats.velocityMilliseconds > 0.0 ?
+		static_cast<double>(m_Stats.contacts) * m_Stats.velocityIterations / m_Stats.velocityMilliseconds : 0.0;
+}
+
+void ContactSolver::ApplyImpulse(BodyStore& bodies, const ContactConstraint& contact, float normalImpulse,
+	float tangentImpulse)
+{
+	// Impulses are worked out in aspect corrected space, x velocities are in x units
+	float impulseX = (contact.normalX * normalImpulse - contact.normalY * tangentImpulse) / m_AspectRatio;
+	float impulseY = contact.normalY * normalImpulse + contact.normalX * tangentImpulse;
+
+	bodies.xVcty[contact.a] -= impulseX * contact.invMassA;
+	bodies.yVcty[contact.a] -= impulseY * contact.invMassA;
+
+	if (contact.b != StaticBody)
+	{
+		bodies.xVcty[contact.b] += impulseX * contact.invMassB;
+		bodies.yVcty[contact.b] += impulseY * contact.invMassB;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,658 @@
+#include "Physics/DynamicTree.h"
+#include <algorithm>
+
+namespace
+{
+	inline AABB Combine(const AABB& first, const AABB& second)
+	{
+		return { std::min(first.minX, second.minX), std::min(first.minY, second.minY),
+			std::max(first.maxX, second.maxX), std::max(first.maxY, second.maxY) };
+	}
+
+	inline bool Contains(const AABB& outer, const AABB& inner)
+	{
+		return outer.minX <= inner.minX && outer.minY <= inner.minY &&
+			outer.maxX >= inner.maxX && outer.maxY >= inner.maxY;
+	}
+
+	// The 2d version of surface area for the insertion cost
+	inline float Perimeter(const AABB& box)
+	{
+		return 2.0f * ((box.maxX - box.minX) + (box.maxY - box.minY));
+	}
+
+	inline bool ContainsPoint(const AABB& box, float x, float y)
+	{
+		return x >= box.minX && x <= box.maxX && y >= box.minY && y <= box.maxY;
+	}
+
+	// Slab test of the segment from (x1, y1) to (x2, y2) against a box
+	inline bool SegmentHits(const AABB& box, float x1, float y1, float dx, float dy)
+	{
+		float tMin = 0.0f;
+		float tMax = 1.0f;
+
+		const float origin[2] = { x1, y1 };
+		const float direction[2] = { dx, dy };
+		const float boxMin[2] = { box.minX, box.minY };
+		const float boxMax[2] = { box.maxX, box.maxY };
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			if (direction[axis] == 0.0f)
+			{
+				if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float inverse = 1.0f / direction[axis];
+			float t1 = (boxMin[axis] - origin[axis]) * inverse;
+			float t2 = (boxMax[axis] - origin[axis]) * inverse;
+			if (t1 > t2)
+			{
+				std::swap(t1, t2);
+			}
+
+			tMin = std::max(tMin, t1);
+			tMax = std::min(tMax, t2);
+			if (tMin > tMax)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+DynamicTree::DynamicTree()
+	: m_Root(NullNode), m_FreeList(NullNode), m_Bounds(nullptr), m_Margin(0.01f)
+{
+}
+
+void DynamicTree::SetMargin(float margin)
+{
+	m_Margin = margin;
+}
+
+AABB DynamicTree::Fatten(const AABB& box) const
+{
+	return { box.minX - m_Margin, box.minY - m_Margin, box.maxX + m_Margin, box.maxY + m_Margin };
+}
+
+int32_t DynamicTree::GetHeight() const
+{
+	return (m_Root == NullNode) ? 0 : m_Nodes[m_Root].height;
+}
+
+int32_t DynamicTree::AllocateNode()
+{
+	int32_t node;
+	if (m_FreeList != NullNode)
+	{
+		node = m_FreeList;
+		m_FreeList = m_Nodes[node].parent;
+	}
+	else
+	{
+		node = static_cast<int32_t>(m_Nodes.size());
+		m_Nodes.push_back({});
+	}
+
+	m_Nodes[node].parent = NullNode;
+	m_Nodes[node].child1 = NullNode;
+	m_Nodes[node].child2 = NullNode;
+	m_Nodes[node].height = 0;
+	m_Nodes[node].proxy = 0;
+	return node;
+}
+
+void DynamicTree::FreeNode(int32_t node)
+{
+	m_Nodes[node].parent = m_FreeList;
+	m_Nodes[node].height = -1;
+	m_FreeList = node;
+}
+
+void DynamicTree::CreateProxy(uint32_t proxy)
+{
+	int32_t leaf = AllocateNode();
+	m_Nodes[leaf].box = Fatten((*m_Bounds)[proxy]);
+	m_Nodes[leaf].proxy = proxy;
+
+	if (proxy >= m_ProxyLeaf.size())
+	{
+		m_ProxyLeaf.resize(proxy + 1, NullNode);
+	}
+	m_ProxyLeaf[proxy] = leaf;
+
+	InsertLeaf(leaf);
+}
+
+void DynamicTree::DestroyProxy(uint32_t proxy)
+{
+	int32_t leaf = m_ProxyLeaf[proxy];
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	m_ProxyLeaf[proxy] = NullNode;
+}
+
+void DynamicTree::InsertProxy(uint32_t proxy)
+{
+	RemoveProxy(proxy);
+	CreateProxy(proxy);
+}
+
+bool DynamicTree::RemoveProxy(uint32_t proxy)
+{
+	if (proxy >= m_ProxyLeaf.size() || m_ProxyLeaf[proxy] == NullNode)
+	{
+		return false;
+	}
+
+	DestroyProxy(proxy);
+	return true;
+}
+
+void DynamicTree::Reset()
+{
+	// Inserting every leaf into an empty tree is cheaper than moving every leaf in the old one
+	m_Nodes.clear();
+	m_Root = NullNode;
+	m_FreeList = NullNode;
+	m_ProxyLeaf.clear();
+}
+
+void DynamicTree::Update(const std::vector<AABB>& bounds)
+{
+	m_Bounds = &bounds;
+	uint32_t proxyCount = static_cast<uint32_t>(bounds.size());
+	uint32_t oldCount = static_cast<uint32_t>(m_ProxyLeaf.size());
+
+	for (uint32_t proxy = proxyCount; proxy < oldCount; proxy++)
+	{
+		DestroyProxy(proxy);
+	}
+	m_ProxyLeaf.resize(std::min(oldCount, proxyCount));
+
+	// Only proxies that escaped their fat box get moved, the rest are untouched
+	for (uint32_t proxy = 0; proxy < m_ProxyLeaf.size(); proxy++)
+	{
+		int32_t leaf = m_ProxyLeaf[proxy];
+		if (Contains(m_Nodes[leaf].box, bounds[proxy]))
+		{
+			continue;
+		}
+
+		RemoveLeaf(leaf);
+		m_Nodes[leaf].box = Fatten(bounds[proxy]);
+		InsertLeaf(leaf);
+	}
+
+	for (uint32_t proxy = oldCount; proxy < proxyCount; proxy++)
+	{
+		CreateProxy(proxy);
+	}
+}
+
+void DynamicTree::InsertLeaf(int32_t leaf)
+{
+	if (m_Root == NullNode)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	// Walk down to the sibling that grows the tree's total perimeter the least
+	AABB leafBox = m_Nodes[leaf].box;
+	int32_t index = m_Root;
+	while (!IsLeaf(index))
+	{
+		const Node& node = m_Nodes[index];
+		int32_t child1 = node.child1;
+		int32_t child2 = node.child2;
+
+		float area = Perimeter(node.box);
+		float combinedArea = Perimeter(Combine(node.box, leafBox));
+
+		// Cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+		// Minimum cost pushed down to the children by going deeper
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = Perimeter(Combine(leafBox, m_Nodes[child1].box)) + inheritanceCost;
+		if (!IsLeaf(child1))
+		{
+			cost1 -= Perimeter(m_Nodes[child1].box);
+		}
+
+		float cost2 = Perimeter(Combine(leafBox, m_Nodes[child2].box)) + inheritanceCost;
+		if (!IsLeaf(child2))
+		{
+			cost2 -= Perimeter(m_Nodes[child2].box);
+		}
+
+		if (cost < cost1 && cost < cost2)
+		{
+			break;
+		}
+
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+
+	int32_t sibling = index;
+	int32_t oldParent = m_Nodes[sibling].parent;
+
+	// AllocateNode can grow the pool, so no Node references are held across it
+	int32_t newParent = AllocateNode();
+	m_Nodes[newParent].parent = oldParent;
+	m_Nodes[newParent].box = Combine(leafBox, m_Nodes[sibling].box);
+	m_Nodes[newParent].height = m_Nodes[sibling].height + 1;
+	m_Nodes[newParent].child1 = sibling;
+	m_Nodes[newParent].child2 = leaf;
+	m_Nodes[sibling].parent = newParent;
+	m_Nodes[leaf].parent = newParent;
+
+	if (oldParent == NullNode)
+	{
+		m_Root = newParent;
+	}
+	else if (m_Nodes[oldParent].child1 == sibling)
+	{
+		m_Nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		m_Nodes[oldParent].child2 = newParent;
+	}
+
+	Refit(m_Nodes[leaf].parent);
+}
+
+void DynamicTree::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == m_Root)
+	{
+		m_Root = NullNode;
+		return;
+	}
+
+	int32_t parent = m_Nodes[leaf].parent;
+	int32_t grandParent = m_Nodes[parent].parent;
+	int32_t sibling = (m_Nodes[parent].child1 == leaf) ? m_Nodes[parent].child2 : m_Nodes[parent].child1;
+
+	// The sibling takes the parent's place
+	m_Nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	if (grandParent == NullNode)
+	{
+		m_Root = sibling;
+		return;
+	}
+
+	if (m_Nodes[grandParent].child1 == parent)
+	{
+		m_Nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		m_Nodes[grandParent].child2 = sibling;
+	}
+
+	Refit(grandParent);
+}
+
+void DynamicTree::Refit(int32_t node)
+{
+	// Rebalance and fix up boxes and heights all the way back to the root
+	while (node != NullNode)
+	{
+		node = Balance(node);
+
+		int32_t child1 = m_Nodes[node].child1;
+		int32_t child2 = m_Nodes[node].child2;
+		m_Nodes[node].height = 1 + std::max(m_Nodes[child1].height, m_Nodes[child2].height);
+		m_Nodes[node].box = Combine(m_Nodes[child1].box, m_Nodes[child2].box);
+
+		node = m_Nodes[node].parent;
+	}
+}
+
+int32_t DynamicTree::Balance(int32_t iA)
+{
+	/*
+	       A
+	     /   \
+	    B     C
+	   / \   / \
+	  D   E F   G
+	*/
+	// If one child of A is more than one level taller than the other, that child is
+	// rotated up into A's place and A takes its shorter grandchild.
+	Node& A = m_Nodes[iA];
+	if (IsLeaf(iA) || A.height < 2)
+	{
+		return iA;
+	}
+
+	int32_t iB = A.child1;
+	int32_t iC = A.child2;
+	Node& B = m_Nodes[iB];
+	Node& C = m_Nodes[iC];
+
+	int32_t balance = C.height - B.height;
+
+	// Rotate C up
+	if (balance > 1)
+	{
+		int32_t iF = C.child1;
+		int32_t iG = C.child2;
+		Node& F = m_Nodes[iF];
+		Node& G = m_Nodes[iG];
+
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		if (C.parent == NullNode)
+		{
+			m_Root = iC;
+		}
+		else if (m_Nodes[C.parent].child1 == iA)
+		{
+			m_Nodes[C.parent].child1 = iC;
+		}
+		else
+		{
+			m_Nodes[C.parent].child2 = iC;
+		}
+
+		if (F.height > G.height)
+		{
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+			A.box = Combine(B.box, G.box);
+			C.box = Combine(A.box, F.box);
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else
+		{
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+			A.box = Combine(B.box, F.box);
+			C.box = Combine(A.box, G.box);
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up
+	if (balance < -1)
+	{
+		int32_t iD = B.child1;
+		int32_t iE = B.child2;
+		Node& D = m_Nodes[iD];
+		Node& E = m_Nodes[iE];
+
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		if (B.parent == NullNode)
+		{
+			m_Root = iB;
+		}
+		else if (m_Nodes[B.parent].child1 == iA)
+		{
+			m_Nodes[B.parent].child1 = iB;
+		}
+		else
+		{
+			m_Nodes[B.parent].child2 = iB;
+		}
+
+		if (D.height > E.height)
+		{
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+			A.box = Combine(C.box, E.box);
+			B.box = Combine(A.box, D.box);
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else
+		{
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+			A.box = Combine(C.box, D.box);
+			B.box = Combine(A.box, E.box);
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+namespace
+{
+	void SortPairs(std::vector<BodyPair>& pairs)
+	{
+		std::sort(pairs.begin(), pairs.end(), [](const BodyPair& first, const BodyPair& second)
+			{
+				return (first.a != second.a) ? (first.a < second.a) : (first.b < second.b);
+			});
+	}
+}
+
+void DynamicTree::FindPairs(std::vector<BodyPair>& pairs) const
+{
+	pairs.clear();
+	if (m_Root == NullNode)
+	{
+		return;
+	}
+
+	FindPairsForProxies(0, static_cast<uint32_t>(m_ProxyLeaf.size()), pairs);
+	SortPairs(pairs);
+}
+
+void DynamicTree::FindPairsParallel(std::vector<BodyPair>& pairs, JobSystem& jobs) const
+{
+	pairs.clear();
+	if (m_Root == NullNode)
+	{
+		return;
+	}
+
+	// The tree is only read here, so proxy ranges can be queried side by side into their own
+	// buffers and joined in chunk order
+	uint32_t proxyCount = static_cast<uint32_t>(m_ProxyLeaf.size());
+	uint32_t chunkCount = (proxyCount - 1) / ProxiesPerJob + 1;
+	if (m_ChunkPairs.size() < chunkCount)
+	{
+		m_ChunkPairs.resize(chunkCount);
+	}
+
+	jobs.ParallelFor(proxyCount, ProxiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<BodyPair>& chunkPairs = m_ChunkPairs[begin / ProxiesPerJob];
+			chunkPairs.clear();
+			FindPairsForProxies(begin, end, chunkPairs);
+		});
+
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		pairs.insert(pairs.end(), m_ChunkPairs[chunk].begin(), m_ChunkPairs[chunk].end());
+	}
+	SortPairs(pairs);
+}
+
+void DynamicTree::FindPairsForProxies(uint32_t firstProxy, uint32_t lastProxy, std::vector<BodyPair>& pairs) const
+{
+	const std::vector<AABB>& bounds = *m_Bounds;
+	std::vector<int32_t> stack;
+	uint32_t filtered = 0;
+
+	for (uint32_t proxy = firstProxy; proxy < lastProxy; proxy++)
+	{
+		const AABB& box = bounds[proxy];
+
+		stack.clear();
+		stack.push_back(m_Root);
+		while (!stack.empty())
+		{
+			int32_t index = stack.back();
+			stack.pop_back();
+
+			const Node& node = m_Nodes[index];
+			if (!Overlaps(node.box, box))
+			{
+				continue;
+			}
+
+			if (IsLeaf(index))
+			{
+				// Each pair is reported once, by its lower proxy, and tested on the real bounds
+				if (node.proxy > proxy && Overlaps(bounds[node.proxy], box))
+				{
+					if (Accepts(proxy, node.proxy))
+					{
+						pairs.push_back({ proxy, node.proxy });
+					}
+					else
+					{
+						filtered++;
+					}
+				}
+				continue;
+			}
+
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+	AddFilteredPairs(filtered);
+}
+
+void DynamicTree::QueryPoint(float x, float y, std::vector<uint32_t>& proxies) const
+{
+	proxies.clear();
+	if (m_Root == NullNode)
+	{
+		return;
+	}
+
+	std::vector<int32_t> stack;
+	stack.push_back(m_Root);
+	while (!stack.empty())
+	{
+		int32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		if (!ContainsPoint(node.box, x, y))
+		{
+			continue;
+		}
+
+		if (IsLeaf(index))
+		{
+			if (ContainsPoint((*m_Bounds)[node.proxy], x, y))
+			{
+				proxies.push_back(node.proxy);
+			}
+			continue;
+		}
+
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
+
+void DynamicTree::QueryAABB(const AABB& box, std::vector<uint32_t>& proxies) const
+{
+	proxies.clear();
+	if (m_Root == NullNode)
+	{
+		return;
+	}
+
+	std::vector<int32_t> stack;
+	stack.push_back(m_Root);
+	while (!stack.empty())
+	{
+		int32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		if (!Overlaps(node.box, box))
+		{
+			continue;
+		}
+
+		if (IsLeaf(index))
+		{
+			if (Overlaps((*m_Bounds)[node.proxy], box))
+			{
+				proxies.push_back(node.proxy);
+			}
+			continue;
+		}
+
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
+
+void DynamicTree::QueryRay(float x1, float y1, float x2, float y2, std::vector<uint32_t>& proxies) const
+{
+	proxies.clear();
+	if (m_Root == NullNode)
+	{
+		return;
+	}
+
+	float dx = x2 - x1;
+	float dy = y2 - y1;
+
+	std::vector<int32_t> stack;
+	stack.push_back(m_Root);
+	while (!stack.empty())
+	{
+		int32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		if (!SegmentHits(node.box, x1, y1, dx, dy))
+		{
+			continue;
+		}
+
+		if (IsLeaf(index))
+		{
+			if (SegmentHits((*m_Bounds)[node.proxy], x1, y1, dx, dy))
+			{
+				proxies.push_back(node.proxy);
+			}
+			continue;
+		}
+
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "Physics/Fluid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// The grid never reaches further than this past the frame, particles beyond it are
+	// counted in the edge cells until they get removed
+	const float GridLimitX = 2.0f;
+	const float GridLimitY = 2.5f;
+
+	// 2D spiky kernel 6 / (pi h^4) (h - r)^2 and its slope 12 / (pi h^4) (h - r), without
+	// the constant. Density and pressure use the same kernel so the pressure forces are the
+	// gradient of one energy, with different kernels the fluid slowly gains energy
+	inline float Spiky(float smoothingRadius, float distance)
+	{
+		float t = smoothingRadius - distance;
+		return t * t;
+	}
+}
+
+Fluid::Fluid(float aspectRatio)
+	: m_AspectRatio(aspectRatio), m_SmoothingRadius(0.0f), m_RestDensity(1000.0f), m_Stiffness(8.0f),
+	m_Viscosity(0.2f), m_Substeps(8), m_ParticleMass(0.0f), m_Spacing(0.0f),
+	m_GridMinX(0.0f), m_GridMinY(0.0f), m_CellsX(0), m_CellsY(0), m_Stats()
+{
+	SetSmoothingRadius(0.016f);
+}
+
+void Fluid::SetSmoothingRadius(float radius)
+{
+	m_SmoothingRadius = radius;
+	m_Spacing = radius * 0.5f;
+
+	// Density of a particle inside a block at rest spacing, per unit particle mass
+	float density = 0.0f;
+	for (int row = -2; row <= 2; row++)
+	{
+		for (int column = -2; column <= 2; column++)
+		{
+			float distance = std::sqrt(static_cast<float>(row * row + column * column)) * m_Spacing;
+			if (distance < radius)
+			{
+				density += Spiky(radius, distance);
+			}
+		}
+	}
+	density *= 6.0f / (Pi * std::pow(radius, 4.0f));
+	m_ParticleMass = m_RestDensity / density;
+}
+
+void Fluid::AddParticle(float particleX, float particleY, float particleXVcty, float particleYVcty)
+{
+	x.push_back(particleX);
+	y.push_back(particleY);
+	prevX.push_back(particleX);
+	prevY.push_back(particleY);
+	xVcty.push_back(particleXVcty);
+	yVcty.push_back(particleYVcty);
+}
+
+void Fluid::AddBlock(float centreX, float centreY, float width, float height)
+{
+	float spacingX = m_Spacing / m_AspectRatio;
+	int columns = std::max(1, static_cast<int>(width / spacingX));
+	int rows = std::max(1, static_cast<int>(height / m_Spacing));
+	float left = centreX - (columns - 1) * spacingX * 0.5f;
+	float bottom = centreY - (rows - 1) * m_Spacing * 0.5f;
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			AddParticle(left + column * spacingX, bottom + row * m_Spacing, 0.0f, 0.0f);
+		}
+	}
+}
+
+void Fluid::Clear()
+{
+	x.clear();
+	y.clear();
+	prevX.clear();
+	prevY.clear();
+	xVcty.clear();
+	yVcty.clear();
+}
+
+void Fluid::Step(float dt, float gravity, const AABB& ground, const StaticGeometry& walls, JobSystem& jobs)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	prevX = x;
+	prevY = y;
+	if (x.empty())
+	{
+		m_Stats = FluidStats();
+		return;
+	}
+
+	float h = dt / m_Substeps;
+	for (int substep = 0; substep < m_Substeps; substep++)
+	{
+		SortIntoCells();
+		ComputeDensities(jobs);
+		ComputeAccelerations(gravity, jobs);
+		Integrate(h, ground, walls, jobs);
+	}
+
+	// The stats describe the last substep, before anything was removed
+	uint32_t neighbours = 0;
+	float densityError = 0.0f;
+	for (size_t chunk = 0; chunk < m_ChunkNeighbours.size(); chunk++)
+	{
+		neighbours += m_ChunkNeighbours[chunk];
+		densityError += m_ChunkDensityError[chunk];
+	}
+	m_Stats.particles = static_cast<uint32_t>(x.size());
+	m_Stats.neighboursPerParticle = static_cast<float>(neighbours) / x.size();
+	m_Stats.densityError = densityError / x.size();
+
+	RemoveOutOfFrame();
+	m_Stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Fluid::SortIntoCells()
+{
+	uint32_t count = static_cast<uint32_t>(x.size());
+	float minX = x[0];
+	float minY = y[0];
+	float maxX = x[0];
+	float maxY = y[0];
+	for (uint32_t i = 1; i < count; i++)
+	{
+		minX = std::min(minX, x[i]);
+		minY = std::min(minY, y[i]);
+		maxX = std::max(maxX, x[i]);
+		maxY = std::max(maxY, y[i]);
+	}
+	minX = std::max(minX, -GridLimitX);
+	minY = std::max(minY, -GridLimitY);
+	maxX = std::max(std::min(maxX, GridLimitX), minX);
+	maxY = std::max(std::min(maxY, GridLimitY), minY);
+
+	m_GridMinX = minX * m_AspectRatio;
+	m_GridMinY = minY;
+	m_CellsX = static_cast<uint32_t>((maxX - minX) * m_AspectRatio / m_SmoothingRadius) + 1;
+	m_CellsY = static_cast<uint32_t>((maxY - minY) / m_SmoothingRadius) + 1;
+	uint32_t cellCount = m_CellsX * m_CellsY;
+
+	// Counting sort: count per cell, turn the counts into starts, then place every particle
+	m_ParticleCell.resize(count);
+	m_CellStart.assign(cellCount + 1, 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int cellX = std::min(std::max(static_cast<int>((x[i] * m_AspectRatio - m_GridMinX) / m_SmoothingRadius), 0),
+			static_cast<int>(m_CellsX) - 1);
+		int cellY = std::min(std::max(static_cast<int>((y[i] - m_GridMinY) / m_SmoothingRadius), 0),
+			static_cast<int>(m_CellsY) - 1);
+		m_ParticleCell[i] = static_cast<uint32_t>(cellY) * m_CellsX + static_cast<uint32_t>(cellX);
+		m_CellStart[m_ParticleCell[i] + 1]++;
+	}
+	for (uint32_t cell = 0; cell < cellCount; cell++)
+	{
+		m_CellStart[cell + 1] += m_CellStart[cell];
+	}
+
+	m_Order.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_Order[m_CellStart[m_ParticleCell[i]]++] = i;
+	}
+	// Placing moved every start up to the next cell's, shift them back
+	for (uint32_t cell = cellCount; cell > 0; cell--)
+	{
+		m_CellStart[cell] = m_CellStart[cell - 1];
+	}
+	m_CellStart[0] = 0;
+
+	Gather(x);
+	Gather(y);
+	Gather(prevX);
+	Gather(prevY);
+	Gather(xVcty);
+	Gather(yVcty);
+}
+
+void Fluid::Gather(std::vector<float>& column)
+{
+	m_Scratch.resize(column.size());
+	for (size_t i = 0; i < column.size(); i++)
+	{
+		m_Scratch[i] = column[m_Order[i]];
+	}
+	column.swap(m_Scratch);
+}
+
+FluidRuns Fluid::FindNeighbourRuns(float particleX, float particleY) const
+{
+	int cellX = std::min(std::max(static_cast<int>((particleX - m_GridMinX) / m_SmoothingRadius), 0),
+		static_cast<int>(m_CellsX) - 1);
+	int cellY = std::min(std::max(static_cast<int>((particleY - m_GridMinY) / m_SmoothingRadius), 0),
+		static_cast<int>(m_CellsY) - 1);
+	uint32_t firstX = static_cast<uint32_t>(std::max(cellX - 1, 0));
+	uint32_t lastX = std::min(static_cast<uint32_t>(cellX + 1), m_CellsX - 1);
+	uint32_t firstY = static_cast<uint32_t>(std::max(cellY - 1, 0));
+	uint32_t lastY = std::min(static_cast<uint32_t>(cellY + 1), m_CellsY - 1);
+
+	// Cells of one row are next to each other in the columns, so a row is one run
+	FluidRuns runs;
+	runs.count = 0;
+	for (uint32_t row = firstY; row <= lastY; row++)
+	{
+		runs.begin[runs.count] = m_CellStart[row * m_CellsX + firstX];
+		runs.end[runs.count] = m_CellStart[row * m_CellsX + lastX + 1];
+		runs.count++;
+	}
+	return runs;
+}
+
+void Fluid::ComputeDensities(JobSystem& jobs)
+{
+	uint32_t count = static_cast<uint32_t>(x.size());
+	uint32_t chunkCount = (count + ParticlesPerJob - 1) / ParticlesPerJob;
+	m_InverseDensity.resize(count);
+	m_PressureTerm.resize(count);
+	m_ChunkNeighbours.assign(chunkCount, 0);
+	m_ChunkDensityError.assign(chunkCount, 0.0f);
+
+	float scale = m_ParticleMass * 6.0f / (Pi * std::pow(m_SmoothingRadius, 4.0f));
+	jobs.ParallelFor(count, ParticlesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t neighbours = 0;
+			float densityError = 0.0f;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				float particleX = x[i] * m_AspectRatio;
+				float particleY = y[i];
+				FluidRuns runs = FindNeighbourRuns(particleX, particleY);
+				float density = SumFluidDensity(x.data(), y.data(), count, runs, particleX, particleY, m_AspectRatio,
+					m_SmoothingRadius, neighbours);
+
+				// Only compression pushes, pulling would clump the particles at the surface.
+				// A particle always counts itself, so the density is never 0
+				density *= scale;
+				float pressure = std::max(m_Stiffness * (density - m_RestDensity), 0.0f);
+				m_InverseDensity[i] = 1.0f / density;
+				m_PressureTerm[i] = pressure / (density * density);
+				densityError += std::max(density - m_RestDensity, 0.0f) / m_RestDensity;
+			}
+
+			m_ChunkNeighbours[begin / ParticlesPerJob] = neighbours;
+			m_ChunkDensityError[begin / ParticlesPerJob] = densityError;
+		});
+}
+
+void Fluid::ComputeAccelerations(float gravity, JobSystem& jobs)
+{
+	uint32_t count = static_cast<uint32_t>(x.size());
+	m_AccelerationX.resize(count);
+	m_AccelerationY.resize(count);
+
+	// Symmetric pressure term, so every pair pushes both ways equally
+	FluidColumns particles = { count, x.data(), y.data(), xVcty.data(), yVcty.data(), m_PressureTerm.data(),
+		m_InverseDensity.data() };
+	float pressureScale = m_ParticleMass * 12.0f / (Pi * std::pow(m_SmoothingRadius, 4.0f));
+	float viscosityScale = m_Viscosity * m_ParticleMass * 40.0f / (Pi * std::pow(m_SmoothingRadius, 5.0f));
+	jobs.ParallelFor(count, ParticlesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				float pressureX = 0.0f;
+				float pressureY = 0.0f;
+				float viscosityX = 0.0f;
+				float viscosityY = 0.0f;
+				FluidRuns runs = FindNeighbourRuns(x[i] * m_AspectRatio, y[i]);
+				AccumulateFluidForces(particles, i, runs, m_AspectRatio, m_SmoothingRadius, pressureX, pressureY,
+					viscosityX, viscosityY);
+
+				float drag = viscosityScale * m_InverseDensity[i];
+				m_AccelerationX[i] = pressureX * pressureScale + viscosityX * drag;
+				m_AccelerationY[i] = pressureY * pressureScale + viscosityY * drag - gravity;
+			}
+		});
+}
+
+void Fluid::Integrate(float h, const AABB& ground, const StaticGeometry& walls, JobSystem& jobs)
+{
+	float radius = GetParticleRadius();
+	float radiusX = radius / m_AspectRatio;
+	jobs.ParallelFor(static_cast<uint32_t>(x.size()), ParticlesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<uint32_t> nearbyWalls;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				xVcty[i] += m_AccelerationX[i] / m_AspectRatio * h;
+				yVcty[i] += m_AccelerationY[i] * h;
+				x[i] += xVcty[i] * h;
+				y[i] += yVcty[i] * h;
+
+				// Same rule as the bodies: anything within the ground's width and below its top
+				// sits on it. Contacts don't bounce, the velocity into the surface is removed
+				if (x[i] + radiusX > ground.minX && x[i] - radiusX < ground.maxX && y[i] - radius < ground.maxY)
+				{
+					y[i] = ground.maxY + radius;
+					yVcty[i] = std::max(yVcty[i], 0.0f);
+				}
+
+				AABB box = { x[i] - radiusX, y[i] - radius, x[i] + radiusX, y[i] + radius };
+				walls.Query(box, nearbyWalls);
+				for (uint32_t wall : nearbyWalls)
+				{
+					// Out through the side the particle is least far in
+					const AABB& bounds = walls.GetBounds(wall);
+					float left = box.maxX - bounds.minX;
+					float right = bounds.maxX - box.minX;
+					float below = box.maxY - bounds.minY;
+					float above = bounds.maxY - box.minY;
+					if (std::min(std::min(left, right), std::min(below, above)) <= 0.0f)
+					{
+						// Already pushed clear by an earlier wall
+						continue;
+					}
+					if (std::min(left, right) * m_AspectRatio < std::min(below, above))
+					{
+						x[i] += (left < right) ? -left : right;
+						xVcty[i] = (left < right) ? std::min(xVcty[i], 0.0f) : std::max(xVcty[i], 0.0f);
+					}
+					else
+					{
+						y[i] += (below < above) ? -below : above;
+						yVcty[i] = (below < above) ? std::min(yVcty[i], 0.0f) : std::max(yVcty[i], 0.0f);
+					}
+					box = { x[i] - radiusX, y[i] - radius, x[i] + radiusX, y[i] + radius };
+				}
+			}
+		});
+}
+
+void Fluid::RemoveOutOfFrame()
+{
+	// Same frame as the bodies; order doesn't matter, the next step sorts again
+	for (size_t i = x.size(); i-- > 0;)
+	{
+		if (x[i] < -1.5f || x[i] > 1.5f || y[i] < -2.0f || y[i] > 1.5f)
+		{
+			x[i] = x.back();
+			y[i] = y.back();
+			prevX[i] = prevX.back();
+			prevY[i] = prevY.back();
+			xVcty[i] = xVcty.back();
+			yVcty[i] = yVcty.back();
+			x.pop_back();
+			y.pop_back();
+			prevX.pop_back();
+			prevY.pop_back();
+			xVcty.pop_back();
+			yVcty.pop_back();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,682 @@
+#include "Physics/GridFluid.h"
+#include "Physics/SimdKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+GridFluid::GridFluid(float aspectRatio, uint32_t cellsX, uint32_t cellsY)
+	: m_AspectRatio(aspectRatio), m_CellsX(0), m_CellsY(0), m_CellSize(0.0f), m_OriginX(0.0f), m_OriginY(0.0f),
+	m_FluidCells(0), m_VCycles(1), m_Smoothing(2), m_DyeFade(0.5f), m_Stats()
+{
+	if (cellsX > 0 && cellsY > 0)
+	{
+		SetResolution(cellsX, cellsY);
+	}
+}
+
+void GridFluid::SetResolution(uint32_t cellsX, uint32_t cellsY)
+{
+	// Bilinear sampling needs two samples each way
+	m_CellsX = std::max(cellsX, 2u);
+	m_CellsY = std::max(cellsY, 2u);
+	m_CellSize = 2.0f * m_AspectRatio / m_CellsX;
+	m_OriginX = -m_AspectRatio;
+	m_OriginY = -1.0f;
+
+	m_U.assign((m_CellsX + 1) * m_CellsY, 0.0f);
+	m_V.assign(m_CellsX * (m_CellsY + 1), 0.0f);
+	m_Dye.assign(m_CellsX * m_CellsY, 0.0f);
+	m_PreviousU = m_U;
+	m_PreviousV = m_V;
+	m_PreviousDye = m_Dye;
+	m_Solid.assign(m_CellsX * m_CellsY, 0);
+
+	// Enough chunks for the longest pass, the v faces have a row more than the cells
+	uint32_t chunkCount = (m_CellsY + 1 + RowsPerJob - 1) / RowsPerJob;
+	m_ChunkRows.assign(chunkCount, std::vector<float>(3 * (m_CellsX + 1)));
+	m_ChunkSums.assign(chunkCount, 0.0);
+	BuildLevels();
+}
+
+void GridFluid::SetObstacles(const AABB& ground, const StaticGeometry& walls)
+{
+	std::fill(m_Solid.begin(), m_Solid.end(), 0);
+
+	// A cell is solid when its centre is inside the box
+	auto markSolid = [&](const AABB& box)
+		{
+			float firstX = std::ceil((box.minX * m_AspectRatio - m_OriginX) / m_CellSize - 0.5f);
+			float lastX = std::floor((box.maxX * m_AspectRatio - m_OriginX) / m_CellSize - 0.5f);
+			float firstY = std::ceil((box.minY - m_OriginY) / m_CellSize - 0.5f);
+			float lastY = std::floor((box.maxY - m_OriginY) / m_CellSize - 0.5f);
+			int beginX = static_cast<int>(std::max(firstX, 0.0f));
+			int endX = static_cast<int>(std::min(lastX, static_cast<float>(m_CellsX) - 1.0f));
+			int beginY = static_cast<int>(std::max(firstY, 0.0f));
+			int endY = static_cast<int>(std::min(lastY, static_cast<float>(m_CellsY) - 1.0f));
+			for (int cellY = beginY; cellY <= endY; cellY++)
+			{
+				for (int cellX = beginX; cellX <= endX; cellX++)
+				{
+					m_Solid[cellY * m_CellsX + cellX] = 1;
+				}
+			}
+		};
+
+	markSolid(ground);
+	for (uint32_t wall = 0; wall < walls.Size(); wall++)
+	{
+		markSolid(walls.GetBounds(wall));
+	}
+
+	for (size_t cell = 0; cell < m_Solid.size(); cell++)
+	{
+		if (m_Solid[cell])
+		{
+			m_Dye[cell] = 0.0f;
+		}
+	}
+	BuildLevels();
+}
+
+void GridFluid::BuildLevels()
+{
+	m_Levels.clear();
+
+	// Level 0 from the solid cells, faces on the edge of the grid stay closed
+	Level fine;
+	fine.cellsX = m_CellsX;
+	fine.cellsY = m_CellsY;
+	fine.weightX.assign((m_CellsX + 1) * m_CellsY, 0.0f);
+	fine.weightY.assign(m_CellsX * (m_CellsY + 1), 0.0f);
+	for (uint32_t cellY = 0; cellY < m_CellsY; cellY++)
+	{
+		for (uint32_t cellX = 1; cellX < m_CellsX; cellX++)
+		{
+			uint32_t cell = cellY * m_CellsX + cellX;
+			bool open = !m_Solid[cell - 1] && !m_Solid[cell];
+			fine.weightX[cellY * (m_CellsX + 1) + cellX] = open ? 1.0f : 0.0f;
+		}
+	}
+	for (uint32_t cellY = 1; cellY < m_CellsY; cellY++)
+	{
+		for (uint32_t cellX = 0; cellX < m_CellsX; cellX++)
+		{
+			uint32_t cell = cellY * m_CellsX + cellX;
+			bool open = !m_Solid[cell - m_CellsX] && !m_Solid[cell];
+			fine.weightY[cell] = open ? 1.0f : 0.0f;
+		}
+	}
+	m_Levels.push_back(fine);
+
+	// Coarser levels until the grid is small enough to solve outright. A coarse face covers
+	// two fine faces and takes their average
+	while (m_Levels.back().cellsX * m_Levels.back().cellsY > CoarsestCells &&
+		m_Levels.back().cellsX > 2 && m_Levels.back().cellsY > 2)
+	{
+		const Level& previous = m_Levels.back();
+		Level coarse;
+		coarse.cellsX = (previous.cellsX + 1) / 2;
+		coarse.cellsY = (previous.cellsY + 1) / 2;
+		coarse.weightX.assign((coarse.cellsX + 1) * coarse.cellsY, 0.0f);
+		coarse.weightY.assign(coarse.cellsX * (coarse.cellsY + 1), 0.0f);
+		for (uint32_t cellY = 0; cellY < coarse.cellsY; cellY++)
+		{
+			for (uint32_t face = 0; face <= coarse.cellsX && 2 * face <= previous.cellsX; face++)
+			{
+				float weight = previous.weightX[2 * cellY * (previous.cellsX + 1) + 2 * face];
+				if (2 * cellY + 1 < previous.cellsY)
+				{
+					weight += previous.weightX[(2 * cellY + 1) * (previous.cellsX + 1) + 2 * face];
+				}
+				coarse.weightX[cellY * (coarse.cellsX + 1) + face] = weight * 0.5f;
+			}
+		}
+		for (uint32_t face = 0; face <= coarse.cellsY && 2 * face <= previous.cellsY; face++)
+		{
+			for (uint32_t cellX = 0; cellX < coarse.cellsX; cellX++)
+			{
+				float weight = previous.weightY[2 * face * previous.cellsX + 2 * cellX];
+				if (2 * cellX + 1 < previous.cellsX)
+				{
+					weight += previous.weightY[2 * face * previous.cellsX + 2 * cellX + 1];
+				}
+				coarse.weightY[face * coarse.cellsX + cellX] = weight * 0.5f;
+			}
+		}
+		m_Levels.push_back(coarse);
+	}
+
+	m_FluidCells = 0;
+	for (Level& level : m_Levels)
+	{
+		uint32_t cellCount = level.cellsX * level.cellsY;
+		level.diagonal.assign(cellCount, 0.0f);
+		for (uint32_t cellY = 0; cellY < level.cellsY; cellY++)
+		{
+			for (uint32_t cellX = 0; cellX < level.cellsX; cellX++)
+			{
+				uint32_t cell = cellY * level.cellsX + cellX;
+				uint32_t faceX = cellY * (level.cellsX + 1) + cellX;
+				level.diagonal[cell] = level.weightX[faceX] + level.weightX[faceX + 1] +
+					level.weightY[cell] + level.weightY[cell + level.cellsX];
+			}
+		}
+		level.inverseDiagonal.resize(cellCount);
+		for (uint32_t cell = 0; cell < cellCount; cell++)
+		{
+			level.inverseDiagonal[cell] = (level.diagonal[cell] > 0.0f) ? 1.0f / level.diagonal[cell] : 0.0f;
+		}
+		level.pressure.assign(cellCount, 0.0f);
+		level.rhs.assign(cellCount, 0.0f);
+		level.residual.assign(cellCount, 0.0f);
+	}
+	for (float diagonal : m_Levels[0].diagonal)
+	{
+		m_FluidCells += (diagonal > 0.0f) ? 1 : 0;
+	}
+}
+
+void GridFluid::AddVelocity(float x, float y, float radius, float xVcty, float yVcty)
+{
+	float centreX = (x * m_AspectRatio - m_OriginX) / m_CellSize;
+	float centreY = (y - m_OriginY) / m_CellSize;
+	float reach = radius / m_CellSize;
+	int beginX = std::max(static_cast<int>(centreX - reach), 0);
+	int endX = std::min(static_cast<int>(centreX + reach) + 1, static_cast<int>(m_CellsX));
+	int beginY = std::max(static_cast<int>(centreY - reach), 0);
+	int endY = std::min(static_cast<int>(centreY + reach) + 1, static_cast<int>(m_CellsY));
+
+	// u faces sit at (i, j + 0.5) in cells, v faces at (i + 0.5, j). Closed faces keep 0
+	const Level& level = m_Levels[0];
+	for (int cellY = beginY; cellY < endY; cellY++)
+	{
+		for (int cellX = beginX; cellX <= endX; cellX++)
+		{
+			float dx = cellX - centreX;
+			float dy = cellY + 0.5f - centreY;
+			uint32_t face = cellY * (m_CellsX + 1) + cellX;
+			if (dx * dx + dy * dy < reach * reach && level.weightX[face] > 0.0f)
+			{
+				m_U[face] = xVcty * m_AspectRatio;
+			}
+		}
+	}
+	for (int cellY = beginY; cellY <= endY; cellY++)
+	{
+		for (int cellX = beginX; cellX < endX; cellX++)
+		{
+			float dx = cellX + 0.5f - centreX;
+			float dy = cellY - centreY;
+			uint32_t face = cellY * m_CellsX + cellX;
+			if (dx * dx + dy * dy < reach * reach && level.weightY[face] > 0.0f)
+			{
+				m_V[face] = yVcty;
+			}
+		}
+	}
+}
+
+void GridFluid::AddDye(float x, float y, float radius, float amount)
+{
+	float centreX = (x * m_AspectRatio - m_OriginX) / m_CellSize;
+	float centreY = (y - m_OriginY) / m_CellSize;
+	float reach = radius / m_CellSize;
+	int beginX = std::max(static_cast<int>(centreX - reach), 0);
+	int endX = std::min(static_cast<int>(centreX + reach) + 1, static_cast<int>(m_CellsX));
+	int beginY = std::max(static_cast<int>(centreY - reach), 0);
+	int endY = std::min(static_cast<int>(centreY + reach) + 1, static_cast<int>(m_CellsY));
+	for (int cellY = beginY; cellY < endY; cellY++)
+	{
+		for (int cellX = beginX; cellX < endX; cellX++)
+		{
+			float dx = cellX + 0.5f - centreX;
+			float dy = cellY + 0.5f - centreY;
+			uint32_t cell = cellY * m_CellsX + cellX;
+			if (dx * dx + dy * dy < reach * reach && !m_Solid[cell])
+			{
+				m_Dye[cell] += amount;
+			}
+		}
+	}
+}
+
+void GridFluid::Clear()
+{
+	std::fill(m_U.begin(), m_U.end(), 0.0f);
+	std::fill(m_V.begin(), m_V.end(), 0.0f);
+	std::fill(m_Dye.begin(), m_Dye.end(), 0.0f);
+	for (Level& level : m_Levels)
+	{
+		std::fill(level.pressure.begin(), level.pressure.end(), 0.0f);
+	}
+}
+
+void GridFluid::SampleVelocity(float x, float y, float& xVcty, float& yVcty) const
+{
+	float gridX = (x * m_AspectRatio - m_OriginX) / m_CellSize;
+	float gridY = (y - m_OriginY) / m_CellSize;
+	if (gridX < 0.0f || gridY < 0.0f || gridX > m_CellsX || gridY > m_CellsY)
+	{
+		xVcty = 0.0f;
+		yVcty = 0.0f;
+		return;
+	}
+
+	float sampleX = gridX;
+	float sampleY = gridY - 0.5f;
+	ScalarSampleGrid(m_U.data(), m_CellsX + 1, m_CellsY, &sampleX, &sampleY, 1, &xVcty);
+	sampleX = gridX - 0.5f;
+	sampleY = gridY;
+	ScalarSampleGrid(m_V.data(), m_CellsX, m_CellsY + 1, &sampleX, &sampleY, 1, &yVcty);
+	xVcty /= m_AspectRatio;
+}
+
+void GridFluid::Step(float dt, JobSystem& jobs)
+{
+	auto start = std::chrono::steady_clock::now();
+	AdvectVelocity(dt, jobs);
+	auto advected = std::chrono::steady_clock::now();
+	Project(dt, jobs);
+	auto projected = std::chrono::steady_clock::now();
+	AdvectDye(dt, jobs);
+	auto end = std::chrono::steady_clock::now();
+
+	m_Stats.cellsX = m_CellsX;
+	m_Stats.cellsY = m_CellsY;
+	m_Stats.levels = static_cast<uint32_t>(m_Levels.size());
+	m_Stats.vCycles = m_VCycles;
+	m_Stats.advectMilliseconds = std::chrono::duration<double, std::milli>(advected - start).count() +
+		std::chrono::duration<double, std::milli>(end - projected).count();
+	m_Stats.projectMilliseconds = std::chrono::duration<double, std::milli>(projected - advected).count();
+	m_Stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void GridFluid::AdvectVelocity(float dt, JobSystem& jobs)
+{
+	m_PreviousU.swap(m_U);
+	m_PreviousV.swap(m_V);
+	float scale = dt / m_CellSize;
+	uint32_t rowU = m_CellsX + 1;
+
+	// Each face traces back along the velocity there, the other component is sampled at the
+	// face. Coordinates are in cells, shifted onto the grid being sampled
+	jobs.ParallelFor(m_CellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<float>& scratch = m_ChunkRows[begin / RowsPerJob];
+			float* sampleX = scratch.data();
+			float* sampleY = sampleX + rowU;
+			float* values = sampleY + rowU;
+			for (uint32_t row = begin; row < end; row++)
+			{
+				const float* previous = m_PreviousU.data() + row * rowU;
+				for (uint32_t face = 0; face < rowU; face++)
+				{
+					sampleX[face] = face - 0.5f;
+					sampleY[face] = row + 0.5f;
+				}
+				SampleGrid(m_PreviousV.data(), m_CellsX, m_CellsY + 1, sampleX, sampleY, rowU, values);
+				for (uint32_t face = 0; face < rowU; face++)
+				{
+					sampleX[face] = face - previous[face] * scale;
+					sampleY[face] = row - values[face] * scale;
+				}
+				SampleGrid(m_PreviousU.data(), rowU, m_CellsY, sampleX, sampleY, rowU, m_U.data() + row * rowU);
+			}
+		});
+
+	jobs.ParallelFor(m_CellsY + 1, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<float>& scratch = m_ChunkRows[begin / RowsPerJob];
+			float* sampleX = scratch.data();
+			float* sampleY = sampleX + rowU;
+			float* values = sampleY + rowU;
+			for (uint32_t row = begin; row < end; row++)
+			{
+				const float* previous = m_PreviousV.data() + row * m_CellsX;
+				for (uint32_t face = 0; face < m_CellsX; face++)
+				{
+					sampleX[face] = face + 0.5f;
+					sampleY[face] = row - 0.5f;
+				}
+				SampleGrid(m_PreviousU.data(), rowU, m_CellsY, sampleX, sampleY, m_CellsX, values);
+				for (uint32_t face = 0; face < m_CellsX; face++)
+				{
+					sampleX[face] = face - values[face] * scale;
+					sampleY[face] = row - previous[face] * scale;
+				}
+				SampleGrid(m_PreviousV.data(), m_CellsX, m_CellsY + 1, sampleX, sampleY, m_CellsX,
+					m_V.data() + row * m_CellsX);
+			}
+		});
+}
+
+void GridFluid::AdvectDye(float dt, JobSystem& jobs)
+{
+	m_PreviousDye.swap(m_Dye);
+	float scale = dt / m_CellSize;
+	float fade = std::pow(m_DyeFade, dt);
+	uint32_t rowU = m_CellsX + 1;
+
+	// Cell centres trace back along the average of their faces
+	jobs.ParallelFor(m_CellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<float>& scratch = m_ChunkRows[begin / RowsPerJob];
+			float* sampleX = scratch.data();
+			float* sampleY = sampleX + rowU;
+			for (uint32_t row = begin; row < end; row++)
+			{
+				const float* u = m_U.data() + row * rowU;
+				const float* v = m_V.data() + row * m_CellsX;
+				for (uint32_t cell = 0; cell < m_CellsX; cell++)
+				{
+					sampleX[cell] = cell - (u[cell] + u[cell + 1]) * 0.5f * scale;
+					sampleY[cell] = row - (v[cell] + v[cell + m_CellsX]) * 0.5f * scale;
+				}
+
+				float* dye = m_Dye.data() + row * m_CellsX;
+				SampleGrid(m_PreviousDye.data(), m_CellsX, m_CellsY, sampleX, sampleY, m_CellsX, dye);
+				const uint8_t* solid = m_Solid.data() + row * m_CellsX;
+				for (uint32_t cell = 0; cell < m_CellsX; cell++)
+				{
+					dye[cell] = solid[cell] ? 0.0f : dye[cell] * fade;
+				}
+			}
+		});
+}
+
+float GridFluid::ComputeDivergence(JobSystem& jobs)
+{
+	Level& level = m_Levels[0];
+	uint32_t rowU = m_CellsX + 1;
+	jobs.ParallelFor(m_CellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			double sum = 0.0;
+			for (uint32_t row = begin; row < end; row++)
+			{
+				for (uint32_t cellX = 0; cellX < m_CellsX; cellX++)
+				{
+					uint32_t cell = row * m_CellsX + cellX;
+					uint32_t faceX = row * rowU + cellX;
+					float divergence = 0.0f;
+					if (level.diagonal[cell] > 0.0f)
+					{
+						divergence = m_U[faceX + 1] - m_U[faceX] + m_V[cell + m_CellsX] - m_V[cell];
+					}
+					level.rhs[cell] = divergence;
+					sum += divergence * divergence;
+				}
+			}
+			m_ChunkSums[begin / RowsPerJob] = sum;
+		});
+
+	double sum = 0.0;
+	for (uint32_t chunk = 0; chunk < (m_CellsY + RowsPerJob - 1) / RowsPerJob; chunk++)
+	{
+		sum += m_ChunkSums[chunk];
+	}
+	return (m_FluidCells > 0) ? static_cast<float>(std::sqrt(sum / m_FluidCells)) : 0.0f;
+}
+
+void GridFluid::Project(float dt, JobSystem& jobs)
+{
+	Level& level = m_Levels[0];
+	uint32_t rowU = m_CellsX + 1;
+
+	// Nothing flows through solids or the edges
+	jobs.ParallelFor(m_CellsY + 1, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t row = begin; row < end; row++)
+			{
+				if (row < m_CellsY)
+				{
+					for (uint32_t face = row * rowU; face < (row + 1) * rowU; face++)
+					{
+						m_U[face] = (level.weightX[face] > 0.0f) ? m_U[face] : 0.0f;
+					}
+				}
+				for (uint32_t face = row * m_CellsX; face < (row + 1) * m_CellsX; face++)
+				{
+					m_V[face] = (level.weightY[face] > 0.0f) ? m_V[face] : 0.0f;
+				}
+			}
+		});
+
+	// Pressure here is scaled by dt / cell size, so the correction is its plain difference
+	// across a face and the divergence is the right hand side as it is
+	float cellsPerStep = dt / m_CellSize;
+	m_Stats.divergenceBefore = ComputeDivergence(jobs) * cellsPerStep;
+	for (int cycle = 0; cycle < m_VCycles; cycle++)
+	{
+		VCycle(0, jobs);
+	}
+
+	const std::vector<float>& pressure = level.pressure;
+	jobs.ParallelFor(m_CellsY + 1, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t row = begin; row < end; row++)
+			{
+				if (row < m_CellsY)
+				{
+					for (uint32_t face = 1; face < m_CellsX; face++)
+					{
+						uint32_t cell = row * m_CellsX + face;
+						m_U[row * rowU + face] -= level.weightX[row * rowU + face] * (pressure[cell] - pressure[cell - 1]);
+					}
+				}
+				if (row > 0 && row < m_CellsY)
+				{
+					for (uint32_t face = row * m_CellsX; face < (row + 1) * m_CellsX; face++)
+					{
+						m_V[face] -= level.weightY[face] * (pressure[face] - pressure[face - m_CellsX]);
+					}
+				}
+			}
+		});
+
+	m_Stats.divergenceAfter = ComputeDivergence(jobs) * cellsPerStep;
+}
+
+void GridFluid::VCycle(uint32_t levelIndex, JobSystem& jobs)
+{
+	Level& level = m_Levels[levelIndex];
+	if (levelIndex + 1 == m_Levels.size())
+	{
+		Smooth(level, CoarsestIterations, jobs);
+		return;
+	}
+
+	Level& coarse = m_Levels[levelIndex + 1];
+	Smooth(level, m_Smoothing, jobs);
+	ComputeResidual(level, jobs);
+	Restrict(level, coarse, jobs);
+	VCycle(levelIndex + 1, jobs);
+	Prolong(coarse, level, jobs);
+	Smooth(level, m_Smoothing, jobs);
+}
+
+namespace
+{
+	// Weighted sum of a cell's neighbours' pressure, skipping the reads past the edges of the grid
+	// (the faces there are closed anyway)
+	float EdgeNeighbourSum(const float* weightX, const float* weightY, const float* pressure,
+		uint32_t cellsX, uint32_t cellsY, uint32_t cellX, uint32_t cellY)
+	{
+		uint32_t cell = cellY * cellsX + cellX;
+		uint32_t faceX = cellY * (cellsX + 1) + cellX;
+		float sum = 0.0f;
+		if (cellX > 0)
+		{
+			sum += weightX[faceX] * pressure[cell - 1];
+		}
+		if (cellX + 1 < cellsX)
+		{
+			sum += weightX[faceX + 1] * pressure[cell + 1];
+		}
+		if (cellY > 0)
+		{
+			sum += weightY[cell] * pressure[cell - cellsX];
+		}
+		if (cellY + 1 < cellsY)
+		{
+			sum += weightY[cell + cellsX] * pressure[cell + cellsX];
+		}
+		return sum;
+	}
+}
+
+void GridFluid::Smooth(Level& level, int iterations, JobSystem& jobs)
+{
+	uint32_t cellsX = level.cellsX;
+	uint32_t cellsY = level.cellsY;
+	const float* weightX = level.weightX.data();
+	const float* weightY = level.weightY.data();
+	const float* inverseDiagonal = level.inverseDiagonal.data();
+	const float* rhs = level.rhs.data();
+	float* pressure = level.pressure.data();
+
+	// Solid cells have an inverse diagonal of 0 and stay at 0 without a branch
+	auto relaxEdge = [&](uint32_t cellX, uint32_t row)
+		{
+			uint32_t cell = row * cellsX + cellX;
+			float sum = EdgeNeighbourSum(weightX, weightY, pressure, cellsX, cellsY, cellX, row);
+			pressure[cell] = (sum - rhs[cell]) * inverseDiagonal[cell];
+		};
+
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (uint32_t colour = 0; colour < 2; colour++)
+		{
+			// Red cells only read black ones and the other way round, so the rows of a colour can
+			// be split across threads
+			jobs.ParallelFor(cellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t row = begin; row < end; row++)
+					{
+						uint32_t parity = (row + colour) & 1;
+						if (row == 0 || row + 1 == cellsY)
+						{
+							for (uint32_t cellX = parity; cellX < cellsX; cellX += 2)
+							{
+								relaxEdge(cellX, row);
+							}
+							continue;
+						}
+
+						PressureRow pressureRow;
+						pressureRow.weightX = weightX + row * (cellsX + 1);
+						pressureRow.weightBelow = weightY + row * cellsX;
+						pressureRow.weightAbove = weightY + (row + 1) * cellsX;
+						pressureRow.below = pressure + (row - 1) * cellsX;
+						pressureRow.above = pressure + (row + 1) * cellsX;
+						pressureRow.rhs = rhs + row * cellsX;
+						pressureRow.inverseDiagonal = inverseDiagonal + row * cellsX;
+						pressureRow.pressure = pressure + row * cellsX;
+						if (parity == 0)
+						{
+							relaxEdge(0, row);
+						}
+						RelaxPressureRow(pressureRow, 1, cellsX - 1, parity);
+						if (((cellsX - 1) & 1) == parity)
+						{
+							relaxEdge(cellsX - 1, row);
+						}
+					}
+				});
+		}
+	}
+}
+
+void GridFluid::ComputeResidual(Level& level, JobSystem& jobs)
+{
+	uint32_t cellsX = level.cellsX;
+	uint32_t cellsY = level.cellsY;
+	const float* weightX = level.weightX.data();
+	const float* weightY = level.weightY.data();
+	const float* pressure = level.pressure.data();
+
+	// Solid cells have no open faces and a pressure of 0, so their residual is 0 too
+	auto residualEdge = [&](uint32_t cellX, uint32_t row)
+		{
+			uint32_t cell = row * cellsX + cellX;
+			float sum = EdgeNeighbourSum(weightX, weightY, pressure, cellsX, cellsY, cellX, row);
+			level.residual[cell] = level.rhs[cell] - (sum - level.diagonal[cell] * pressure[cell]);
+		};
+
+	jobs.ParallelFor(cellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t row = begin; row < end; row++)
+			{
+				if (row == 0 || row + 1 == cellsY)
+				{
+					for (uint32_t cellX = 0; cellX < cellsX; cellX++)
+					{
+						residualEdge(cellX, row);
+					}
+					continue;
+				}
+
+				residualEdge(0, row);
+				const float* rowWeightX = weightX + row * (cellsX + 1);
+				const float* below = weightY + row * cellsX;
+				const float* above = below + cellsX;
+				const float* centre = pressure + row * cellsX;
+				const float* down = centre - cellsX;
+				const float* up = centre + cellsX;
+				const float* diagonal = level.diagonal.data() + row * cellsX;
+				const float* rhs = level.rhs.data() + row * cellsX;
+				float* residual = level.residual.data() + row * cellsX;
+				for (uint32_t cellX = 1; cellX + 1 < cellsX; cellX++)
+				{
+					float sum = rowWeightX[cellX] * centre[cellX - 1] + rowWeightX[cellX + 1] * centre[cellX + 1] +
+						below[cellX] * down[cellX] + above[cellX] * up[cellX];
+					residual[cellX] = rhs[cellX] - (sum - diagonal[cellX] * centre[cellX]);
+				}
+				residualEdge(cellsX - 1, row);
+			}
+		});
+}
+
+void GridFluid::Restrict(const Level& fine, Level& coarse, JobSystem& jobs)
+{
+	// The pressure equation isn't divided by the cell area, so a coarse cell's right hand side
+	// is the sum of its four children rather than their average
+	jobs.ParallelFor(coarse.cellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t row = begin; row < end; row++)
+			{
+				for (uint32_t cellX = 0; cellX < coarse.cellsX; cellX++)
+				{
+					float sum = 0.0f;
+					for (uint32_t childY = 2 * row; childY < std::min(2 * row + 2, fine.cellsY); childY++)
+					{
+						for (uint32_t childX = 2 * cellX; childX < std::min(2 * cellX + 2, fine.cellsX); childX++)
+						{
+							sum += fine.residual[childY * fine.cellsX + childX];
+						}
+					}
+					uint32_t cell = row * coarse.cellsX + cellX;
+					coarse.rhs[cell] = sum;
+					coarse.pressure[cell] = 0.0f;
+				}
+			}
+		});
+}
+
+void GridFluid::Prolong(const Level& coarse, Level& fine, JobSystem& jobs)
+{
+	jobs.ParallelFor(fine.cellsY, RowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t row = begin; row < end; row++)
+			{
+				const float* parent = coarse.pressure.data() + (row / 2) * coarse.cellsX;
+				for (uint32_t cellX = 0; cellX < fine.cellsX; cellX++)
+				{
+					uint32_t cell = row * fine.cellsX + cellX;
+					if (fine.diagonal[cell] > 0.0f)
+					{
+						fine.pressure[cell] += parent[cellX / 2];
+					}
+				}
+			}
+		});
+}
\ No newline at end of file
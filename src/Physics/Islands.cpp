@@ -0,0 +1,76 @@
+#include "Physics/Islands.h"
+#include <utility>
+
+void Islands::Reset(uint32_t bodyCount)
+{
+	m_Parent.resize(bodyCount);
+	m_Size.assign(bodyCount, 1);
+	for (uint32_t i = 0; i < bodyCount; i++)
+	{
+		m_Parent[i] = i;
+	}
+}
+
+void Islands::Link(uint32_t first, uint32_t second)
+{
+	uint32_t rootFirst = Find(first);
+	uint32_t rootSecond = Find(second);
+	if (rootFirst == rootSecond)
+	{
+		return;
+	}
+
+	// Hang the smaller tree under the bigger one so paths stay short
+	if (m_Size[rootFirst] < m_Size[rootSecond])
+	{
+		std::swap(rootFirst, rootSecond);
+	}
+	m_Parent[rootSecond] = rootFirst;
+	m_Size[rootFirst] += m_Size[rootSecond];
+}
+
+uint32_t Islands::Find(uint32_t body)
+{
+	// Path halving, every visited body skips to its grandparent
+	while (m_Parent[body] != body)
+	{
+		m_Parent[body] = m_Parent[m_Parent[body]];
+		body = m_Parent[body];
+	}
+	return body;
+}
+
+void Islands::Build(const std::vector<uint32_t>& bodies)
+{
+	const uint32_t NoIsland = 0xFFFFFFFF;
+	m_RootIsland.assign(m_Parent.size(), NoIsland);
+	m_ListedIsland.resize(bodies.size());
+	m_IslandStart.clear();
+
+	// Islands are numbered in the order their first body shows up, counting members as we go
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		uint32_t root = Find(bodies[i]);
+		if (m_RootIsland[root] == NoIsland)
+		{
+			m_RootIsland[root] = static_cast<uint32_t>(m_IslandStart.size());
+			m_IslandStart.push_back(0);
+		}
+		m_ListedIsland[i] = m_RootIsland[root];
+		m_IslandStart[m_ListedIsland[i]]++;
+	}
+
+	uint32_t islandCount = static_cast<uint32_t>(m_IslandStart.size());
+	for (uint32_t island = 1; island < islandCount; island++)
+	{
+		m_IslandStart[island] += m_IslandStart[island - 1];
+	}
+	m_IslandStart.push_back(static_cast<uint32_t>(bodies.size()));
+
+	// Same backwards scatter as the grid, it keeps each island in body order
+	m_IslandBodies.resize(bodies.size());
+	for (size_t i = bodies.size(); i-- > 0;)
+	{
+		m_IslandBodies[--m_IslandStart[m_ListedIsland[i]]] = bodies[i];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "Physics/MortonOrder.h"
+#include <algorithm>
+
+namespace
+{
+	// Spreads the low 16 bits out to the even bits
+	inline uint32_t SpreadBits(uint32_t value)
+	{
+		value &= 0x0000FFFF;
+		value = (value | (value << 8)) & 0x00FF00FF;
+		value = (value | (value << 4)) & 0x0F0F0F0F;
+		value = (value | (value << 2)) & 0x33333333;
+		value = (value | (value << 1)) & 0x55555555;
+		return value;
+	}
+}
+
+uint32_t MortonOrder::Encode(uint32_t x, uint32_t y)
+{
+	return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+float MortonOrder::Compute(const float* x, const float* y, size_t count, float aspectRatio)
+{
+	m_Codes.resize(count);
+	m_Extent = 0.0f;
+	if (count < 2)
+	{
+		std::fill(m_Codes.begin(), m_Codes.end(), 0u);
+		return 0.0f;
+	}
+
+	float minX = x[0];
+	float minY = y[0];
+	float maxX = x[0];
+	float maxY = y[0];
+	for (size_t i = 1; i < count; i++)
+	{
+		minX = std::min(minX, x[i]);
+		minY = std::min(minY, y[i]);
+		maxX = std::max(maxX, x[i]);
+		maxY = std::max(maxY, y[i]);
+	}
+
+	// One scale for both axes so the cells are square
+	float extent = std::max((maxX - minX) * aspectRatio, maxY - minY);
+	float scale = (extent > 0.0f) ? 65535.0f / extent : 0.0f;
+	m_Extent = extent;
+
+	uint32_t outOfOrder = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t cellX = static_cast<uint32_t>((x[i] - minX) * aspectRatio * scale);
+		uint32_t cellY = static_cast<uint32_t>((y[i] - minY) * scale);
+		m_Codes[i] = Encode(std::min(cellX, 65535u), std::min(cellY, 65535u));
+		outOfOrder += (i > 0 && m_Codes[i] < m_Codes[i - 1]) ? 1 : 0;
+	}
+
+	return static_cast<float>(outOfOrder) / static_cast<float>(count - 1);
+}
+
+const std::vector<uint32_t>& MortonOrder::Sort()
+{
+	size_t count = m_Codes.size();
+	m_Order.resize(count);
+	m_OrderScratch.resize(count);
+	m_CodeScratch.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_Order[i] = i;
+	}
+
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t offsets[256] = {};
+		for (uint32_t code : m_Codes)
+		{
+			offsets[(code >> shift) & 0xFF]++;
+		}
+
+		// Every code has the same digit, this pass wouldn't move anything
+		if (count == 0 || offsets[(m_Codes[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		uint32_t start = 0;
+		for (uint32_t& offset : offsets)
+		{
+			uint32_t digitCount = offset;
+			offset = start;
+			start += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t position = offsets[(m_Codes[i] >> shift) & 0xFF]++;
+			m_CodeScratch[position] = m_Codes[i];
+			m_OrderScratch[position] = m_Order[i];
+		}
+
+		m_Codes.swap(m_CodeScratch);
+		m_Order.swap(m_OrderScratch);
+	}
+
+	return m_Order;
+}
\ No newline at end of file
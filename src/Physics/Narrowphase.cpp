@@ -0,0 +1,119 @@
+#include "Physics/Narrowphase.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// A circle centre closer than this to a square counts as inside it
+	const float MinDistanceSquared = 0.0001f * 0.0001f;
+
+	inline bool CollideCircleSquare(const BodyStore& bodies, uint32_t circle, uint32_t square, float aspectRatio,
+		float margin, PairContact& contact)
+	{
+		// Circle centre relative to the square, and the square's half size
+		float dx = (bodies.x[circle] - bodies.x[square]) * aspectRatio;
+		float dy = bodies.y[circle] - bodies.y[square];
+		float halfWidth = bodies.halfWidth[square] * aspectRatio;
+		float halfHeight = bodies.halfHeight[square];
+		float radius = bodies.halfHeight[circle];
+
+		// Point of the square closest to the centre
+		float offsetX = dx - std::min(std::max(dx, -halfWidth), halfWidth);
+		float offsetY = dy - std::min(std::max(dy, -halfHeight), halfHeight);
+		float distanceSquared = offsetX * offsetX + offsetY * offsetY;
+
+		if (distanceSquared >= MinDistanceSquared)
+		{
+			float reach = radius + margin;
+			if (distanceSquared >= reach * reach)
+			{
+				return false;
+			}
+
+			// The square is on the far side of the closest point from the centre
+			float distance = std::sqrt(distanceSquared);
+			contact = { circle, square, -offsetX / distance, -offsetY / distance, radius - distance };
+			return true;
+		}
+
+		// Centre inside the square, push it out through the nearest side
+		float depthX = halfWidth - std::abs(dx);
+		float depthY = halfHeight - std::abs(dy);
+		if (depthX < depthY)
+		{
+			contact = { circle, square, (dx > 0) ? -1.0f : 1.0f, 0.0f, radius + depthX };
+		}
+		else
+		{
+			contact = { circle, square, 0.0f, (dy > 0) ? -1.0f : 1.0f, radius + depthY };
+		}
+
+		return true;
+	}
+
+	inline bool CollideSquareSquare(const BodyStore& bodies, uint32_t square1, uint32_t square2, float aspectRatio,
+		float margin, PairContact& contact)
+	{
+		float dx = bodies.x[square2] - bodies.x[square1];
+		float dy = bodies.y[square2] - bodies.y[square1];
+		float halfWidths = bodies.halfWidth[square1] + bodies.halfWidth[square2];
+		float halfHeights = bodies.halfHeight[square1] + bodies.halfHeight[square2];
+
+		// The margin goes on one square only, it's the gap allowed between the two
+		if (std::abs(dx) >= halfWidths + margin / aspectRatio || std::abs(dy) >= halfHeights + margin)
+		{
+			return false;
+		}
+
+		// Separate along the axis with the least overlap, x measured in aspect corrected space
+		float overlapX = (halfWidths - std::abs(dx)) * aspectRatio;
+		float overlapY = halfHeights - std::abs(dy);
+		if (overlapX < overlapY)
+		{
+			contact = { square1, square2, (dx > 0) ? 1.0f : -1.0f, 0.0f, overlapX };
+		}
+		else
+		{
+			contact = { square1, square2, 0.0f, (dy > 0) ? 1.0f : -1.0f, overlapY };
+		}
+
+		return true;
+	}
+}
+
+template <>
+void CollidePairs<ShapeType::Circle, ShapeType::Circle>(const BodyStore& bodies, const BodyPair* pairs, size_t count,
+	float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	// For circles halfHeight is the radius
+	CollideCirclePairs(bodies.x.data(), bodies.y.data(), bodies.halfHeight.data(), pairs, count, aspectRatio, margin,
+		contacts);
+}
+
+template <>
+void CollidePairs<ShapeType::Circle, ShapeType::Square>(const BodyStore& bodies, const BodyPair* pairs, size_t count,
+	float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	PairContact contact;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (CollideCircleSquare(bodies, pairs[i].a, pairs[i].b, aspectRatio, margin, contact))
+		{
+			contacts.push_back(contact);
+		}
+	}
+}
+
+template <>
+void CollidePairs<ShapeType::Square, ShapeType::Square>(const BodyStore& bodies, const BodyPair* pairs, size_t count,
+	float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	PairContact contact;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (CollideSquareSquare(bodies, pairs[i].a, pairs[i].b, aspectRatio, margin, contact))
+		{
+			contacts.push_back(contact);
+		}
+	}
+}
\ No newline at end of file
@@ -1,494 +1,1189 @@
 #include "Physics/PhysicsLayer.h"
+#include "Physics/SimdKernels.h"
+#include "Physics/UniformGrid.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
 
 Physics::Physics(float gravity, float groundPosition, float groundHeight, float groundWidth, float bounceLevel, float aspectRatio)
-	: m_Gravity(gravity), m_GroundPosition(groundPosition),m_GroundHeight(groundHeight), m_GroundWidth(groundWidth), 
-	m_BounceLevel(bounceLevel), m_AspectRatio(aspectRatio), m_Restitution(0.7f), m_VelocityThreshold(0.0001f)
+	: m_Gravity(gravity), m_GroundPosition(groundPosition),m_GroundHeight(groundHeight), m_GroundWidth(groundWidth),
+	m_BounceLevel(bounceLevel), m_AspectRatio(aspectRatio), m_Restitution(0.7f), m_StaticGeometry(aspectRatio),
+	m_QuerySnapshot(aspectRatio),
+	m_Jobs(new JobSystem()), m_BroadPhase(CreateBroadPhase(BroadPhaseType::UniformGrid)), m_BroadPhaseType(BroadPhaseType::UniformGrid),
+	m_GridCellSize(0.0f), m_AutoTuneBroadPhase(true), m_PairStats(),
+	m_Solver(aspectRatio), m_SolverType(SolverType::Impulse), m_Substeps(8), m_SpeculativeMargin(0.01f), m_ContactMargin(0.0f),
+	m_ContinuousCollision(true), m_SweepFraction(0.5f), m_ReorderInterval(60), m_StepsSinceReorder(0), m_ReorderThreshold(0.1f),
+	m_GravityMode(GravityMode::Uniform), m_GravitationalConstant(1.0f), m_Fluid(aspectRatio),
+	m_GridFluid(aspectRatio, 0, 0), m_GridFluidEnabled(false), m_GridObstaclesDirty(true), m_GridFluidDrag(2.0f),
+	m_SleepEnabled(true), m_WakeAll(false), m_SleepVelocity(0.05f), m_TimeToSleep(0.5f), m_ProxiesChanged(false)
 {
+	m_BroadPhaseTuner.Reset({ m_BroadPhaseType, m_GridCellSize });
+	// Sleeping bodies don't move, their leaves need no room to
+	m_SleepingTree.SetMargin(0.0f);
+	m_SleepingTree.SetBounds(m_SleepingBounds);
 }
 
 Physics::~Physics()
 {
+	delete m_BroadPhase;
+	delete m_Jobs;
 }
 
-void Physics::Update(std::vector<Shape>& shapes, float dt)
+void Physics::Update(BodyStore& bodies, float dt)
 {
-	for (auto& shape : shapes)
+	size_t count = bodies.Size();
+
+	// Walls added since the last step go into the tree before anything queries it
+	m_StaticGeometry.Build();
+
+	// The fluid only reads the ground and walls, so it doesn't care whether the bodies sleep
+	m_Fluid.Step(dt, m_Gravity, GetGroundBox(), m_StaticGeometry, *m_Jobs);
+	if (m_GridFluidEnabled)
 	{
-		if (shape.noMovement)
+		if (m_GridObstaclesDirty)
 		{
-			continue;
+			m_GridFluid.SetObstacles(GetGroundBox(), m_StaticGeometry);
+			m_GridObstaclesDirty = false;
 		}
-		ApplyGravity(shape);
-		UpdatePosition(shape, dt);
-		ApplyGroundCollision(shape);
-		ApplyWallCollision(shape);
+		m_GridFluid.Step(dt, *m_Jobs);
+		ApplyGridFluid(bodies, dt);
 	}
 
-	UpdateObjectCollisions(shapes);
-	DeleteObjectsOutOfFrame(shapes);
+	// Rendering interpolates from here, done before the early out so bodies that just fell
+	// asleep stop blending
+	bodies.prevX = bodies.x;
+	bodies.prevY = bodies.y;
 
-	for (auto& shape : shapes)
+	if (m_WakeAll)
 	{
-		ApplyFriction(shape, shapes);
+		for (uint32_t island = 0; island < m_SleepingIslands.size(); island++)
+		{
+			if (!m_SleepingIslands[island].empty())
+			{
+				WakeIsland(bodies, island);
+			}
+		}
+		m_WakeAll = false;
 	}
-}
 
-void Physics::UpdatePosition(Shape& shape, float dt)
-{
-	shape.x = shape.x + (shape.xVcty * dt);
-	shape.y = shape.y + (shape.yVcty * dt);
+	// Once everything has settled a step costs only this scan
+	bool anyAwake = false;
+	for (size_t i = 0; i < count && !anyAwake; i++)
+	{
+		anyAwake = !bodies.noMovement[i] && !bodies.asleep[i];
+	}
+
+	if (!anyAwake)
+	{
+		m_Sensors.ClearEvents();
+		return;
+	}
+
+	// Before anything this step holds on to indices
+	ReorderBodies(bodies);
+
+	// The pull of every body on every other only depends on where they start the step
+	if (m_GravityMode == GravityMode::NBody)
+	{
+		ComputeNBodyGravity(bodies);
+	}
+
+	// Substeps reuse the contacts found here, so bodies that get close during the step need to
+	// be found already. The impulse solver would treat them as touching, it gets no margin
+	m_ContactMargin = (m_SolverType == SolverType::Substep) ? m_SpeculativeMargin : 0.0f;
+
+	// Contacts are found where the bodies start the step. Bodies first, touching a sleeping
+	// body wakes it up in time to get its ground and wall contacts too
+	m_Solver.Clear();
+	FindObjectContacts(bodies);
+	FindStaticContacts(bodies);
+
+	if (m_SolverType == SolverType::Substep)
+	{
+		SolveSubsteps(bodies, dt);
+	}
+	else
+	{
+		UpdateVelocity(bodies, dt);
+		m_Solver.Prepare(bodies, *m_Jobs);
+		m_Solver.SolveVelocities(bodies, *m_Jobs);
+
+		UpdatePosition(bodies, dt);
+		SweepFastBodies(bodies, bodies.prevX, bodies.prevY);
+		m_Solver.SolvePositions(bodies, *m_Jobs);
+		m_Solver.StoreImpulses();
+	}
+
+	UpdateSleep(bodies, dt);
+
+	// Removing moves bodies around, so it runs after everything that holds indices for this step
+	DeleteObjectsOutOfFrame(bodies);
 }
 
-void Physics::UpdateObjectCollisions(std::vector<Shape>& shapes)
+void Physics::ComputeNBodyGravity(const BodyStore& bodies)
 {
-	for (int i = 0; i < shapes.size() - 1; i++)
-	{
-		for (int j = i + 1; j < shapes.size(); j++)
+	m_BarnesHut.Build(bodies, m_AspectRatio, *m_Jobs);
+	m_BarnesHut.ComputeAccelerations(*m_Jobs);
+
+	// Back from aspect corrected space to x / y units, bodies outside the tree aren't pulled
+	m_NBodyX.assign(bodies.Size(), 0.0f);
+	m_NBodyY.assign(bodies.Size(), 0.0f);
+	float scaleX = m_GravitationalConstant / m_AspectRatio;
+	m_Jobs->ParallelFor(static_cast<uint32_t>(m_BarnesHut.Size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
 		{
-			if (shapes[i].shape == ShapeType::Circle && shapes[j].shape == ShapeType::Circle)
-			{
-				ApplyCircleCollision(shapes[i], shapes[j]);
-			}
-
-			if (shapes[i].shape == ShapeType::Square && shapes[j].shape == ShapeType::Square)
+			for (uint32_t i = begin; i < end; i++)
 			{
-				ApplySquareCollision(shapes[i], shapes[j]);
+				uint32_t body = m_BarnesHut.GetBody(i);
+				m_NBodyX[body] = m_BarnesHut.GetAccelerationX(i) * scaleX;
+				m_NBodyY[body] = m_BarnesHut.GetAccelerationY(i) * m_GravitationalConstant;
 			}
-		}
-	}
+		});
 }
 
-void Physics::DeleteObjectsOutOfFrame(std::vector<Shape>& shapes)
+void Physics::UpdateVelocity(BodyStore& bodies, float dt)
 {
-	for (auto& shape : shapes)
+	if (m_GravityMode == GravityMode::NBody)
 	{
-		if (shape.x < -1.5f || shape.x > 1.5f || shape.y < -2.0f || shape.y > 1.5f)
-		{
-			shape.noMovement = true;
-
-			// implement removing from vector in the future
-		}
+		m_Jobs->ParallelFor(static_cast<uint32_t>(bodies.Size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					float step = (bodies.noMovement[i] | bodies.asleep[i]) ? 0.0f : dt;
+					bodies.xVcty[i] += m_NBodyX[i] * step;
+					bodies.yVcty[i] += m_NBodyY[i] * step;
+				}
+			});
+		return;
 	}
-}
 
-void Physics::SetGravity(float gravity)
-{
-	m_Gravity = gravity;
+	// Bodies that don't move are masked out
+	m_Jobs->ParallelFor(static_cast<uint32_t>(bodies.Size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			IntegrateVelocities(bodies.yVcty.data() + begin, bodies.noMovement.data() + begin,
+				bodies.asleep.data() + begin, end - begin, m_Gravity, dt);
+		});
 }
 
-void Physics::SetBounceLevel(float bounceLevel)
+void Physics::UpdatePosition(BodyStore& bodies, float dt)
 {
-	m_BounceLevel = bounceLevel;
+	m_Jobs->ParallelFor(static_cast<uint32_t>(bodies.Size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			IntegratePositions(bodies.x.data() + begin, bodies.y.data() + begin, bodies.xVcty.data() + begin,
+				bodies.yVcty.data() + begin, bodies.noMovement.data() + begin, bodies.asleep.data() + begin,
+				end - begin, dt);
+		});
 }
 
-void Physics::ApplyGravity(Shape& shape)
+void Physics::SolveSubsteps(BodyStore& bodies, float dt)
 {
-	shape.yVcty = shape.yVcty - m_Gravity;
+	// The contacts found at the start of the step are reused by every substep
+	float h = dt / m_Substeps;
+	m_Solver.PrepareSubsteps(bodies, *m_Jobs);
+
+	for (int substep = 0; substep < m_Substeps; substep++)
+	{
+		m_Solver.StoreApproachVelocities(bodies, *m_Jobs);
+		m_SubstepX = bodies.x;
+		m_SubstepY = bodies.y;
+
+		UpdateVelocity(bodies, h);
+		UpdatePosition(bodies, h);
+		SweepFastBodies(bodies, m_SubstepX, m_SubstepY);
+		m_Solver.SolveSubstepPositions(bodies, *m_Jobs, h);
+
+		// Velocity is whatever the substep did to the position, pushes included
+		float invH = 1.0f / h;
+		m_Jobs->ParallelFor(static_cast<uint32_t>(bodies.Size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					if (bodies.noMovement[i] || bodies.asleep[i])
+					{
+						continue;
+					}
+					bodies.xVcty[i] = (bodies.x[i] - m_SubstepX[i]) * invH;
+					bodies.yVcty[i] = (bodies.y[i] - m_SubstepY[i]) * invH;
+				}
+			});
+
+		m_Solver.SolveSubstepVelocities(bodies, *m_Jobs, h, m_Gravity);
+	}
 }
 
-void Physics::ApplyFriction(Shape& shape, std::vector<Shape>& shapes)
+void Physics::FindStaticContacts(BodyStore& bodies)
 {
-	for (Shape& shape : shapes)
+	// Ground and walls only involve the body being tested, so bodies can be split across threads
+	uint32_t count = static_cast<uint32_t>(bodies.Size());
+	uint32_t chunkCount = (count + BodiesPerJob - 1) / BodiesPerJob;
+	if (m_ChunkStaticContacts.size() < chunkCount)
 	{
-		if (IsOnGround(shape))
-		{
-			shape.xVcty = shape.xVcty * 0.9999f;
-		}
+		m_ChunkStaticContacts.resize(chunkCount);
+	}
 
-		if (IsOnGround(shape) && IsTouchingAnything(shape, shapes))
+	m_Jobs->ParallelFor(count, BodiesPerJob, [&](uint32_t begin, uint32_t end)
 		{
-			shape.xVcty = shape.xVcty * 0.9995f;
-		}
-		
-		if (IsTouchingAnything(shape, shapes))
-		{
-			shape.xVcty = shape.xVcty * 0.9999f;
-		}
+			std::vector<ContactConstraint>& chunkContacts = m_ChunkStaticContacts[begin / BodiesPerJob];
+			chunkContacts.clear();
+			std::vector<uint32_t> nearbyWalls;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				if (bodies.noMovement[i] || bodies.asleep[i] || bodies.sensor[i])
+				{
+					continue;
+				}
+				FindGroundContact(bodies, i, chunkContacts);
+				FindWallContacts(bodies, i, nearbyWalls, chunkContacts);
+			}
+		});
+
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		m_Solver.AddContacts(m_ChunkStaticContacts[chunk]);
 	}
 }
 
-bool Physics::IsTouchingAnything(Shape& shape, std::vector<Shape>& shapes)
+void Physics::FindObjectContacts(BodyStore& bodies)
 {
-	for (Shape& otherShape : shapes)
+	// Bodies woken between steps are proxies again
+	RemoveWokenBodies(bodies, false);
+
+	// The proxy ids are positions in m_BoundsOwner, so a broadphase that keeps state sees them
+	// all shift once a body joins or leaves it
+	if (m_ProxiesChanged)
+	{
+		m_BroadPhase->Reset();
+		m_ProxiesChanged = false;
+	}
+
+	// Broadphase: only circles and squares collide with each other, so only they get proxies.
+	// Sleeping bodies are in m_SleepingTree instead, apart from sensors which never go in it
+	m_BoundsOwner.clear();
+	m_ProxyFilters.clear();
+	for (uint32_t i = 0; i < bodies.Size(); i++)
 	{
-		if (&shape == &otherShape)
+		if ((bodies.type[i] == ShapeType::Circle || bodies.type[i] == ShapeType::Square) &&
+			(!bodies.asleep[i] || bodies.sensor[i]))
 		{
-			continue;
+			m_BoundsOwner.push_back(i);
+			m_ProxyFilters.push_back(bodies.filter[i]);
 		}
-		if (shape.shape == ShapeType::Circle && otherShape.shape == ShapeType::Circle)
+	}
+
+	m_Bounds.resize(m_BoundsOwner.size());
+	m_Jobs->ParallelFor(static_cast<uint32_t>(m_Bounds.size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
 		{
-			if (CheckCircleCollision(shape, otherShape))
+			for (uint32_t proxy = begin; proxy < end; proxy++)
 			{
-				return true;
+				m_Bounds[proxy] = ComputeBounds(bodies, m_BoundsOwner[proxy]);
 			}
-		}
-		else if (shape.shape == ShapeType::Square && otherShape.shape == ShapeType::Square)
+		});
+
+	auto broadPhaseStart = std::chrono::steady_clock::now();
+	m_BroadPhase->SetFilters(m_ProxyFilters.data());
+	m_BroadPhase->UpdateParallel(m_Bounds, *m_Jobs);
+	m_BroadPhase->FindPairsParallel(m_Pairs, *m_Jobs);
+
+	// Every proxy looks itself up in the tree of sleeping bodies, each chunk of proxies into its
+	// own buffer. The tree only holds bodies that were asleep when the step started
+	uint32_t proxyCount = static_cast<uint32_t>(m_BoundsOwner.size());
+	uint32_t proxyChunkCount = m_SleepingTree.IsEmpty() ? 0 : (proxyCount + BodiesPerJob - 1) / BodiesPerJob;
+	if (m_ChunkSleepingPairs.size() < proxyChunkCount)
+	{
+		m_ChunkSleepingPairs.resize(proxyChunkCount);
+	}
+	if (proxyChunkCount > 0)
+	{
+		m_Jobs->ParallelFor(proxyCount, BodiesPerJob, [&](uint32_t begin, uint32_t end)
+			{
+				std::vector<BodyPair>& chunkPairs = m_ChunkSleepingPairs[begin / BodiesPerJob];
+				chunkPairs.clear();
+				std::vector<uint32_t> slots;
+				for (uint32_t proxy = begin; proxy < end; proxy++)
+				{
+					m_SleepingTree.QueryAABB(m_Bounds[proxy], slots);
+					for (uint32_t slot : slots)
+					{
+						// The body may have been removed while it slept
+						uint32_t other = bodies.IndexOf(m_SleepingHandles[slot]);
+						if (other != BodyStore::InvalidIndex)
+						{
+							chunkPairs.push_back({ m_BoundsOwner[proxy], other });
+						}
+					}
+				}
+			});
+	}
+	auto broadPhaseEnd = std::chrono::steady_clock::now();
+
+	m_PairStats.filtered = m_BroadPhase->GetFilteredPairCount();
+	m_PairStats.sleeping = 0;
+	m_PairStats.touching = 0;
+
+	// Narrowphase on the candidate pairs only, keeping the ones that were really touching.
+	// Pairs are sorted into a bucket per pair type and every bucket is tested in one batch
+	m_Contacts.clear();
+	m_SensorPairs.clear();
+	for (std::vector<BodyPair>& bucket : m_PairBuckets)
+	{
+		bucket.clear();
+	}
+
+	auto addPair = [&](uint32_t first, uint32_t second)
+		{
+			// Sensors never collide, their pairs only go to the sensor events. Two sensors don't
+			// report each other
+			if (bodies.sensor[first] | bodies.sensor[second])
+			{
+				if (!(bodies.sensor[first] & bodies.sensor[second]))
+				{
+					m_SensorPairs.push_back({ first, second });
+				}
+				return;
+			}
+
+			bool swap;
+			uint32_t pairType = GetPairType(bodies.type[first], bodies.type[second], swap);
+			if (pairType != NoPairType)
+			{
+				m_PairBuckets[pairType].push_back(swap ? BodyPair{ second, first } : BodyPair{ first, second });
+			}
+		};
+
+	for (const BodyPair& pair : m_Pairs)
+	{
+		addPair(m_BoundsOwner[pair.a], m_BoundsOwner[pair.b]);
+	}
+
+	// The broadphase already dropped its filtered pairs, the ones against sleeping bodies are
+	// dropped here
+	for (uint32_t chunk = 0; chunk < proxyChunkCount; chunk++)
+	{
+		for (const BodyPair& pair : m_ChunkSleepingPairs[chunk])
 		{
-			if (CheckSquareCollision(shape, otherShape))
+			if (!CanCollide(bodies.filter[pair.a], bodies.filter[pair.b]))
 			{
-				return true;
+				m_PairStats.filtered++;
+				continue;
 			}
+			m_PairStats.sleeping++;
+			addPair(pair.a, pair.b);
 		}
-		else
+	}
+	m_PairStats.overlapping = static_cast<uint32_t>(m_Pairs.size()) + m_PairStats.sleeping + m_PairStats.filtered;
+
+	// Each chunk of pairs fills its own buffer and the buffers are joined in chunk order, so
+	// the contacts come out in bucket then pair order whatever the thread count. Nothing moves
+	// until the solver runs, so every result stays valid
+	m_PairStats.sensor = static_cast<uint32_t>(m_SensorPairs.size());
+	m_PairStats.tested = 0;
+	for (uint32_t pairType = 0; pairType < PairTypeCount; pairType++)
+	{
+		const std::vector<BodyPair>& bucket = m_PairBuckets[pairType];
+		CollideFunction collide = CollideFunctions[pairType];
+		uint32_t pairCount = static_cast<uint32_t>(bucket.size());
+		m_PairStats.tested += pairCount;
+		uint32_t chunkCount = (pairCount + PairsPerJob - 1) / PairsPerJob;
+		if (m_ChunkContacts.size() < chunkCount)
 		{
-			// CheckCircleSquareCollision(shape, otherShape);
-			return true;
+			m_ChunkContacts.resize(chunkCount);
+		}
+
+		m_Jobs->ParallelFor(pairCount, PairsPerJob, [&](uint32_t begin, uint32_t end)
+			{
+				std::vector<PairContact>& chunkContacts = m_ChunkContacts[begin / PairsPerJob];
+				chunkContacts.clear();
+				collide(bodies, bucket.data() + begin, end - begin, m_AspectRatio, m_ContactMargin, chunkContacts);
+			});
+
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			m_PairStats.touching += static_cast<uint32_t>(m_ChunkContacts[chunk].size());
+			for (const PairContact& contact : m_ChunkContacts[chunk])
+			{
+				WakeTouching(bodies, contact.a, contact.b);
+				AddPairContact(bodies, contact);
+			}
 		}
 	}
 
-	return 0;
+	// A woken island needs the contacts between its own bodies and with the sleeping bodies
+	// around it too, neither were broadphase pairs
+	RemoveWokenBodies(bodies, true);
+
+	UpdateSensors(bodies);
+
+	// The new setting takes over from the next step, the bounds of this one are done with
+	if (m_AutoTuneBroadPhase)
+	{
+		double broadPhaseMilliseconds = std::chrono::duration<double, std::milli>(broadPhaseEnd - broadPhaseStart).count();
+		double pairTestMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - broadPhaseEnd).count();
+		UseBroadPhase(m_BroadPhaseTuner.Sample(m_Bounds, broadPhaseMilliseconds, pairTestMilliseconds));
+	}
 }
 
-bool Physics::IsOnGround(Shape& shape)
+void Physics::UpdateSensors(const BodyStore& bodies)
 {
-	float topOfGround = m_GroundPosition + (m_GroundHeight / 2);
-	float groundLeftBoundary = 0.0 - (m_GroundWidth / 2 / m_AspectRatio);
-	float groundRightBoundary = 0.0 + (m_GroundWidth / 2 / m_AspectRatio);
+	// Sensor pairs get the same bucketed exact test as contacts but without a margin, and are
+	// tested whatever the bodies' sleep state since nothing gets woken by them
+	for (std::vector<BodyPair>& bucket : m_PairBuckets)
+	{
+		bucket.clear();
+	}
+	for (const BodyPair& pair : m_SensorPairs)
+	{
+		bool swap;
+		uint32_t pairType = GetPairType(bodies.type[pair.a], bodies.type[pair.b], swap);
+		m_PairBuckets[pairType].push_back(swap ? BodyPair{ pair.b, pair.a } : pair);
+	}
+
+	m_Sensors.BeginStep();
+	for (uint32_t pairType = 0; pairType < PairTypeCount; pairType++)
+	{
+		m_PairContacts.clear();
+		CollideFunctions[pairType](bodies, m_PairBuckets[pairType].data(), m_PairBuckets[pairType].size(),
+			m_AspectRatio, 0.0f, m_PairContacts);
+		for (const PairContact& contact : m_PairContacts)
+		{
+			if (contact.overlap <= 0.0f)
+			{
+				continue;
+			}
 
-	float bottomOfShape = shape.y - (shape.size / 2.0f);
-	float leftOfShape = shape.x - (shape.size / 2.0f) / m_AspectRatio;
-	float rightOfShape = shape.x + (shape.size / 2.0f) / m_AspectRatio;
+			bool sensorFirst = bodies.sensor[contact.a] != 0;
+			m_Sensors.AddOverlap(bodies.HandleAt(sensorFirst ? contact.a : contact.b),
+				bodies.HandleAt(sensorFirst ? contact.b : contact.a));
+		}
+	}
+	m_Sensors.EndStep();
+}
 
-	float distanceToGround = topOfGround - bottomOfShape;
+bool Physics::FindPairContact(BodyStore& bodies, uint32_t first, uint32_t second)
+{
+	bool swap;
+	uint32_t pairType = GetPairType(bodies.type[first], bodies.type[second], swap);
+	if (pairType == NoPairType)
+	{
+		return false;
+	}
 
-	if (distanceToGround <= m_VelocityThreshold && rightOfShape > groundLeftBoundary && leftOfShape < groundRightBoundary)
+	BodyPair pair = swap ? BodyPair{ second, first } : BodyPair{ first, second };
+	m_PairContacts.clear();
+	CollideFunctions[pairType](bodies, &pair, 1, m_AspectRatio, m_ContactMargin, m_PairContacts);
+	if (m_PairContacts.empty())
 	{
-		return true;
+		return false;
 	}
 
-	return false;
+	AddPairContact(bodies, m_PairContacts[0]);
+	return WakeTouching(bodies, first, second);
 }
 
-bool Physics::CheckCircleCollision(Shape& circle1, Shape& circle2)
+AABB Physics::ComputeBounds(const BodyStore& bodies, uint32_t index)
 {
-	// distance between two circles center points
-	float dx = (circle2.x - circle1.x) * m_AspectRatio;
-	float dy = circle2.y - circle1.y;
-	float dist = sqrt(pow(dx, 2) + pow(dy, 2));
+	float x = bodies.x[index];
+	float y = bodies.y[index];
+	float halfWidth = bodies.halfWidth[index] + m_ContactMargin / m_AspectRatio;
+	float halfHeight = bodies.halfHeight[index] + m_ContactMargin;
 
-	// distance of radius of circles combined
-	float radius1 = circle1.size / 3.5f;
-	float radius2 = circle2.size / 3.5f;
-	float distanceBetween = radius1 + radius2;
+	return { x - halfWidth, y - halfHeight, x + halfWidth, y + halfHeight };
+}
 
-	if (dist >= distanceBetween)
+void Physics::DeleteObjectsOutOfFrame(BodyStore& bodies)
+{
+	// Backwards, so the body swapped into a removed index has already been checked
+	for (uint32_t i = static_cast<uint32_t>(bodies.Size()); i-- > 0;)
 	{
-		return false;
+		if (bodies.x[i] < -1.5f || bodies.x[i] > 1.5f || bodies.y[i] < -2.0f || bodies.y[i] > 1.5f)
+		{
+			bodies.RemoveAt(i);
+		}
+	}
+}
+
+void Physics::ReorderBodies(BodyStore& bodies)
+{
+	if (m_ReorderInterval <= 0 || ++m_StepsSinceReorder < m_ReorderInterval)
+	{
+		return;
 	}
+	m_StepsSinceReorder = 0;
 
-	return true;
+	float outOfOrder = m_MortonOrder.Compute(bodies.x.data(), bodies.y.data(), bodies.Size(), m_AspectRatio);
+	if (outOfOrder > m_ReorderThreshold)
+	{
+		bodies.Reorder(m_MortonOrder.Sort());
+		// Proxies are in body order, so a broadphase that keeps state sees every proxy move
+		m_BroadPhase->Reset();
+	}
 }
 
+void Physics::SetReorderInterval(int steps)
+{
+	m_ReorderInterval = steps;
+	m_StepsSinceReorder = 0;
+}
 
-bool Physics::CheckSquareCollision(Shape& square1, Shape& square2)
+void Physics::SetReorderThreshold(float fraction)
 {
-	float halfWidth1 = (square1.size / 2.0f) / m_AspectRatio;
-	float halfHeight1 = square1.size / 2.0f;
-	float halfWidth2 = (square2.size / 2.0f) / m_AspectRatio;
-	float halfHeight2 = square2.size / 2.0f;
+	m_ReorderThreshold = fraction;
+}
 
-	return ((abs(square1.x - square2.x) < (halfWidth1 + halfWidth2)) && (abs(square1.y - square2.y) < (halfHeight1 + halfHeight2)));
+void Physics::SetGravityMode(GravityMode mode)
+{
+	m_GravityMode = mode;
+	m_WakeAll = true;
 }
 
+void Physics::SetGravitationalConstant(float constant)
+{
+	m_GravitationalConstant = constant;
+	m_WakeAll = true;
+}
 
-bool Physics::CheckCircleSquareCollision(Shape& circle, Shape& square)
+void Physics::SetGravity(float gravity)
 {
-	return false;
+	m_Gravity = gravity;
+	m_WakeAll = true;
 }
 
-void Physics::ApplyCircleCollision(Shape& circle1, Shape& circle2)
+void Physics::SetBounceLevel(float bounceLevel)
 {
-	// distance between two circles center points
-	float dx = (circle2.x - circle1.x) * m_AspectRatio;
-	float dy = circle2.y - circle1.y;
-	float dist = sqrt(pow(dx, 2) + pow(dy, 2));
+	m_BounceLevel = bounceLevel;
+}
 
-	// distance of radius of circles combined
-	float radius1 = circle1.size / 3.5f;
-	float radius2 = circle2.size / 3.5f;
-	float distanceBetween = radius1 + radius2;
+void Physics::SetContinuousCollision(bool enabled)
+{
+	m_ContinuousCollision = enabled;
+}
 
-	if (CheckCircleCollision(circle1, circle2))
+void Physics::SetSweepFraction(float fraction)
+{
+	m_SweepFraction = std::max(0.0f, fraction);
+}
+
+void Physics::SweepFastBodies(BodyStore& bodies, const std::vector<float>& startX, const std::vector<float>& startY)
+{
+	if (!m_ContinuousCollision)
 	{
-		if (dist < 0.0001f)
-		{
-			dx = 0.01f;
-			dy = 0.01f;
-			dist = sqrt(pow(dx, 2) + pow(dy, 2));
-		}
+		return;
+	}
 
-		float normalizedX = dx / dist;
-		float normalizedY = dy / dist;
+	// Each body only changes itself, so bodies can be split across threads
+	m_Jobs->ParallelFor(static_cast<uint32_t>(bodies.Size()), BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<uint32_t> nearbyWalls;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				if (bodies.noMovement[i] || bodies.asleep[i] || bodies.sensor[i])
+				{
+					continue;
+				}
 
-		float overlap = distanceBetween - dist;
+				// Slow bodies can't get through anything the discrete tests would miss
+				float movedX = bodies.x[i] - startX[i];
+				float movedY = bodies.y[i] - startY[i];
+				float halfWidth = bodies.halfWidth[i];
+				float halfHeight = bodies.halfHeight[i];
+				float size = std::min(halfWidth * m_AspectRatio, halfHeight);
+				float distanceSquared = movedX * movedX * m_AspectRatio * m_AspectRatio + movedY * movedY;
+				if (distanceSquared <= (m_SweepFraction * size) * (m_SweepFraction * size))
+				{
+					continue;
+				}
 
-		circle1.x -= normalizedX * overlap * 0.5;
-		circle1.y -= normalizedY * overlap * 0.5;
+				float timeOfImpact;
+				float normalX;
+				float normalY;
+				if (!SweepStatic(startX[i], startY[i], bodies.x[i], bodies.y[i], halfWidth, halfHeight, nearbyWalls,
+					timeOfImpact, normalX, normalY))
+				{
+					continue;
+				}
 
-		circle2.x += normalizedX * overlap * 0.5;
-		circle2.y += normalizedY * overlap * 0.5;
+				// Stop just short of the surface, the rest of the move is lost, and bounce off it
+				// like the discrete contact would have. Landing exactly on it could round to just
+				// inside, and the next sweep would let the body through
+				bodies.x[i] = startX[i] + movedX * timeOfImpact + normalX * SweepSkin;
+				bodies.y[i] = startY[i] + movedY * timeOfImpact + normalY * SweepSkin;
 
-		float relativeVelocityX = circle2.xVcty - circle1.xVcty;
-		float relativeVelocityY = circle2.yVcty - circle1.yVcty;
+				float normalVelocity = bodies.xVcty[i] * normalX + bodies.yVcty[i] * normalY;
+				if (normalVelocity < 0.0f)
+				{
+					bodies.xVcty[i] -= (1.0f + m_BounceLevel) * normalVelocity * normalX;
+					bodies.yVcty[i] -= (1.0f + m_BounceLevel) * normalVelocity * normalY;
+				}
+			}
+		});
+}
 
-		float velocityAlongNormal = (relativeVelocityX * normalizedX) + (relativeVelocityY * normalizedY);
+bool Physics::SweepStatic(float startX, float startY, float endX, float endY, float halfWidth, float halfHeight,
+	std::vector<uint32_t>& nearbyWalls, float& timeOfImpact, float& normalX, float& normalY) const
+{
+	// The ground and walls are boxes, so the moving box is a point moving through each one grown by
+	// its half size. The point enters the grown box at the latest of the times it enters each axis
+	float moves[2] = { endX - startX, endY - startY };
+	bool hit = false;
+	timeOfImpact = 1.0f;
 
-		if (velocityAlongNormal > 0)
+	auto sweepBox = [&](float centerX, float centerY, float boxHalfWidth, float boxHalfHeight)
 		{
-			return;
-		}
+			float starts[2] = { startX - centerX, startY - centerY };
+			float grows[2] = { boxHalfWidth + halfWidth, boxHalfHeight + halfHeight };
+
+			// Already inside, the discrete contact handles it
+			if (std::abs(starts[0]) < grows[0] && std::abs(starts[1]) < grows[1])
+			{
+				return;
+			}
+
+			// Starting outside, the box is entered at enter >= 0 if at all
+			float enter = -std::numeric_limits<float>::max();
+			float exit = std::numeric_limits<float>::max();
+			int enterAxis = 0;
+			for (int axis = 0; axis < 2; axis++)
+			{
+				if (moves[axis] == 0.0f)
+				{
+					if (std::abs(starts[axis]) >= grows[axis])
+					{
+						return;
+					}
+					continue;
+				}
+
+				float nearTime = (-std::copysign(grows[axis], moves[axis]) - starts[axis]) / moves[axis];
+				float farTime = (std::copysign(grows[axis], moves[axis]) - starts[axis]) / moves[axis];
+				if (nearTime > enter)
+				{
+					enter = nearTime;
+					enterAxis = axis;
+				}
+				exit = std::min(exit, farTime);
+			}
+
+			if (enter <= exit && enter >= 0.0f && enter < timeOfImpact)
+			{
+				timeOfImpact = enter;
+				normalX = (enterAxis == 0) ? -std::copysign(1.0f, moves[0]) : 0.0f;
+				normalY = (enterAxis == 1) ? -std::copysign(1.0f, moves[1]) : 0.0f;
+				hit = true;
+			}
+		};
 
-		float impulse = -(1 + m_Restitution) * velocityAlongNormal;
+	sweepBox(0.0f, m_GroundPosition, m_GroundWidth / 2 / m_AspectRatio, m_GroundHeight / 2);
 
-		impulse /= (1 / circle1.size) + (1 / circle2.size);
+	// Only walls the whole move could touch
+	AABB sweptBounds = { std::min(startX, endX) - halfWidth, std::min(startY, endY) - halfHeight,
+		std::max(startX, endX) + halfWidth, std::max(startY, endY) + halfHeight };
+	m_StaticGeometry.Query(sweptBounds, nearbyWalls);
+	for (uint32_t wallIndex : nearbyWalls)
+	{
+		const Wall& wall = m_StaticGeometry.GetWall(wallIndex);
+		sweepBox(wall.xPosition, wall.yPosition, (wall.width / 2.0f) / m_AspectRatio, wall.height / 2.0f);
+	}
 
-		float impulseX = impulse * normalizedX;
-		float impulseY = impulse * normalizedY;
+	return hit;
+}
 
-		circle1.xVcty -= impulseX;
-		circle1.yVcty -= impulseY;
+void Physics::SetSleepEnabled(bool enabled)
+{
+	m_SleepEnabled = enabled;
+	if (!enabled)
+	{
+		m_WakeAll = true;
+	}
+}
 
-		circle2.xVcty += impulseX;
-		circle2.yVcty += impulseY;
+void Physics::WakeBody(BodyStore& bodies, uint32_t index)
+{
+	if (bodies.asleep[index])
+	{
+		WakeIsland(bodies, bodies.island[index]);
 	}
+	bodies.sleepTime[index] = 0.0f;
+	bodies.restX[index] = bodies.x[index];
+	bodies.restY[index] = bodies.y[index];
+}
+
+void Physics::ApplyImpulse(BodyStore& bodies, uint32_t index, float impulseX, float impulseY)
+{
+	bodies.xVcty[index] += impulseX * bodies.invMass[index];
+	bodies.yVcty[index] += impulseY * bodies.invMass[index];
+	WakeBody(bodies, index);
 }
 
-void Physics::ApplySquareCollision(Shape& square1, Shape& square2)
+void Physics::SetSensor(BodyStore& bodies, uint32_t index, bool sensor)
 {
-	if (CheckSquareCollision(square1, square2))
+	bodies.sensor[index] = sensor ? 1 : 0;
+	WakeBody(bodies, index);
+}
+
+void Physics::SetGridFluidEnabled(bool enabled)
+{
+	m_GridFluidEnabled = enabled;
+
+	// A scene that never uses the wind never pays for the grid
+	if (enabled && m_GridFluid.GetCellsX() == 0)
 	{
-		float dx = square2.x - square1.x;
-		float dy = square2.y - square1.y;
+		m_GridFluid.SetResolution(GridFluidCellsX, GridFluidCellsY);
+		m_GridObstaclesDirty = true;
+	}
+}
 
-		float overlapX = (square1.size) / m_AspectRatio - abs(dx);
-		float overlapY = square1.size - abs(dy);
+void Physics::SetGridFluidDrag(float drag)
+{
+	m_GridFluidDrag = drag;
+}
 
-		bool directionX = (dx > 0);
-		bool directionY = (dy > 0);
+void Physics::ApplyGridFluid(BodyStore& bodies, float dt)
+{
+	// Waking touches whole islands, so this stays on one thread; it's one sample per body
+	float pull = std::min(m_GridFluidDrag * dt, 1.0f);
+	for (uint32_t i = 0; i < bodies.Size(); i++)
+	{
+		// Sensors only report overlaps, the wind doesn't carry them or wake them
+		if (bodies.noMovement[i] || bodies.sensor[i])
+		{
+			continue;
+		}
 
-		if (overlapX < overlapY)
+		float fluidX, fluidY;
+		m_GridFluid.SampleVelocity(bodies.x[i], bodies.y[i], fluidX, fluidY);
+		float differenceX = fluidX - bodies.xVcty[i];
+		float differenceY = fluidY - bodies.yVcty[i];
+		if (bodies.asleep[i])
 		{
-			if (directionX)
+			// A body is only woken by wind that would move it more than it moves while resting
+			float metricX = differenceX * m_AspectRatio;
+			if (metricX * metricX + differenceY * differenceY <= m_SleepVelocity * m_SleepVelocity)
 			{
-				square1.x -= 1.0 * overlapX * 0.5f;
-				square2.x += 1.0 * overlapX * 0.5f;
-			}
-			else
-			{
-				square1.x -= -1.0 * overlapX * 0.5f;
-				square2.x += -1.0 * overlapX * 0.5f;
+				continue;
 			}
+			WakeBody(bodies, i);
+		}
+		bodies.xVcty[i] += differenceX * pull;
+		bodies.yVcty[i] += differenceY * pull;
+	}
+}
 
-			float relativeVelocityX = square2.xVcty - square1.xVcty;
-			float impulse = -(1 + m_Restitution) * relativeVelocityX;
-			impulse /= (1 / square1.size) + (1 / square2.size);
+void Physics::SetCollisionFilter(BodyStore& bodies, uint32_t index, const CollisionFilter& filter)
+{
+	bodies.SetFilter(index, filter);
+	WakeBody(bodies, index);
+}
 
-			square1.xVcty -= impulse;
-			square2.xVcty += impulse;
+void Physics::UpdateSleep(BodyStore& bodies, float dt)
+{
+	if (!m_SleepEnabled)
+	{
+		return;
+	}
+
+	uint32_t count = static_cast<uint32_t>(bodies.Size());
+	float restDistance = m_SleepVelocity * m_TimeToSleep;
+	float restDistanceSquared = restDistance * restDistance;
+
+	// The velocity that matters is the average over the sleep window. Bodies resting in a pile
+	// keep a downward velocity that the overlap correction cancels every step, so their
+	// velocity never drops; instead a body counts as resting while it stays within
+	// m_SleepVelocity * m_TimeToSleep of where its timer started
+	m_AwakeBodies.clear();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (bodies.noMovement[i] || bodies.asleep[i])
+		{
+			continue;
+		}
+
+		float dx = (bodies.x[i] - bodies.restX[i]) * m_AspectRatio;
+		float dy = bodies.y[i] - bodies.restY[i];
+		if (dx * dx + dy * dy > restDistanceSquared)
+		{
+			bodies.sleepTime[i] = 0.0f;
+			bodies.restX[i] = bodies.x[i];
+			bodies.restY[i] = bodies.y[i];
 		}
 		else
 		{
-			if (directionY)
+			bodies.sleepTime[i] += dt;
+		}
+		m_AwakeBodies.push_back(i);
+	}
+
+	// Islands are built from this step's contacts between moving bodies. Ground and walls
+	// never link anything, otherwise everything on the ground would be one island
+	m_Islands.Reset(count);
+	for (const BodyPair& contact : m_Contacts)
+	{
+		if (!bodies.noMovement[contact.a] && !bodies.noMovement[contact.b])
+		{
+			m_Islands.Link(contact.a, contact.b);
+		}
+	}
+	m_Islands.Build(m_AwakeBodies);
+
+	for (uint32_t island = 0; island < m_Islands.IslandCount(); island++)
+	{
+		const uint32_t* begin = m_Islands.IslandBegin(island);
+		const uint32_t* end = m_Islands.IslandEnd(island);
+
+		// The island sleeps when even its most recently moving body has rested long enough
+		bool resting = true;
+		for (const uint32_t* body = begin; body != end && resting; body++)
+		{
+			resting = bodies.sleepTime[*body] >= m_TimeToSleep;
+		}
+
+		if (!resting)
+		{
+			continue;
+		}
+
+		uint32_t sleepingIsland;
+		if (!m_FreeSleepingIslands.empty())
+		{
+			sleepingIsland = m_FreeSleepingIslands.back();
+			m_FreeSleepingIslands.pop_back();
+		}
+		else
+		{
+			sleepingIsland = static_cast<uint32_t>(m_SleepingIslands.size());
+			m_SleepingIslands.emplace_back();
+		}
+
+		m_SleepingIslands[sleepingIsland].clear();
+		for (const uint32_t* body = begin; body != end; body++)
+		{
+			m_SleepingIslands[sleepingIsland].push_back(bodies.HandleAt(*body));
+			bodies.asleep[*body] = 1;
+			bodies.island[*body] = sleepingIsland;
+			bodies.xVcty[*body] = 0.0f;
+			bodies.yVcty[*body] = 0.0f;
+
+			// Sensors stay proxies, nothing in the tree could find them otherwise
+			bool collides = bodies.type[*body] == ShapeType::Circle || bodies.type[*body] == ShapeType::Square;
+			if (!collides || bodies.sensor[*body])
 			{
-				square1.y -= 1.0 * overlapY * 0.5f;
-				square2.y += 1.0 * overlapY * 0.5f;
+				continue;
 			}
-			else
+
+			uint32_t slot = bodies.slot[*body];
+			if (slot >= m_SleepingBounds.size())
 			{
-				square1.y -= -1.0 * overlapY * 0.5f;
-				square2.y += -1.0 * overlapY * 0.5f;
+				m_SleepingBounds.resize(slot + 1);
+				m_SleepingHandles.resize(slot + 1);
 			}
+			m_SleepingBounds[slot] = ComputeBounds(bodies, *body);
+			m_SleepingHandles[slot] = bodies.HandleAt(*body);
+			m_SleepingTree.InsertProxy(slot);
+		}
+		m_ProxiesChanged = true;
+	}
+}
 
-			float relativeVelocityY = square2.yVcty - square1.yVcty;
-			float impulse = -(1 + m_Restitution) * relativeVelocityY;
-			impulse /= (1 / square1.size) + (1 / square2.size);
+void Physics::WakeIsland(BodyStore& bodies, uint32_t island)
+{
+	for (BodyHandle handle : m_SleepingIslands[island])
+	{
+		// The body may have been removed while its island slept
+		uint32_t body = bodies.IndexOf(handle);
+		if (body == BodyStore::InvalidIndex)
+		{
+			continue;
+		}
+
+		bodies.asleep[body] = 0;
+		bodies.sleepTime[body] = 0.0f;
+		bodies.restX[body] = bodies.x[body];
+		bodies.restY[body] = bodies.y[body];
+	}
+
+	// Removed bodies too, their leaves go with the rest
+	m_WokenBodies.insert(m_WokenBodies.end(), m_SleepingIslands[island].begin(), m_SleepingIslands[island].end());
+	m_SleepingIslands[island].clear();
+	m_FreeSleepingIslands.push_back(island);
+	m_ProxiesChanged = true;
+}
+
+void Physics::RemoveWokenBodies(BodyStore& bodies, bool findContacts)
+{
+	// Each body leaves the tree before it queries it, so every pair is tested once. Islands
+	// woken by these tests add to m_WokenBodies and are handled in the same loop
+	std::vector<uint32_t> slots;
+	for (size_t i = 0; i < m_WokenBodies.size(); i++)
+	{
+		// The slot may have been reused by a body that fell asleep since
+		BodyHandle handle = m_WokenBodies[i];
+		if (handle.slot >= m_SleepingHandles.size() || m_SleepingHandles[handle.slot].generation != handle.generation ||
+			!m_SleepingTree.RemoveProxy(handle.slot))
+		{
+			continue;
+		}
+
+		uint32_t body = bodies.IndexOf(handle);
+		if (!findContacts || body == BodyStore::InvalidIndex)
+		{
+			continue;
+		}
 
-			square1.yVcty -= impulse;
-			square2.yVcty += impulse;
+		m_SleepingTree.QueryAABB(m_SleepingBounds[handle.slot], slots);
+		for (uint32_t slot : slots)
+		{
+			uint32_t other = bodies.IndexOf(m_SleepingHandles[slot]);
+			if (other != BodyStore::InvalidIndex && CanCollide(bodies.filter[body], bodies.filter[other]))
+			{
+				FindPairContact(bodies, body, other);
+			}
 		}
 	}
+	m_WokenBodies.clear();
 }
 
-void Physics::ApplyCircleSquareCollision(Shape& circle, Shape& square)
+bool Physics::WakeTouching(BodyStore& bodies, uint32_t first, uint32_t second)
 {
+	// Something awake ran into a sleeping island, the whole island has to react
+	bool woke = false;
+	if (bodies.asleep[first])
+	{
+		WakeIsland(bodies, bodies.island[first]);
+		woke = true;
+	}
+
+	if (bodies.asleep[second])
+	{
+		WakeIsland(bodies, bodies.island[second]);
+		woke = true;
+	}
 
+	return woke;
 }
 
-void Physics::ApplyGroundCollision(Shape& shape)
+void Physics::SetThreadCount(unsigned int threadCount)
 {
-	float topOfGround = m_GroundPosition + (m_GroundHeight / 2);
-	float groundLeftBoundary = 0.0 - (m_GroundWidth / 2 / m_AspectRatio);
-	float groundRightBoundary = 0.0 + (m_GroundWidth / 2 / m_AspectRatio);
+	delete m_Jobs;
+	m_Jobs = new JobSystem(threadCount);
+}
+
+void Physics::SetSolverIterations(int velocityIterations, int positionIterations)
+{
+	m_Solver.SetIterations(velocityIterations, positionIterations);
+}
+
+void Physics::SetWarmStarting(bool enabled)
+{
+	m_Solver.SetWarmStarting(enabled);
+}
+
+void Physics::SetFriction(float friction)
+{
+	m_Solver.SetFriction(friction);
+}
+
+void Physics::SetSolverType(SolverType type)
+{
+	m_SolverType = type;
+}
 
-	float halfHeight, halfWidth;
-	if (shape.shape == ShapeType::Circle)
+void Physics::SetSubsteps(int substeps)
+{
+	m_Substeps = std::max(1, substeps);
+}
+
+void Physics::SetBroadPhase(BroadPhaseType type)
+{
+	m_AutoTuneBroadPhase = false;
+	UseBroadPhase({ type, m_GridCellSize });
+}
+
+void Physics::SetGridCellSize(float cellSize)
+{
+	m_AutoTuneBroadPhase = false;
+	UseBroadPhase({ m_BroadPhaseType, cellSize });
+}
+
+void Physics::SetBroadPhaseAutoTune(bool enabled)
+{
+	m_AutoTuneBroadPhase = enabled;
+	if (enabled)
 	{
-		halfHeight = shape.size / 3.5f;
-		halfWidth = (shape.size / 3.5f) / m_AspectRatio;
+		m_BroadPhaseTuner.Reset({ m_BroadPhaseType, m_GridCellSize });
 	}
-	else if (shape.shape == ShapeType::Square)
+}
+
+void Physics::UseBroadPhase(const BroadPhaseConfig& config)
+{
+	if (config.type != m_BroadPhaseType)
 	{
-		halfHeight = shape.size / 2.0f;
-		halfWidth = (shape.size / 2.0f) / m_AspectRatio;
+		delete m_BroadPhase;
+		m_BroadPhase = CreateBroadPhase(config.type);
+		m_BroadPhaseType = config.type;
 	}
-	else
+
+	// A new grid starts out sizing cells by the largest body, so the size is set every time
+	m_GridCellSize = config.cellSize;
+	if (m_BroadPhaseType == BroadPhaseType::UniformGrid)
 	{
-		halfHeight = shape.size / 2.0f;
-		halfWidth = (shape.size / 2.0f) / m_AspectRatio;
+		static_cast<UniformGrid*>(m_BroadPhase)->SetCellSize(m_GridCellSize);
 	}
+}
 
-	float bottomOfShape = shape.y - halfHeight;
-	float leftOfShape = shape.x - halfWidth;
-	float rightOfShape = shape.x + halfWidth;
+void Physics::AddPairContact(BodyStore& bodies, const PairContact& contact)
+{
+	// normal and overlap come from the narrowphase kernel, already in aspect corrected space
+	m_Solver.AddContact(ContactSolver::MakeContact(bodies, contact.a, contact.b, contact.normalX, contact.normalY,
+		contact.overlap, m_Restitution));
+	m_Contacts.push_back({ contact.a, contact.b });
+}
 
-	bool isAboveGround = (bottomOfShape <= topOfGround);
+void Physics::FindGroundContact(BodyStore& bodies, uint32_t index, std::vector<ContactConstraint>& contacts)
+{
+	float topOfGround = m_GroundPosition + (m_GroundHeight / 2);
+	float groundLeftBoundary = 0.0f - (m_GroundWidth / 2 / m_AspectRatio);
+	float groundRightBoundary = 0.0f + (m_GroundWidth / 2 / m_AspectRatio);
+
+	float halfHeight = bodies.halfHeight[index];
+	float halfWidth = bodies.halfWidth[index];
+
+	float bottomOfShape = bodies.y[index] - halfHeight;
+	float leftOfShape = bodies.x[index] - halfWidth;
+	float rightOfShape = bodies.x[index] + halfWidth;
+
+	bool isAboveGround = (bottomOfShape - m_ContactMargin <= topOfGround);
 	bool isWithinGroundWidth = (rightOfShape > groundLeftBoundary && leftOfShape < groundRightBoundary);
 
 	if (isAboveGround && isWithinGroundWidth)
 	{
-		shape.y = topOfGround + halfHeight;
-
-		if (shape.yVcty < 0.0f)
-		{
-			shape.yVcty = -shape.yVcty * m_BounceLevel;
-
-			if (abs(shape.yVcty) < 0.0001f)
-			{
-				shape.yVcty = 0.0f;
-			}
-		}
+		// The ground is below, so the normal from the body points down. Feature 0 is the ground
+		contacts.push_back(ContactSolver::MakeStaticContact(bodies, index, 0, 0.0f, -1.0f,
+			topOfGround - bottomOfShape, m_BounceLevel));
 	}
 }
 
 void Physics::AddWall(float xPosition, float yPosition, float width, float height)
 {
-	m_Walls.push_back({xPosition, yPosition, width, height});
+	m_StaticGeometry.Add({ xPosition, yPosition, width, height });
+	m_GridObstaclesDirty = true;
+}
+
+void Physics::SnapshotQueries(const BodyStore& bodies)
+{
+	m_StaticGeometry.Build();
+	m_QuerySnapshot.Build(bodies, m_StaticGeometry, GetGroundBox());
+}
+
+AABB Physics::GetGroundBox() const
+{
+	float groundHalfWidth = m_GroundWidth / 2 / m_AspectRatio;
+	return { -groundHalfWidth, m_GroundPosition - m_GroundHeight / 2,
+		groundHalfWidth, m_GroundPosition + m_GroundHeight / 2 };
+}
+
+bool Physics::RayCast(float startX, float startY, float endX, float endY, CastHit& hit) const
+{
+	return m_QuerySnapshot.Cast({ startX, startY, endX, endY, 0.0f }, hit);
+}
+
+bool Physics::ShapeCast(const CastQuery& query, CastHit& hit) const
+{
+	return m_QuerySnapshot.Cast(query, hit);
+}
+
+void Physics::QueryOverlap(const AABB& box, std::vector<QueryItem>& items) const
+{
+	m_QuerySnapshot.Overlap(box, items);
+}
+
+void Physics::QueryContaining(float x, float y, std::vector<QueryItem>& items) const
+{
+	m_QuerySnapshot.Contains({ x, y }, items);
+}
+
+void Physics::CastBatch(const std::vector<CastQuery>& queries, std::vector<CastHit>& hits) const
+{
+	m_QuerySnapshot.CastBatch(queries, hits, *m_Jobs);
+}
+
+void Physics::QueryOverlapBatch(const std::vector<AABB>& boxes, QueryResults& results) const
+{
+	m_QuerySnapshot.OverlapBatch(boxes, results, *m_Jobs);
+}
+
+void Physics::QueryContainingBatch(const std::vector<QueryPoint>& points, QueryResults& results) const
+{
+	m_QuerySnapshot.ContainsBatch(points, results, *m_Jobs);
 }
 
 void Physics::ClearWalls()
 {
-	m_Walls.clear();
+	m_StaticGeometry.Clear();
+	m_GridObstaclesDirty = true;
+	m_WakeAll = true;
 }
 
-void Physics::ApplyWallCollision(Shape& shape)
+void Physics::FindWallContacts(BodyStore& bodies, uint32_t index, std::vector<uint32_t>& nearbyWalls,
+	std::vector<ContactConstraint>& contacts)
 {
-	float shapeHalfWidth;
-	float shapeHalfHeight;
+	// Grown by the margin, which comes back off the overlaps
+	float shapeHalfWidth = bodies.halfWidth[index] + m_ContactMargin / m_AspectRatio;
+	float shapeHalfHeight = bodies.halfHeight[index] + m_ContactMargin;
 
-	if (shape.shape == ShapeType::Circle)
-	{
-		shapeHalfWidth = (shape.size / 3.5f) / m_AspectRatio;
-		shapeHalfHeight = (shape.size / 3.5f);
-	}
-	else if (shape.shape == ShapeType::Square)
-	{
-		shapeHalfWidth = (shape.size / 2.0f) / m_AspectRatio;
-		shapeHalfHeight = (shape.size / 2.0f);
-	}
-	else
-	{
-		shapeHalfWidth = (shape.size / 2.0f) / m_AspectRatio;
-		shapeHalfHeight = (shape.size / 2.0f);
-	}
+	float x = bodies.x[index];
+	float y = bodies.y[index];
 
-	float leftOfShape = shape.x - shapeHalfWidth;
-	float rightOfShape = shape.x + shapeHalfWidth;
-	float topOfShape = shape.y + shapeHalfHeight;
-	float bottomOfShape = shape.y - shapeHalfHeight;
+	float leftOfShape = x - shapeHalfWidth;
+	float rightOfShape = x + shapeHalfWidth;
+	float topOfShape = y + shapeHalfHeight;
+	float bottomOfShape = y - shapeHalfHeight;
 
-	for (const auto& wall : m_Walls)
+	// Only the walls near the body are tested, found through the static tree
+	m_StaticGeometry.Query({ leftOfShape, bottomOfShape, rightOfShape, topOfShape }, nearbyWalls);
+	for (uint32_t wallIndex : nearbyWalls)
 	{
-		float wallHalfWidth = (wall.width / 2.0f) / m_AspectRatio;
-		float wallHalfHeight = (wall.height / 2.0f);
-		float wallLeftEdge = wall.xPosition - wallHalfWidth;
-		float wallRightEdge = wall.xPosition + wallHalfWidth;
-		float wallTopEdge = wall.yPosition + wallHalfHeight;
-		float wallBottomEdge = wall.yPosition - wallHalfHeight;
+		const AABB& wallBounds = m_StaticGeometry.GetBounds(wallIndex);
+		float wallLeftEdge = wallBounds.minX;
+		float wallRightEdge = wallBounds.maxX;
+		float wallTopEdge = wallBounds.maxY;
+		float wallBottomEdge = wallBounds.minY;
 
 		bool horizontalOverlap = (topOfShape > wallBottomEdge && bottomOfShape < wallTopEdge);
 		bool verticalOverlap = (rightOfShape > wallLeftEdge && leftOfShape < wallRightEdge);
 
-		// sideCollision is number from 0 - 3. 0 being bottom wall and going clockwise for rest
-		int sideCollision = 0;
-
 		if (horizontalOverlap && verticalOverlap)
 		{
-			float overlapLeft = rightOfShape - wallLeftEdge;
-			float overlapRight = wallRightEdge - leftOfShape;
+			// Side overlaps in aspect corrected space, so they compare fairly with the top and bottom
+			float overlapLeft = (rightOfShape - wallLeftEdge) * m_AspectRatio;
+			float overlapRight = (wallRightEdge - leftOfShape) * m_AspectRatio;
 			float overlapTop = wallTopEdge - bottomOfShape;
 			float overlapBottom = topOfShape - wallBottomEdge;
 
+			// Push out through the side with the least overlap, the normal points from the body into the wall
 			float minOverlap = overlapLeft;
+			float normalX = 1.0f;
+			float normalY = 0.0f;
 
 			if (overlapRight < minOverlap)
 			{
 				minOverlap = overlapRight;
-				sideCollision = 1;
+				normalX = -1.0f;
+				normalY = 0.0f;
 			}
 			if (overlapTop < minOverlap)
 			{
 				minOverlap = overlapTop;
-				sideCollision = 2;
+				normalX = 0.0f;
+				normalY = -1.0f;
 			}
 			if (overlapBottom < minOverlap)
 			{
 				minOverlap = overlapBottom;
-				sideCollision = 3;
+				normalX = 0.0f;
+				normalY = 1.0f;
 			}
 
-			switch (sideCollision) {
-			case 0:
-				shape.x = wallLeftEdge - shapeHalfWidth;
-				if (shape.xVcty > 0.0f)
-				{
-					shape.xVcty = -shape.xVcty * m_BounceLevel;
-					if (abs(shape.xVcty) < m_VelocityThreshold)
-					{
-						shape.xVcty = 0.0f;
-					}
-				}
-				break;
-
-			case 1:
-				shape.x = wallRightEdge + shapeHalfWidth;
-				if (shape.xVcty < 0.0f)
-				{
-					shape.xVcty = -shape.xVcty * m_BounceLevel;
-					if (abs(shape.xVcty) < m_VelocityThreshold)
-					{
-						shape.xVcty = 0.0f;
-					}
-				}
-				break;
-
-			case 2:
-				shape.y = wallTopEdge + shapeHalfHeight;
-				if (shape.yVcty < 0.0f)
-				{
-					shape.yVcty = -shape.yVcty * m_BounceLevel;
-					if (abs(shape.yVcty) < m_VelocityThreshold)
-					{
-						shape.yVcty = 0.0f;
-					}
-				}
-				break;
-
-			case 3:
-				shape.y = wallBottomEdge - shapeHalfHeight;
-				if (shape.yVcty > 0.0f)
-				{
-					shape.yVcty = -shape.yVcty * m_BounceLevel;
-					if (abs(shape.yVcty) < m_VelocityThreshold)
-					{
-						shape.yVcty = 0.0f;
-					}
-				}
-				break;
-
-			default:
-				break;
-			}
-		}	
+			// Features after the ground are the walls
+			contacts.push_back(ContactSolver::MakeStaticContact(bodies, index, wallIndex + 1, normalX, normalY,
+				minOverlap - m_ContactMargin, m_BounceLevel));
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "Physics/Sensors.h"
+#include <algorithm>
+
+namespace
+{
+	// Slot first so the order doesn't change as bodies move around in the store
+	bool Less(const BodyHandle& first, const BodyHandle& second)
+	{
+		return (first.slot != second.slot) ? (first.slot < second.slot) : (first.generation < second.generation);
+	}
+
+	bool Less(const SensorOverlap& first, const SensorOverlap& second)
+	{
+		if (Less(first.sensor, second.sensor))
+		{
+			return true;
+		}
+		if (Less(second.sensor, first.sensor))
+		{
+			return false;
+		}
+		return Less(first.visitor, second.visitor);
+	}
+}
+
+void Sensors::BeginStep()
+{
+	m_Overlaps.swap(m_PreviousOverlaps);
+	m_Overlaps.clear();
+}
+
+void Sensors::EndStep()
+{
+	std::sort(m_Overlaps.begin(), m_Overlaps.end(), [](const SensorOverlap& first, const SensorOverlap& second)
+		{
+			return Less(first, second);
+		});
+
+	m_Events.clear();
+	size_t current = 0;
+	size_t previous = 0;
+	while (current < m_Overlaps.size() || previous < m_PreviousOverlaps.size())
+	{
+		if (previous == m_PreviousOverlaps.size() ||
+			(current < m_Overlaps.size() && Less(m_Overlaps[current], m_PreviousOverlaps[previous])))
+		{
+			const SensorOverlap& overlap = m_Overlaps[current++];
+			m_Events.push_back({ SensorEventType::Begin, overlap.sensor, overlap.visitor });
+		}
+		else if (current == m_Overlaps.size() || Less(m_PreviousOverlaps[previous], m_Overlaps[current]))
+		{
+			const SensorOverlap& overlap = m_PreviousOverlaps[previous++];
+			m_Events.push_back({ SensorEventType::End, overlap.sensor, overlap.visitor });
+		}
+		else
+		{
+			// Still overlapping
+			current++;
+			previous++;
+		}
+	}
+}
+
+void Sensors::Clear()
+{
+	m_Overlaps.clear();
+	m_PreviousOverlaps.clear();
+	m_Events.clear();
+}
\ No newline at end of file
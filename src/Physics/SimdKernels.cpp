@@ -0,0 +1,1288 @@
+#include "Physics/SimdKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(PHYSICS_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(PHYSICS_SIMD_SSE)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Circles closer than this are treated as sitting on top of each other and pushed apart
+	// along a fixed direction, same as the original ApplyCircleCollision
+	const float MinDistanceSquared = 0.0001f * 0.0001f;
+	const float CoincidentOffset = 0.01f;
+	const float CoincidentDistanceSquared = CoincidentOffset * CoincidentOffset * 2.0f;
+	// Stand in distance for fluid particles on exactly the same spot, aspect corrected
+	const float FluidCoincidentOffset = 1e-6f;
+}
+
+void ContactColumns::Resize(size_t count)
+{
+	a.resize(count);
+	b.resize(count);
+	normalX.resize(count);
+	normalY.resize(count);
+	invMassA.resize(count);
+	invMassB.resize(count);
+	mass.resize(count);
+	friction.resize(count);
+	normalImpulse.resize(count);
+	tangentImpulse.resize(count);
+}
+
+void ScalarSolveContactVelocities(ContactColumns& contacts, size_t begin, size_t end, float* xVcty, float* yVcty,
+	float aspectRatio)
+{
+	float inverseAspect = 1.0f / aspectRatio;
+	for (size_t i = begin; i < end; i++)
+	{
+		uint32_t a = contacts.a[i];
+		uint32_t b = contacts.b[i];
+		bool staticB = (b == ContactColumns::StaticContactBody);
+
+		float velocityAX = xVcty[a];
+		float velocityAY = yVcty[a];
+		float velocityBX = staticB ? 0.0f : xVcty[b];
+		float velocityBY = staticB ? 0.0f : yVcty[b];
+
+		float normalX = contacts.normalX[i];
+		float normalY = contacts.normalY[i];
+		float invMassA = contacts.invMassA[i];
+		float invMassB = contacts.invMassB[i];
+		float mass = contacts.mass[i];
+
+		// Friction, the tangent is the normal turned a quarter
+		float tangentX = -normalY;
+		float tangentY = normalX;
+		float tangentVelocity = (velocityBX - velocityAX) * aspectRatio * tangentX + (velocityBY - velocityAY) * tangentY;
+		float maxFriction = contacts.friction[i] * contacts.normalImpulse[i];
+		float oldTangentImpulse = contacts.tangentImpulse[i];
+		float tangentImpulse = std::min(std::max(oldTangentImpulse - mass * tangentVelocity, -maxFriction), maxFriction);
+		contacts.tangentImpulse[i] = tangentImpulse;
+
+		float impulse = tangentImpulse - oldTangentImpulse;
+		float impulseX = tangentX * impulse * inverseAspect;
+		float impulseY = tangentY * impulse;
+		velocityAX -= impulseX * invMassA;
+		velocityAY -= impulseY * invMassA;
+		velocityBX += impulseX * invMassB;
+		velocityBY += impulseY * invMassB;
+
+		// Normal, clamp the total so later iterations can take back some of an earlier push
+		float normalVelocity = (velocityBX - velocityAX) * aspectRatio * normalX + (velocityBY - velocityAY) * normalY;
+		float oldNormalImpulse = contacts.normalImpulse[i];
+		float normalImpulse = std::max(oldNormalImpulse - mass * normalVelocity, 0.0f);
+		contacts.normalImpulse[i] = normalImpulse;
+
+		impulse = normalImpulse - oldNormalImpulse;
+		impulseX = normalX * impulse * inverseAspect;
+		impulseY = normalY * impulse;
+		xVcty[a] = velocityAX - impulseX * invMassA;
+		yVcty[a] = velocityAY - impulseY * invMassA;
+		if (!staticB)
+		{
+			xVcty[b] = velocityBX + impulseX * invMassB;
+			yVcty[b] = velocityBY + impulseY * invMassB;
+		}
+	}
+}
+
+void ScalarIntegrateVelocities(float* yVcty, const uint8_t* noMovement, const uint8_t* asleep, size_t count,
+	float gravity, float dt)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		bool frozen = (noMovement[i] | asleep[i]) != 0;
+		yVcty[i] = yVcty[i] - (frozen ? 0.0f : gravity * dt);
+	}
+}
+
+void ScalarIntegratePositions(float* x, float* y, const float* xVcty, const float* yVcty, const uint8_t* noMovement,
+	const uint8_t* asleep, size_t count, float dt)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		bool frozen = (noMovement[i] | asleep[i]) != 0;
+		float step = frozen ? 0.0f : dt;
+
+		x[i] = x[i] + (xVcty[i] * step);
+		y[i] = y[i] + (yVcty[i] * step);
+	}
+}
+
+bool ScalarCollideCirclePair(const float* x, const float* y, const float* radius, const BodyPair& pair,
+	float aspectRatio, float margin, PairContact& contact)
+{
+	uint32_t a = pair.a;
+	uint32_t b = pair.b;
+
+	float dx = (x[b] - x[a]) * aspectRatio;
+	float dy = y[b] - y[a];
+	float distanceSquared = dx * dx + dy * dy;
+	float distanceBetween = radius[a] + radius[b];
+	float reach = distanceBetween + margin;
+
+	if (distanceSquared >= reach * reach)
+	{
+		return false;
+	}
+
+	if (distanceSquared < MinDistanceSquared)
+	{
+		dx = CoincidentOffset;
+		dy = CoincidentOffset;
+		distanceSquared = CoincidentDistanceSquared;
+	}
+
+	float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+	contact = { a, b, dx * inverseDistance, dy * inverseDistance, distanceBetween - distanceSquared * inverseDistance };
+	return true;
+}
+
+void ScalarCollideCirclePairs(const float* x, const float* y, const float* radius, const BodyPair* pairs,
+	size_t count, float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	PairContact contact;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (ScalarCollideCirclePair(x, y, radius, pairs[i], aspectRatio, margin, contact))
+		{
+			contacts.push_back(contact);
+		}
+	}
+}
+
+void ScalarAccumulateAttraction(float bodyX, float bodyY, const float* x, const float* y, const float* mass,
+	size_t count, float softeningSquared, float& accelerationX, float& accelerationY)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float dx = x[i] - bodyX;
+		float dy = y[i] - bodyY;
+		float distanceSquared = dx * dx + dy * dy;
+		if (distanceSquared == 0.0f)
+		{
+			continue;
+		}
+
+		float inverseDistance = 1.0f / std::sqrt(distanceSquared + softeningSquared);
+		float strength = mass[i] * inverseDistance * inverseDistance * inverseDistance;
+		accelerationX += dx * strength;
+		accelerationY += dy * strength;
+	}
+}
+
+float ScalarSumFluidDensity(const float* x, const float* y, const FluidRuns& runs, float particleX, float particleY,
+	float aspectRatio, float smoothingRadius, uint32_t& neighbours)
+{
+	float density = 0.0f;
+	for (uint32_t run = 0; run < runs.count; run++)
+	{
+		for (uint32_t j = runs.begin[run]; j < runs.end[run]; j++)
+		{
+			float dx = x[j] * aspectRatio - particleX;
+			float dy = y[j] - particleY;
+			float distanceSquared = dx * dx + dy * dy;
+			if (distanceSquared < smoothingRadius * smoothingRadius)
+			{
+				float falloff = smoothingRadius - std::sqrt(distanceSquared);
+				density += falloff * falloff;
+				neighbours++;
+			}
+		}
+	}
+	return density;
+}
+
+void ScalarAccumulateFluidForces(const FluidColumns& particles, uint32_t i, const FluidRuns& runs, float aspectRatio,
+	float smoothingRadius, float& pressureX, float& pressureY, float& viscosityX, float& viscosityY)
+{
+	float particleX = particles.x[i] * aspectRatio;
+	float particleY = particles.y[i];
+	float velocityX = particles.xVcty[i] * aspectRatio;
+	float velocityY = particles.yVcty[i];
+	for (uint32_t run = 0; run < runs.count; run++)
+	{
+		for (uint32_t j = runs.begin[run]; j < runs.end[run]; j++)
+		{
+			float dx = particles.x[j] * aspectRatio - particleX;
+			float dy = particles.y[j] - particleY;
+			float distanceSquared = dx * dx + dy * dy;
+			if (distanceSquared >= smoothingRadius * smoothingRadius || j == i)
+			{
+				continue;
+			}
+			if (distanceSquared == 0.0f)
+			{
+				dx = (j > i) ? FluidCoincidentOffset : -FluidCoincidentOffset;
+				distanceSquared = dx * dx;
+			}
+
+			float distance = std::sqrt(distanceSquared);
+			float falloff = smoothingRadius - distance;
+			float push = (particles.pressureTerm[i] + particles.pressureTerm[j]) * falloff / distance;
+			pressureX -= dx * push;
+			pressureY -= dy * push;
+
+			float drag = falloff * particles.inverseDensity[j];
+			viscosityX += (particles.xVcty[j] * aspectRatio - velocityX) * drag;
+			viscosityY += (particles.yVcty[j] - velocityY) * drag;
+		}
+	}
+}
+
+void ScalarSampleGrid(const float* field, uint32_t width, uint32_t height, const float* sampleX, const float* sampleY,
+	size_t count, float* values)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float x = std::min(std::max(sampleX[i], 0.0f), static_cast<float>(width - 1));
+		float y = std::min(std::max(sampleY[i], 0.0f), static_cast<float>(height - 1));
+		uint32_t cellX = std::min(static_cast<uint32_t>(x), width - 2);
+		uint32_t cellY = std::min(static_cast<uint32_t>(y), height - 2);
+		float fractionX = x - cellX;
+		float fractionY = y - cellY;
+
+		const float* corner = field + cellY * width + cellX;
+		float bottom = corner[0] + (corner[1] - corner[0]) * fractionX;
+		float top = corner[width] + (corner[width + 1] - corner[width]) * fractionX;
+		values[i] = bottom + (top - bottom) * fractionY;
+	}
+}
+
+void ScalarRelaxPressureRow(const PressureRow& row, uint32_t begin, uint32_t end, uint32_t parity)
+{
+	for (uint32_t i = begin + ((begin & 1) != parity ? 1 : 0); i < end; i += 2)
+	{
+		float sum = row.weightX[i] * row.pressure[i - 1] + row.weightX[i + 1] * row.pressure[i + 1] +
+			row.weightBelow[i] * row.below[i] + row.weightAbove[i] * row.above[i];
+		row.pressure[i] = (sum - row.rhs[i]) * row.inverseDiagonal[i];
+	}
+}
+
+#if defined(PHYSICS_SIMD_AVX2)
+
+namespace
+{
+	// Lanes that move get all bits set, frozen lanes get 0
+	__m256 MovingMask(const uint8_t* noMovement, const uint8_t* asleep)
+	{
+		__m128i frozen = _mm_or_si128(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(noMovement)),
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(asleep)));
+		__m256i flags = _mm256_cvtepu8_epi32(frozen);
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(flags, _mm256_setzero_si256()));
+	}
+}
+
+void IntegrateVelocities(float* yVcty, const uint8_t* noMovement, const uint8_t* asleep, size_t count,
+	float gravity, float dt)
+{
+	const __m256 gravityWide = _mm256_set1_ps(gravity * dt);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 gravityStep = _mm256_and_ps(MovingMask(noMovement + i, asleep + i), gravityWide);
+		_mm256_storeu_ps(yVcty + i, _mm256_sub_ps(_mm256_loadu_ps(yVcty + i), gravityStep));
+	}
+
+	ScalarIntegrateVelocities(yVcty + i, noMovement + i, asleep + i, count - i, gravity, dt);
+}
+
+void IntegratePositions(float* x, float* y, const float* xVcty, const float* yVcty, const uint8_t* noMovement,
+	const uint8_t* asleep, size_t count, float dt)
+{
+	const __m256 dtWide = _mm256_set1_ps(dt);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 step = _mm256_and_ps(MovingMask(noMovement + i, asleep + i), dtWide);
+
+		__m256 moveX = _mm256_mul_ps(_mm256_loadu_ps(xVcty + i), step);
+		__m256 moveY = _mm256_mul_ps(_mm256_loadu_ps(yVcty + i), step);
+		_mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), moveX));
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), moveY));
+	}
+
+	ScalarIntegratePositions(x + i, y + i, xVcty + i, yVcty + i, noMovement + i, asleep + i, count - i, dt);
+}
+
+void CollideCirclePairs(const float* x, const float* y, const float* radius, const BodyPair* pairs,
+	size_t count, float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	const __m256 aspect = _mm256_set1_ps(aspectRatio);
+	const __m256 contactMargin = _mm256_set1_ps(margin);
+	const __m256 minDistanceSquared = _mm256_set1_ps(MinDistanceSquared);
+	const __m256 coincidentOffset = _mm256_set1_ps(CoincidentOffset);
+	const __m256 coincidentDistanceSquared = _mm256_set1_ps(CoincidentDistanceSquared);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+	// BodyPair is two uint32s, so a and b of 8 pairs sit at every other int
+	const __m256i pairStride = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+
+	alignas(32) uint32_t laneA[8];
+	alignas(32) uint32_t laneB[8];
+	alignas(32) float laneNormalX[8];
+	alignas(32) float laneNormalY[8];
+	alignas(32) float laneOverlap[8];
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const int* pairData = reinterpret_cast<const int*>(pairs + i);
+		__m256i indexA = _mm256_i32gather_epi32(pairData, pairStride, 4);
+		__m256i indexB = _mm256_i32gather_epi32(pairData + 1, pairStride, 4);
+
+		__m256 dx = _mm256_mul_ps(_mm256_sub_ps(_mm256_i32gather_ps(x, indexB, 4), _mm256_i32gather_ps(x, indexA, 4)), aspect);
+		__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(y, indexB, 4), _mm256_i32gather_ps(y, indexA, 4));
+		__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 distanceBetween = _mm256_add_ps(_mm256_i32gather_ps(radius, indexA, 4), _mm256_i32gather_ps(radius, indexB, 4));
+
+		// Squared distance early-out, most batches near the edge of a pile have no hits
+		__m256 reach = _mm256_add_ps(distanceBetween, contactMargin);
+		__m256 hit = _mm256_cmp_ps(distanceSquared, _mm256_mul_ps(reach, reach), _CMP_LT_OQ);
+		int hitMask = _mm256_movemask_ps(hit);
+		if (hitMask == 0)
+		{
+			continue;
+		}
+
+		__m256 coincident = _mm256_cmp_ps(distanceSquared, minDistanceSquared, _CMP_LT_OQ);
+		dx = _mm256_blendv_ps(dx, coincidentOffset, coincident);
+		dy = _mm256_blendv_ps(dy, coincidentOffset, coincident);
+		distanceSquared = _mm256_blendv_ps(distanceSquared, coincidentDistanceSquared, coincident);
+
+		// rsqrt is only good to ~12 bits, one Newton-Raphson step brings it close to full float precision
+		__m256 inverseDistance = _mm256_rsqrt_ps(distanceSquared);
+		__m256 refine = _mm256_sub_ps(threeHalves,
+			_mm256_mul_ps(_mm256_mul_ps(half, distanceSquared), _mm256_mul_ps(inverseDistance, inverseDistance)));
+		inverseDistance = _mm256_mul_ps(inverseDistance, refine);
+
+		_mm256_store_si256(reinterpret_cast<__m256i*>(laneA), indexA);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(laneB), indexB);
+		_mm256_store_ps(laneNormalX, _mm256_mul_ps(dx, inverseDistance));
+		_mm256_store_ps(laneNormalY, _mm256_mul_ps(dy, inverseDistance));
+		_mm256_store_ps(laneOverlap, _mm256_sub_ps(distanceBetween, _mm256_mul_ps(distanceSquared, inverseDistance)));
+
+		for (int lane = 0; lane < 8; lane++)
+		{
+			if (hitMask & (1 << lane))
+			{
+				contacts.push_back({ laneA[lane], laneB[lane], laneNormalX[lane], laneNormalY[lane], laneOverlap[lane] });
+			}
+		}
+	}
+
+	ScalarCollideCirclePairs(x, y, radius, pairs + i, count - i, aspectRatio, margin, contacts);
+}
+
+void SolveContactVelocities(ContactColumns& contacts, size_t begin, size_t end, float* xVcty, float* yVcty,
+	float aspectRatio)
+{
+	const __m256 aspect = _mm256_set1_ps(aspectRatio);
+	const __m256 inverseAspect = _mm256_set1_ps(1.0f / aspectRatio);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i staticBody = _mm256_set1_epi32(-1);
+
+	alignas(32) float laneAX[8];
+	alignas(32) float laneAY[8];
+	alignas(32) float laneBX[8];
+	alignas(32) float laneBY[8];
+
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256i indexA = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(contacts.a.data() + i));
+		__m256i indexB = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(contacts.b.data() + i));
+
+		// Static lanes gather from a, which is always valid, and then zero what they read
+		__m256i isStatic = _mm256_cmpeq_epi32(indexB, staticBody);
+		__m256 dynamicB = _mm256_castsi256_ps(_mm256_xor_si256(isStatic, staticBody));
+		__m256i safeB = _mm256_blendv_epi8(indexB, indexA, isStatic);
+
+		__m256 velocityAX = _mm256_i32gather_ps(xVcty, indexA, 4);
+		__m256 velocityAY = _mm256_i32gather_ps(yVcty, indexA, 4);
+		__m256 velocityBX = _mm256_and_ps(dynamicB, _mm256_i32gather_ps(xVcty, safeB, 4));
+		__m256 velocityBY = _mm256_and_ps(dynamicB, _mm256_i32gather_ps(yVcty, safeB, 4));
+
+		__m256 normalX = _mm256_loadu_ps(contacts.normalX.data() + i);
+		__m256 normalY = _mm256_loadu_ps(contacts.normalY.data() + i);
+		__m256 invMassA = _mm256_loadu_ps(contacts.invMassA.data() + i);
+		__m256 invMassB = _mm256_loadu_ps(contacts.invMassB.data() + i);
+		__m256 mass = _mm256_loadu_ps(contacts.mass.data() + i);
+
+		// Friction
+		__m256 tangentX = _mm256_sub_ps(zero, normalY);
+		__m256 tangentY = normalX;
+		__m256 relativeX = _mm256_mul_ps(_mm256_sub_ps(velocityBX, velocityAX), aspect);
+		__m256 relativeY = _mm256_sub_ps(velocityBY, velocityAY);
+		__m256 tangentVelocity = _mm256_add_ps(_mm256_mul_ps(relativeX, tangentX), _mm256_mul_ps(relativeY, tangentY));
+
+		__m256 maxFriction = _mm256_mul_ps(_mm256_loadu_ps(contacts.friction.data() + i),
+			_mm256_loadu_ps(contacts.normalImpulse.data() + i));
+		__m256 oldTangentImpulse = _mm256_loadu_ps(contacts.tangentImpulse.data() + i);
+		__m256 tangentImpulse = _mm256_sub_ps(oldTangentImpulse, _mm256_mul_ps(mass, tangentVelocity));
+		tangentImpulse = _mm256_min_ps(_mm256_max_ps(tangentImpulse, _mm256_sub_ps(zero, maxFriction)), maxFriction);
+		_mm256_storeu_ps(contacts.tangentImpulse.data() + i, tangentImpulse);
+
+		__m256 impulse = _mm256_sub_ps(tangentImpulse, oldTangentImpulse);
+		__m256 impulseX = _mm256_mul_ps(_mm256_mul_ps(tangentX, impulse), inverseAspect);
+		__m256 impulseY = _mm256_mul_ps(tangentY, impulse);
+		velocityAX = _mm256_sub_ps(velocityAX, _mm256_mul_ps(impulseX, invMassA));
+		velocityAY = _mm256_sub_ps(velocityAY, _mm256_mul_ps(impulseY, invMassA));
+		velocityBX = _mm256_add_ps(velocityBX, _mm256_mul_ps(impulseX, invMassB));
+		velocityBY = _mm256_add_ps(velocityBY, _mm256_mul_ps(impulseY, invMassB));
+
+		// Normal
+		relativeX = _mm256_mul_ps(_mm256_sub_ps(velocityBX, velocityAX), aspect);
+		relativeY = _mm256_sub_ps(velocityBY, velocityAY);
+		__m256 normalVelocity = _mm256_add_ps(_mm256_mul_ps(relativeX, normalX), _mm256_mul_ps(relativeY, normalY));
+
+		__m256 oldNormalImpulse = _mm256_loadu_ps(contacts.normalImpulse.data() + i);
+		__m256 normalImpulse = _mm256_max_ps(_mm256_sub_ps(oldNormalImpulse, _mm256_mul_ps(mass, normalVelocity)), zero);
+		_mm256_storeu_ps(contacts.normalImpulse.data() + i, normalImpulse);
+
+		impulse = _mm256_sub_ps(normalImpulse, oldNormalImpulse);
+		impulseX = _mm256_mul_ps(_mm256_mul_ps(normalX, impulse), inverseAspect);
+		impulseY = _mm256_mul_ps(normalY, impulse);
+		_mm256_store_ps(laneAX, _mm256_sub_ps(velocityAX, _mm256_mul_ps(impulseX, invMassA)));
+		_mm256_store_ps(laneAY, _mm256_sub_ps(velocityAY, _mm256_mul_ps(impulseY, invMassA)));
+		_mm256_store_ps(laneBX, _mm256_add_ps(velocityBX, _mm256_mul_ps(impulseX, invMassB)));
+		_mm256_store_ps(laneBY, _mm256_add_ps(velocityBY, _mm256_mul_ps(impulseY, invMassB)));
+
+		// No scatter before AVX-512, the lanes are written back one by one
+		for (int lane = 0; lane < 8; lane++)
+		{
+			uint32_t a = contacts.a[i + lane];
+			uint32_t b = contacts.b[i + lane];
+			xVcty[a] = laneAX[lane];
+			yVcty[a] = laneAY[lane];
+			if (b != ContactColumns::StaticContactBody)
+			{
+				xVcty[b] = laneBX[lane];
+				yVcty[b] = laneBY[lane];
+			}
+		}
+	}
+
+	ScalarSolveContactVelocities(contacts, i, end, xVcty, yVcty, aspectRatio);
+}
+
+void AccumulateAttraction(float bodyX, float bodyY, const float* x, const float* y, const float* mass, size_t count,
+	float softeningSquared, float& accelerationX, float& accelerationY)
+{
+	const __m256 positionX = _mm256_set1_ps(bodyX);
+	const __m256 positionY = _mm256_set1_ps(bodyY);
+	const __m256 softening = _mm256_set1_ps(softeningSquared);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+	__m256 sumX = zero;
+	__m256 sumY = zero;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), positionX);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), positionY);
+		__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+		// Points on top of the body get no mass and a distance of 1, so with no softening the
+		// rsqrt below never sees 0 and the lane stays finite
+		__m256 coincident = _mm256_cmp_ps(distanceSquared, zero, _CMP_EQ_OQ);
+		__m256 softened = _mm256_blendv_ps(_mm256_add_ps(distanceSquared, softening), one, coincident);
+		__m256 pointMass = _mm256_andnot_ps(coincident, _mm256_loadu_ps(mass + i));
+
+		// rsqrt plus one Newton-Raphson step, same as the circle kernel
+		__m256 inverseDistance = _mm256_rsqrt_ps(softened);
+		__m256 refine = _mm256_sub_ps(threeHalves,
+			_mm256_mul_ps(_mm256_mul_ps(half, softened), _mm256_mul_ps(inverseDistance, inverseDistance)));
+		inverseDistance = _mm256_mul_ps(inverseDistance, refine);
+
+		__m256 strength = _mm256_mul_ps(pointMass,
+			_mm256_mul_ps(inverseDistance, _mm256_mul_ps(inverseDistance, inverseDistance)));
+		sumX = _mm256_add_ps(sumX, _mm256_mul_ps(dx, strength));
+		sumY = _mm256_add_ps(sumY, _mm256_mul_ps(dy, strength));
+	}
+
+	alignas(32) float laneX[8];
+	alignas(32) float laneY[8];
+	_mm256_store_ps(laneX, sumX);
+	_mm256_store_ps(laneY, sumY);
+	for (int lane = 0; lane < 8; lane++)
+	{
+		accelerationX += laneX[lane];
+		accelerationY += laneY[lane];
+	}
+
+	ScalarAccumulateAttraction(bodyX, bodyY, x + i, y + i, mass + i, count - i, softeningSquared,
+		accelerationX, accelerationY);
+}
+
+float SumFluidDensity(const float* x, const float* y, uint32_t count, const FluidRuns& runs, float particleX,
+	float particleY, float aspectRatio, float smoothingRadius, uint32_t& neighbours)
+{
+	const __m256 positionX = _mm256_set1_ps(particleX);
+	const __m256 positionY = _mm256_set1_ps(particleY);
+	const __m256 aspect = _mm256_set1_ps(aspectRatio);
+	const __m256 radius = _mm256_set1_ps(smoothingRadius);
+	const __m256 radiusSquared = _mm256_set1_ps(smoothingRadius * smoothingRadius);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	__m256 sum = _mm256_setzero_ps();
+	__m256 inRangeCount = _mm256_setzero_ps();
+	float density = 0.0f;
+	for (uint32_t run = 0; run < runs.count; run++)
+	{
+		const __m256i last = _mm256_set1_epi32(static_cast<int>(runs.end[run]));
+		uint32_t j = runs.begin[run];
+		// Runs are short, so the last partial group is loaded whole and its lanes past the end
+		// masked off, as long as that stays inside the columns
+		for (; j < runs.end[run] && j + 8 <= count; j += 8)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(x + j), aspect), positionX);
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), positionY);
+			__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			__m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), laneOffsets);
+			__m256 inRun = _mm256_castsi256_ps(_mm256_cmpgt_epi32(last, index));
+			__m256 inRange = _mm256_and_ps(inRun, _mm256_cmp_ps(distanceSquared, radiusSquared, _CMP_LT_OQ));
+
+			__m256 falloff = _mm256_and_ps(inRange, _mm256_sub_ps(radius, _mm256_sqrt_ps(distanceSquared)));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(falloff, falloff));
+			inRangeCount = _mm256_add_ps(inRangeCount, _mm256_and_ps(inRange, one));
+		}
+
+		if (j < runs.end[run])
+		{
+			FluidRuns rest = { { j }, { runs.end[run] }, 1 };
+			density += ScalarSumFluidDensity(x, y, rest, particleX, particleY, aspectRatio, smoothingRadius, neighbours);
+		}
+	}
+
+	alignas(32) float laneSum[8];
+	alignas(32) float laneCount[8];
+	_mm256_store_ps(laneSum, sum);
+	_mm256_store_ps(laneCount, inRangeCount);
+	for (int lane = 0; lane < 8; lane++)
+	{
+		density += laneSum[lane];
+		neighbours += static_cast<uint32_t>(laneCount[lane]);
+	}
+	return density;
+}
+
+void AccumulateFluidForces(const FluidColumns& particles, uint32_t i, const FluidRuns& runs, float aspectRatio,
+	float smoothingRadius, float& pressureX, float& pressureY, float& viscosityX, float& viscosityY)
+{
+	const __m256 aspect = _mm256_set1_ps(aspectRatio);
+	const __m256 positionX = _mm256_set1_ps(particles.x[i] * aspectRatio);
+	const __m256 positionY = _mm256_set1_ps(particles.y[i]);
+	const __m256 velocityX = _mm256_set1_ps(particles.xVcty[i] * aspectRatio);
+	const __m256 velocityY = _mm256_set1_ps(particles.yVcty[i]);
+	const __m256 pressureTerm = _mm256_set1_ps(particles.pressureTerm[i]);
+	const __m256 radius = _mm256_set1_ps(smoothingRadius);
+	const __m256 radiusSquared = _mm256_set1_ps(smoothingRadius * smoothingRadius);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 offset = _mm256_set1_ps(FluidCoincidentOffset);
+	const __m256 offsetSquared = _mm256_set1_ps(FluidCoincidentOffset * FluidCoincidentOffset);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 threeHalves = _mm256_set1_ps(1.5f);
+	const __m256i self = _mm256_set1_epi32(static_cast<int>(i));
+	const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	__m256 sumPressureX = zero;
+	__m256 sumPressureY = zero;
+	__m256 sumViscosityX = zero;
+	__m256 sumViscosityY = zero;
+	for (uint32_t run = 0; run < runs.count; run++)
+	{
+		const __m256i last = _mm256_set1_epi32(static_cast<int>(runs.end[run]));
+		uint32_t j = runs.begin[run];
+		for (; j < runs.end[run] && j + 8 <= particles.count; j += 8)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(particles.x + j), aspect), positionX);
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(particles.y + j), positionY);
+			__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+			__m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), laneOffsets);
+			__m256 isSelf = _mm256_castsi256_ps(_mm256_cmpeq_epi32(index, self));
+			__m256 inRun = _mm256_castsi256_ps(_mm256_cmpgt_epi32(last, index));
+			__m256 inRange = _mm256_andnot_ps(isSelf,
+				_mm256_and_ps(inRun, _mm256_cmp_ps(distanceSquared, radiusSquared, _CMP_LT_OQ)));
+
+			// Coincident lanes get +offset above i and -offset below it
+			__m256 coincident = _mm256_cmp_ps(distanceSquared, zero, _CMP_EQ_OQ);
+			__m256 above = _mm256_castsi256_ps(_mm256_cmpgt_epi32(index, self));
+			__m256 nudge = _mm256_blendv_ps(_mm256_sub_ps(zero, offset), offset, above);
+			dx = _mm256_blendv_ps(dx, nudge, coincident);
+			distanceSquared = _mm256_blendv_ps(distanceSquared, offsetSquared, coincident);
+
+			// rsqrt plus one Newton-Raphson step, distanceSquared is never 0 by now. Out of range
+			// lanes, the particle itself among them, end up with 0 falloff
+			__m256 inverseDistance = _mm256_rsqrt_ps(distanceSquared);
+			__m256 refine = _mm256_sub_ps(threeHalves,
+				_mm256_mul_ps(_mm256_mul_ps(half, distanceSquared), _mm256_mul_ps(inverseDistance, inverseDistance)));
+			inverseDistance = _mm256_mul_ps(inverseDistance, refine);
+			__m256 falloff = _mm256_and_ps(inRange, _mm256_sub_ps(radius, _mm256_mul_ps(distanceSquared, inverseDistance)));
+			__m256 push = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(pressureTerm,
+				_mm256_loadu_ps(particles.pressureTerm + j)), falloff), inverseDistance);
+			sumPressureX = _mm256_sub_ps(sumPressureX, _mm256_mul_ps(dx, push));
+			sumPressureY = _mm256_sub_ps(sumPressureY, _mm256_mul_ps(dy, push));
+
+			__m256 drag = _mm256_mul_ps(falloff, _mm256_loadu_ps(particles.inverseDensity + j));
+			__m256 relativeX = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(particles.xVcty + j), aspect), velocityX);
+			__m256 relativeY = _mm256_sub_ps(_mm256_loadu_ps(particles.yVcty + j), velocityY);
+			sumViscosityX = _mm256_add_ps(sumViscosityX, _mm256_mul_ps(relativeX, drag));
+			sumViscosityY = _mm256_add_ps(sumViscosityY, _mm256_mul_ps(relativeY, drag));
+		}
+
+		if (j < runs.end[run])
+		{
+			FluidRuns rest = { { j }, { runs.end[run] }, 1 };
+			ScalarAccumulateFluidForces(particles, i, rest, aspectRatio, smoothingRadius, pressureX, pressureY,
+				viscosityX, viscosityY);
+		}
+	}
+
+	alignas(32) float lanePressureX[8];
+	alignas(32) float lanePressureY[8];
+	alignas(32) float laneViscosityX[8];
+	alignas(32) float laneViscosityY[8];
+	_mm256_store_ps(lanePressureX, sumPressureX);
+	_mm256_store_ps(lanePressureY, sumPressureY);
+	_mm256_store_ps(laneViscosityX, sumViscosityX);
+	_mm256_store_ps(laneViscosityY, sumViscosityY);
+	for (int lane = 0; lane < 8; lane++)
+	{
+		pressureX += lanePressureX[lane];
+		pressureY += lanePressureY[lane];
+		viscosityX += laneViscosityX[lane];
+		viscosityY += laneViscosityY[lane];
+	}
+}
+
+void SampleGrid(const float* field, uint32_t width, uint32_t height, const float* sampleX, const float* sampleY,
+	size_t count, float* values)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 maxX = _mm256_set1_ps(static_cast<float>(width - 1));
+	const __m256 maxY = _mm256_set1_ps(static_cast<float>(height - 1));
+	const __m256 lastCellX = _mm256_set1_ps(static_cast<float>(width - 2));
+	const __m256 lastCellY = _mm256_set1_ps(static_cast<float>(height - 2));
+	const __m256 rowLength = _mm256_set1_ps(static_cast<float>(width));
+	const __m256i right = _mm256_set1_epi32(1);
+	const __m256i up = _mm256_set1_epi32(static_cast<int>(width));
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(sampleX + i), zero), maxX);
+		__m256 y = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(sampleY + i), zero), maxY);
+
+		// x and y aren't negative, so truncating floors. The last row and column take the
+		// cell before them with a fraction of 1
+		__m256 cellX = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(x)), lastCellX);
+		__m256 cellY = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(y)), lastCellY);
+		__m256 fractionX = _mm256_sub_ps(x, cellX);
+		__m256 fractionY = _mm256_sub_ps(y, cellY);
+
+		// Indices are worked out in floats, exact below 2^24 values
+		__m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(cellY, rowLength), cellX));
+		__m256 bottomLeft = _mm256_i32gather_ps(field, index, 4);
+		__m256 bottomRight = _mm256_i32gather_ps(field, _mm256_add_epi32(index, right), 4);
+		__m256 topLeft = _mm256_i32gather_ps(field, _mm256_add_epi32(index, up), 4);
+		__m256 topRight = _mm256_i32gather_ps(field, _mm256_add_epi32(_mm256_add_epi32(index, up), right), 4);
+
+		__m256 bottom = _mm256_add_ps(bottomLeft, _mm256_mul_ps(_mm256_sub_ps(bottomRight, bottomLeft), fractionX));
+		__m256 top = _mm256_add_ps(topLeft, _mm256_mul_ps(_mm256_sub_ps(topRight, topLeft), fractionX));
+		_mm256_storeu_ps(values + i, _mm256_add_ps(bottom, _mm256_mul_ps(_mm256_sub_ps(top, bottom), fractionY)));
+	}
+
+	ScalarSampleGrid(field, width, height, sampleX + i, sampleY + i, count - i, values + i);
+}
+
+void RelaxPressureRow(const PressureRow& row, uint32_t begin, uint32_t end, uint32_t parity)
+{
+	// Every lane is worked out and only the cells of the parity kept, the others read cells of
+	// the parity being updated and would be out of date anyway. A block is worked out before any
+	// of it is stored, a load straddling the store just before it would stall
+	const __m256 evenLanes = _mm256_castsi256_ps(_mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0));
+	const __m256 oddLanes = _mm256_castsi256_ps(_mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+	const uint32_t BlockVectors = 8;
+
+	uint32_t i = begin;
+	while (i + 8 <= end)
+	{
+		uint32_t vectors = std::min((end - i) / 8, BlockVectors);
+		__m256 relaxed[BlockVectors];
+		for (uint32_t vector = 0; vector < vectors; vector++)
+		{
+			uint32_t cell = i + vector * 8;
+			__m256 sum = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(row.weightX + cell), _mm256_loadu_ps(row.pressure + cell - 1)),
+					_mm256_mul_ps(_mm256_loadu_ps(row.weightX + cell + 1), _mm256_loadu_ps(row.pressure + cell + 1))),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(row.weightBelow + cell), _mm256_loadu_ps(row.below + cell)),
+					_mm256_mul_ps(_mm256_loadu_ps(row.weightAbove + cell), _mm256_loadu_ps(row.above + cell))));
+			relaxed[vector] = _mm256_mul_ps(_mm256_sub_ps(sum, _mm256_loadu_ps(row.rhs + cell)),
+				_mm256_loadu_ps(row.inverseDiagonal + cell));
+		}
+
+		__m256 update = ((i & 1) == parity) ? evenLanes : oddLanes;
+		for (uint32_t vector = 0; vector < vectors; vector++)
+		{
+			float* pressure = row.pressure + i + vector * 8;
+			_mm256_storeu_ps(pressure, _mm256_blendv_ps(_mm256_loadu_ps(pressure), relaxed[vector], update));
+		}
+		i += vectors * 8;
+	}
+
+	ScalarRelaxPressureRow(row, i, end, parity);
+}
+
+#elif defined(PHYSICS_SIMD_SSE)
+
+namespace
+{
+	// Widen 4 flag bytes to 4 ints, lanes that move get all bits set
+	__m128 MovingMask(const uint8_t* noMovement, const uint8_t* asleep)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		int packedFlags, packedAsleep;
+		std::memcpy(&packedFlags, noMovement, sizeof(packedFlags));
+		std::memcpy(&packedAsleep, asleep, sizeof(packedAsleep));
+		packedFlags |= packedAsleep;
+		__m128i flags = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedFlags), zero), zero);
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(flags, zero));
+	}
+}
+
+void IntegrateVelocities(float* yVcty, const uint8_t* noMovement, const uint8_t* asleep, size_t count,
+	float gravity, float dt)
+{
+	const __m128 gravityWide = _mm_set1_ps(gravity * dt);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 gravityStep = _mm_and_ps(MovingMask(noMovement + i, asleep + i), gravityWide);
+		_mm_storeu_ps(yVcty + i, _mm_sub_ps(_mm_loadu_ps(yVcty + i), gravityStep));
+	}
+
+	ScalarIntegrateVelocities(yVcty + i, noMovement + i, asleep + i, count - i, gravity, dt);
+}
+
+void IntegratePositions(float* x, float* y, const float* xVcty, const float* yVcty, const uint8_t* noMovement,
+	const uint8_t* asleep, size_t count, float dt)
+{
+	const __m128 dtWide = _mm_set1_ps(dt);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 step = _mm_and_ps(MovingMask(noMovement + i, asleep + i), dtWide);
+
+		__m128 moveX = _mm_mul_ps(_mm_loadu_ps(xVcty + i), step);
+		__m128 moveY = _mm_mul_ps(_mm_loadu_ps(yVcty + i), step);
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), moveX));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), moveY));
+	}
+
+	ScalarIntegratePositions(x + i, y + i, xVcty + i, yVcty + i, noMovement + i, asleep + i, count - i, dt);
+}
+
+void CollideCirclePairs(const float* x, const float* y, const float* radius, const BodyPair* pairs,
+	size_t count, float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	const __m128 aspect = _mm_set1_ps(aspectRatio);
+	const __m128 contactMargin = _mm_set1_ps(margin);
+	const __m128 minDistanceSquared = _mm_set1_ps(MinDistanceSquared);
+	const __m128 coincidentOffset = _mm_set1_ps(CoincidentOffset);
+	const __m128 coincidentDistanceSquared = _mm_set1_ps(CoincidentDistanceSquared);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+	alignas(16) float laneNormalX[4];
+	alignas(16) float laneNormalY[4];
+	alignas(16) float laneOverlap[4];
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// No gathers before AVX2, the lanes are loaded one by one
+		const BodyPair* batch = pairs + i;
+		__m128 xA = _mm_setr_ps(x[batch[0].a], x[batch[1].a], x[batch[2].a], x[batch[3].a]);
+		__m128 xB = _mm_setr_ps(x[batch[0].b], x[batch[1].b], x[batch[2].b], x[batch[3].b]);
+		__m128 yA = _mm_setr_ps(y[batch[0].a], y[batch[1].a], y[batch[2].a], y[batch[3].a]);
+		__m128 yB = _mm_setr_ps(y[batch[0].b], y[batch[1].b], y[batch[2].b], y[batch[3].b]);
+		__m128 radiusA = _mm_setr_ps(radius[batch[0].a], radius[batch[1].a], radius[batch[2].a], radius[batch[3].a]);
+		__m128 radiusB = _mm_setr_ps(radius[batch[0].b], radius[batch[1].b], radius[batch[2].b], radius[batch[3].b]);
+
+		__m128 dx = _mm_mul_ps(_mm_sub_ps(xB, xA), aspect);
+		__m128 dy = _mm_sub_ps(yB, yA);
+		__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		__m128 distanceBetween = _mm_add_ps(radiusA, radiusB);
+
+		__m128 reach = _mm_add_ps(distanceBetween, contactMargin);
+		__m128 hit = _mm_cmplt_ps(distanceSquared, _mm_mul_ps(reach, reach));
+		int hitMask = _mm_movemask_ps(hit);
+		if (hitMask == 0)
+		{
+			continue;
+		}
+
+		// SSE2 has no blendv, select with and / andnot / or
+		__m128 coincident = _mm_cmplt_ps(distanceSquared, minDistanceSquared);
+		dx = _mm_or_ps(_mm_and_ps(coincident, coincidentOffset), _mm_andnot_ps(coincident, dx));
+		dy = _mm_or_ps(_mm_and_ps(coincident, coincidentOffset), _mm_andnot_ps(coincident, dy));
+		distanceSquared = _mm_or_ps(_mm_and_ps(coincident, coincidentDistanceSquared), _mm_andnot_ps(coincident, distanceSquared));
+
+		__m128 inverseDistance = _mm_rsqrt_ps(distanceSquared);
+		__m128 refine = _mm_sub_ps(threeHalves,
+			_mm_mul_ps(_mm_mul_ps(half, distanceSquared), _mm_mul_ps(inverseDistance, inverseDistance)));
+		inverseDistance = _mm_mul_ps(inverseDistance, refine);
+
+		_mm_store_ps(laneNormalX, _mm_mul_ps(dx, inverseDistance));
+		_mm_store_ps(laneNormalY, _mm_mul_ps(dy, inverseDistance));
+		_mm_store_ps(laneOverlap, _mm_sub_ps(distanceBetween, _mm_mul_ps(distanceSquared, inverseDistance)));
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (hitMask & (1 << lane))
+			{
+				contacts.push_back({ batch[lane].a, batch[lane].b, laneNormalX[lane], laneNormalY[lane], laneOverlap[lane] });
+			}
+		}
+	}
+
+	ScalarCollideCirclePairs(x, y, radius, pairs + i, count - i, aspectRatio, margin, contacts);
+}
+
+void SolveContactVelocities(ContactColumns& contacts, size_t begin, size_t end, float* xVcty, float* yVcty,
+	float aspectRatio)
+{
+	const __m128 aspect = _mm_set1_ps(aspectRatio);
+	const __m128 inverseAspect = _mm_set1_ps(1.0f / aspectRatio);
+	const __m128 zero = _mm_setzero_ps();
+
+	alignas(16) float laneAX[4];
+	alignas(16) float laneAY[4];
+	alignas(16) float laneBX[4];
+	alignas(16) float laneBY[4];
+
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		// No gathers before AVX2, the lanes are loaded one by one
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint32_t a = contacts.a[i + lane];
+			uint32_t b = contacts.b[i + lane];
+			bool staticB = (b == ContactColumns::StaticContactBody);
+			laneAX[lane] = xVcty[a];
+			laneAY[lane] = yVcty[a];
+			laneBX[lane] = staticB ? 0.0f : xVcty[b];
+			laneBY[lane] = staticB ? 0.0f : yVcty[b];
+		}
+
+		__m128 velocityAX = _mm_load_ps(laneAX);
+		__m128 velocityAY = _mm_load_ps(laneAY);
+		__m128 velocityBX = _mm_load_ps(laneBX);
+		__m128 velocityBY = _mm_load_ps(laneBY);
+
+		__m128 normalX = _mm_loadu_ps(contacts.normalX.data() + i);
+		__m128 normalY = _mm_loadu_ps(contacts.normalY.data() + i);
+		__m128 invMassA = _mm_loadu_ps(contacts.invMassA.data() + i);
+		__m128 invMassB = _mm_loadu_ps(contacts.invMassB.data() + i);
+		__m128 mass = _mm_loadu_ps(contacts.mass.data() + i);
+
+		// Friction
+		__m128 tangentX = _mm_sub_ps(zero, normalY);
+		__m128 tangentY = normalX;
+		__m128 relativeX = _mm_mul_ps(_mm_sub_ps(velocityBX, velocityAX), aspect);
+		__m128 relativeY = _mm_sub_ps(velocityBY, velocityAY);
+		__m128 tangentVelocity = _mm_add_ps(_mm_mul_ps(relativeX, tangentX), _mm_mul_ps(relativeY, tangentY));
+
+		__m128 maxFriction = _mm_mul_ps(_mm_loadu_ps(contacts.friction.data() + i),
+			_mm_loadu_ps(contacts.normalImpulse.data() + i));
+		__m128 oldTangentImpulse = _mm_loadu_ps(contacts.tangentImpulse.data() + i);
+		__m128 tangentImpulse = _mm_sub_ps(oldTangentImpulse, _mm_mul_ps(mass, tangentVelocity));
+		tangentImpulse = _mm_min_ps(_mm_max_ps(tangentImpulse, _mm_sub_ps(zero, maxFriction)), maxFriction);
+		_mm_storeu_ps(contacts.tangentImpulse.data() + i, tangentImpulse);
+
+		__m128 impulse = _mm_sub_ps(tangentImpulse, oldTangentImpulse);
+		__m128 impulseX = _mm_mul_ps(_mm_mul_ps(tangentX, impulse), inverseAspect);
+		__m128 impulseY = _mm_mul_ps(tangentY, impulse);
+		velocityAX = _mm_sub_ps(velocityAX, _mm_mul_ps(impulseX, invMassA));
+		velocityAY = _mm_sub_ps(velocityAY, _mm_mul_ps(impulseY, invMassA));
+		velocityBX = _mm_add_ps(velocityBX, _mm_mul_ps(impulseX, invMassB));
+		velocityBY = _mm_add_ps(velocityBY, _mm_mul_ps(impulseY, invMassB));
+
+		// Normal
+		relativeX = _mm_mul_ps(_mm_sub_ps(velocityBX, velocityAX), aspect);
+		relativeY = _mm_sub_ps(velocityBY, velocityAY);
+		__m128 normalVelocity = _mm_add_ps(_mm_mul_ps(relativeX, normalX), _mm_mul_ps(relativeY, normalY));
+
+		__m128 oldNormalImpulse = _mm_loadu_ps(contacts.normalImpulse.data() + i);
+		__m128 normalImpulse = _mm_max_ps(_mm_sub_ps(oldNormalImpulse, _mm_mul_ps(mass, normalVelocity)), zero);
+		_mm_storeu_ps(contacts.normalImpulse.data() + i, normalImpulse);
+
+		impulse = _mm_sub_ps(normalImpulse, oldNormalImpulse);
+		impulseX = _mm_mul_ps(_mm_mul_ps(normalX, impulse), inverseAspect);
+		impulseY = _mm_mul_ps(normalY, impulse);
+		_mm_store_ps(laneAX, _mm_sub_ps(velocityAX, _mm_mul_ps(impulseX, invMassA)));
+		_mm_store_ps(laneAY, _mm_sub_ps(velocityAY, _mm_mul_ps(impulseY, invMassA)));
+		_mm_store_ps(laneBX, _mm_add_ps(velocityBX, _mm_mul_ps(impulseX, invMassB)));
+		_mm_store_ps(laneBY, _mm_add_ps(velocityBY, _mm_mul_ps(impulseY, invMassB)));
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint32_t a = contacts.a[i + lane];
+			uint32_t b = contacts.b[i + lane];
+			xVcty[a] = laneAX[lane];
+			yVcty[a] = laneAY[lane];
+			if (b != ContactColumns::StaticContactBody)
+			{
+				xVcty[b] = laneBX[lane];
+				yVcty[b] = laneBY[lane];
+			}
+		}
+	}
+
+	ScalarSolveContactVelocities(contacts, i, end, xVcty, yVcty, aspectRatio);
+}
+
+void AccumulateAttraction(float bodyX, float bodyY, const float* x, const float* y, const float* mass, size_t count,
+	float softeningSquared, float& accelerationX, float& accelerationY)
+{
+	const __m128 positionX = _mm_set1_ps(bodyX);
+	const __m128 positionY = _mm_set1_ps(bodyY);
+	const __m128 softening = _mm_set1_ps(softeningSquared);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+	__m128 sumX = zero;
+	__m128 sumY = zero;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), positionX);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), positionY);
+		__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+		// Same as the AVX2 kernel, coincident points get no mass and a distance of 1. SSE2 has no
+		// blend, so the 1 goes in through the mask
+		__m128 coincident = _mm_cmpeq_ps(distanceSquared, zero);
+		__m128 softened = _mm_or_ps(_mm_andnot_ps(coincident, _mm_add_ps(distanceSquared, softening)),
+			_mm_and_ps(coincident, one));
+		__m128 pointMass = _mm_andnot_ps(coincident, _mm_loadu_ps(mass + i));
+
+		__m128 inverseDistance = _mm_rsqrt_ps(softened);
+		__m128 refine = _mm_sub_ps(threeHalves,
+			_mm_mul_ps(_mm_mul_ps(half, softened), _mm_mul_ps(inverseDistance, inverseDistance)));
+		inverseDistance = _mm_mul_ps(inverseDistance, refine);
+
+		__m128 strength = _mm_mul_ps(pointMass, _mm_mul_ps(inverseDistance, _mm_mul_ps(inverseDistance, inverseDistance)));
+		sumX = _mm_add_ps(sumX, _mm_mul_ps(dx, strength));
+		sumY = _mm_add_ps(sumY, _mm_mul_ps(dy, strength));
+	}
+
+	alignas(16) float laneX[4];
+	alignas(16) float laneY[4];
+	_mm_store_ps(laneX, sumX);
+	_mm_store_ps(laneY, sumY);
+	for (int lane = 0; lane < 4; lane++)
+	{
+		accelerationX += laneX[lane];
+		accelerationY += laneY[lane];
+	}
+
+	ScalarAccumulateAttraction(bodyX, bodyY, x + i, y + i, mass + i, count - i, softeningSquared,
+		accelerationX, accelerationY);
+}
+
+float SumFluidDensity(const float* x, const float* y, uint32_t count, const FluidRuns& runs, float particleX,
+	float particleY, float aspectRatio, float smoothingRadius, uint32_t& neighbours)
+{
+	const __m128 positionX = _mm_set1_ps(particleX);
+	const __m128 positionY = _mm_set1_ps(particleY);
+	const __m128 aspect = _mm_set1_ps(aspectRatio);
+	const __m128 radius = _mm_set1_ps(smoothingRadius);
+	const __m128 radiusSquared = _mm_set1_ps(smoothingRadius * smoothingRadius);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+
+	__m128 sum = _mm_setzero_ps();
+	__m128 inRangeCount = _mm_setzero_ps();
+	float density = 0.0f;
+	for (uint32_t run = 0; run < runs.count; run++)
+	{
+		const __m128i last = _mm_set1_epi32(static_cast<int>(runs.end[run]));
+		uint32_t j = runs.begin[run];
+		// Runs are short, so the last partial group is loaded whole and its lanes past the end
+		// masked off, as long as that stays inside the columns
+		for (; j < runs.end[run] && j + 4 <= count; j += 4)
+		{
+			__m128 dx = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(x + j), aspect), positionX);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), positionY);
+			__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			__m128i index = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(j)), laneOffsets);
+			__m128 inRun = _mm_castsi128_ps(_mm_cmpgt_epi32(last, index));
+			__m128 inRange = _mm_and_ps(inRun, _mm_cmplt_ps(distanceSquared, radiusSquared));
+
+			__m128 falloff = _mm_and_ps(inRange, _mm_sub_ps(radius, _mm_sqrt_ps(distanceSquared)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(falloff, falloff));
+			inRangeCount = _mm_add_ps(inRangeCount, _mm_and_ps(inRange, one));
+		}
+
+		if (j < runs.end[run])
+		{
+			FluidRuns rest = { { j }, { runs.end[run] }, 1 };
+			density += ScalarSumFluidDensity(x, y, rest, particleX, particleY, aspectRatio, smoothingRadius, neighbours);
+		}
+	}
+
+	alignas(16) float laneSum[4];
+	alignas(16) float laneCount[4];
+	_mm_store_ps(laneSum, sum);
+	_mm_store_ps(laneCount, inRangeCount);
+	for (int lane = 0; lane < 4; lane++)
+	{
+		density += laneSum[lane];
+		neighbours += static_cast<uint32_t>(laneCount[lane]);
+	}
+	return density;
+}
+
+void AccumulateFluidForces(const FluidColumns& particles, uint32_t i, const FluidRuns& runs, float aspectRatio,
+	float smoothingRadius, float& pressureX, float& pressureY, float& viscosityX, float& viscosityY)
+{
+	const __m128 aspect = _mm_set1_ps(aspectRatio);
+	const __m128 positionX = _mm_set1_ps(particles.x[i] * aspectRatio);
+	const __m128 positionY = _mm_set1_ps(particles.y[i]);
+	const __m128 velocityX = _mm_set1_ps(particles.xVcty[i] * aspectRatio);
+	const __m128 velocityY = _mm_set1_ps(particles.yVcty[i]);
+	const __m128 pressureTerm = _mm_set1_ps(particles.pressureTerm[i]);
+	const __m128 radius = _mm_set1_ps(smoothingRadius);
+	const __m128 radiusSquared = _mm_set1_ps(smoothingRadius * smoothingRadius);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offset = _mm_set1_ps(FluidCoincidentOffset);
+	const __m128 offsetSquared = _mm_set1_ps(FluidCoincidentOffset * FluidCoincidentOffset);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+	const __m128i self = _mm_set1_epi32(static_cast<int>(i));
+	const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+
+	__m128 sumPressureX = zero;
+	__m128 sumPressureY = zero;
+	__m128 sumViscosityX = zero;
+	__m128 sumViscosityY = zero;
+	for (uint32_t run = 0; run < runs.count; run++)
+	{
+		const __m128i last = _mm_set1_epi32(static_cast<int>(runs.end[run]));
+		uint32_t j = runs.begin[run];
+		for (; j < runs.end[run] && j + 4 <= particles.count; j += 4)
+		{
+			__m128 dx = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(particles.x + j), aspect), positionX);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(particles.y + j), positionY);
+			__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+			__m128i index = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(j)), laneOffsets);
+			__m128 isSelf = _mm_castsi128_ps(_mm_cmpeq_epi32(index, self));
+			__m128 inRun = _mm_castsi128_ps(_mm_cmpgt_epi32(last, index));
+			__m128 inRange = _mm_andnot_ps(isSelf,
+				_mm_and_ps(inRun, _mm_cmplt_ps(distanceSquared, radiusSquared)));
+
+			// Coincident lanes get +offset above i and -offset below it
+			__m128 coincident = _mm_cmpeq_ps(distanceSquared, zero);
+			__m128 above = _mm_castsi128_ps(_mm_cmpgt_epi32(index, self));
+			__m128 nudge = _mm_or_ps(_mm_and_ps(above, offset), _mm_andnot_ps(above, _mm_sub_ps(zero, offset)));
+			dx = _mm_or_ps(_mm_and_ps(coincident, nudge), _mm_andnot_ps(coincident, dx));
+			distanceSquared = _mm_or_ps(_mm_and_ps(coincident, offsetSquared), _mm_andnot_ps(coincident, distanceSquared));
+
+			// rsqrt plus one Newton-Raphson step, distanceSquared is never 0 by now. Out of range
+			// lanes, the particle itself among them, end up with 0 falloff
+			__m128 inverseDistance = _mm_rsqrt_ps(distanceSquared);
+			__m128 refine = _mm_sub_ps(threeHalves,
+				_mm_mul_ps(_mm_mul_ps(half, distanceSquared), _mm_mul_ps(inverseDistance, inverseDistance)));
+			inverseDistance = _mm_mul_ps(inverseDistance, refine);
+			__m128 falloff = _mm_and_ps(inRange, _mm_sub_ps(radius, _mm_mul_ps(distanceSquared, inverseDistance)));
+			__m128 push = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(pressureTerm,
+				_mm_loadu_ps(particles.pressureTerm + j)), falloff), inverseDistance);
+			sumPressureX = _mm_sub_ps(sumPressureX, _mm_mul_ps(dx, push));
+			sumPressureY = _mm_sub_ps(sumPressureY, _mm_mul_ps(dy, push));
+
+			__m128 drag = _mm_mul_ps(falloff, _mm_loadu_ps(particles.inverseDensity + j));
+			__m128 relativeX = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(particles.xVcty + j), aspect), velocityX);
+			__m128 relativeY = _mm_sub_ps(_mm_loadu_ps(particles.yVcty + j), velocityY);
+			sumViscosityX = _mm_add_ps(sumViscosityX, _mm_mul_ps(relativeX, drag));
+			sumViscosityY = _mm_add_ps(sumViscosityY, _mm_mul_ps(relativeY, drag));
+		}
+
+		if (j < runs.end[run])
+		{
+			FluidRuns rest = { { j }, { runs.end[run] }, 1 };
+			ScalarAccumulateFluidForces(particles, i, rest, aspectRatio, smoothingRadius, pressureX, pressureY,
+				viscosityX, viscosityY);
+		}
+	}
+
+	alignas(16) float lanePressureX[4];
+	alignas(16) float lanePressureY[4];
+	alignas(16) float laneViscosityX[4];
+	alignas(16) float laneViscosityY[4];
+	_mm_store_ps(lanePressureX, sumPressureX);
+	_mm_store_ps(lanePressureY, sumPressureY);
+	_mm_store_ps(laneViscosityX, sumViscosityX);
+	_mm_store_ps(laneViscosityY, sumViscosityY);
+	for (int lane = 0; lane < 4; lane++)
+	{
+		pressureX += lanePressureX[lane];
+		pressureY += lanePressureY[lane];
+		viscosityX += laneViscosityX[lane];
+		viscosityY += laneViscosityY[lane];
+	}
+}
+
+void SampleGrid(const float* field, uint32_t width, uint32_t height, const float* sampleX, const float* sampleY,
+	size_t count, float* values)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxX = _mm_set1_ps(static_cast<float>(width - 1));
+	const __m128 maxY = _mm_set1_ps(static_cast<float>(height - 1));
+	const __m128 lastCellX = _mm_set1_ps(static_cast<float>(width - 2));
+	const __m128 lastCellY = _mm_set1_ps(static_cast<float>(height - 2));
+	const __m128 rowLength = _mm_set1_ps(static_cast<float>(width));
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(sampleX + i), zero), maxX);
+		__m128 y = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(sampleY + i), zero), maxY);
+		__m128 cellX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(x)), lastCellX);
+		__m128 cellY = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(y)), lastCellY);
+		__m128 fractionX = _mm_sub_ps(x, cellX);
+		__m128 fractionY = _mm_sub_ps(y, cellY);
+
+		// SSE2 has no gather, the corners are loaded one lane at a time
+		alignas(16) int32_t index[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(index),
+			_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(cellY, rowLength), cellX)));
+		__m128 bottomLeft = _mm_setr_ps(field[index[0]], field[index[1]], field[index[2]], field[index[3]]);
+		__m128 bottomRight = _mm_setr_ps(field[index[0] + 1], field[index[1] + 1], field[index[2] + 1],
+			field[index[3] + 1]);
+		__m128 topLeft = _mm_setr_ps(field[index[0] + width], field[index[1] + width], field[index[2] + width],
+			field[index[3] + width]);
+		__m128 topRight = _mm_setr_ps(field[index[0] + width + 1], field[index[1] + width + 1],
+			field[index[2] + width + 1], field[index[3] + width + 1]);
+
+		__m128 bottom = _mm_add_ps(bottomLeft, _mm_mul_ps(_mm_sub_ps(bottomRight, bottomLeft), fractionX));
+		__m128 top = _mm_add_ps(topLeft, _mm_mul_ps(_mm_sub_ps(topRight, topLeft), fractionX));
+		_mm_storeu_ps(values + i, _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), fractionY)));
+	}
+
+	ScalarSampleGrid(field, width, height, sampleX + i, sampleY + i, count - i, values + i);
+}
+
+void RelaxPressureRow(const PressureRow& row, uint32_t begin, uint32_t end, uint32_t parity)
+{
+	const __m128 evenLanes = _mm_castsi128_ps(_mm_setr_epi32(-1, 0, -1, 0));
+	const __m128 oddLanes = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, -1));
+	const uint32_t BlockVectors = 16;
+
+	uint32_t i = begin;
+	while (i + 4 <= end)
+	{
+		uint32_t vectors = std::min((end - i) / 4, BlockVectors);
+		__m128 relaxed[BlockVectors];
+		for (uint32_t vector = 0; vector < vectors; vector++)
+		{
+			uint32_t cell = i + vector * 4;
+			__m128 sum = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row.weightX + cell), _mm_loadu_ps(row.pressure + cell - 1)),
+					_mm_mul_ps(_mm_loadu_ps(row.weightX + cell + 1), _mm_loadu_ps(row.pressure + cell + 1))),
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row.weightBelow + cell), _mm_loadu_ps(row.below + cell)),
+					_mm_mul_ps(_mm_loadu_ps(row.weightAbove + cell), _mm_loadu_ps(row.above + cell))));
+			relaxed[vector] = _mm_mul_ps(_mm_sub_ps(sum, _mm_loadu_ps(row.rhs + cell)),
+				_mm_loadu_ps(row.inverseDiagonal + cell));
+		}
+
+		__m128 update = ((i & 1) == parity) ? evenLanes : oddLanes;
+		for (uint32_t vector = 0; vector < vectors; vector++)
+		{
+			float* pressure = row.pressure + i + vector * 4;
+			__m128 kept = _mm_loadu_ps(pressure);
+			_mm_storeu_ps(pressure, _mm_or_ps(_mm_and_ps(update, relaxed[vector]), _mm_andnot_ps(update, kept)));
+		}
+		i += vectors * 4;
+	}
+
+	ScalarRelaxPressureRow(row, i, end, parity);
+}
+
+#else
+
+void IntegrateVelocities(float* yVcty, const uint8_t* noMovement, const uint8_t* asleep, size_t count,
+	float gravity, float dt)
+{
+	ScalarIntegrateVelocities(yVcty, noMovement, asleep, count, gravity, dt);
+}
+
+void IntegratePositions(float* x, float* y, const float* xVcty, const float* yVcty, const uint8_t* noMovement,
+	const uint8_t* asleep, size_t count, float dt)
+{
+	ScalarIntegratePositions(x, y, xVcty, yVcty, noMovement, asleep, count, dt);
+}
+
+void CollideCirclePairs(const float* x, const float* y, const float* radius, const BodyPair* pairs,
+	size_t count, float aspectRatio, float margin, std::vector<PairContact>& contacts)
+{
+	ScalarCollideCirclePairs(x, y, radius, pairs, count, aspectRatio, margin, contacts);
+}
+
+void SolveContactVelocities(ContactColumns& contacts, size_t begin, size_t end, float* xVcty, float* yVcty,
+	float aspectRatio)
+{
+	ScalarSolveContactVelocities(contacts, begin, end, xVcty, yVcty, aspectRatio);
+}
+
+void AccumulateAttraction(float bodyX, float bodyY, const float* x, const float* y, const float* mass, size_t count,
+	float softeningSquared, float& accelerationX, float& accelerationY)
+{
+	ScalarAccumulateAttraction(bodyX, bodyY, x, y, mass, count, softeningSquared, accelerationX, accelerationY);
+}
+
+float SumFluidDensity(const float* x, const float* y, uint32_t, const FluidRuns& runs, float particleX,
+	float particleY, float aspectRatio, float smoothingRadius, uint32_t& neighbours)
+{
+	return ScalarSumFluidDensity(x, y, runs, particleX, particleY, aspectRatio, smoothingRadius, neighbours);
+}
+
+void AccumulateFluidForces(const FluidColumns& particles, uint32_t i, const FluidRuns& runs, float aspectRatio,
+	float smoothingRadius, float& pressureX, float& pressureY, float& viscosityX, float& viscosityY)
+{
+	ScalarAccumulateFluidForces(particles, i, runs, aspectRatio, smoothingRadius, pressureX, pressureY, viscosityX,
+		viscosityY);
+}
+
+void SampleGrid(const float* field, uint32_t width, uint32_t height, const float* sampleX, const float* sampleY,
+	size_t count, float* values)
+{
+	ScalarSampleGrid(field, width, height, sampleX, sampleY, count, values);
+}
+
+void RelaxPressureRow(const PressureRow& row, uint32_t begin, uint32_t end, uint32_t parity)
+{
+	ScalarRelaxPressureRow(row, begin, end, parity);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "Physics/SpatialQuery.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Touching counts, the exact tests afterwards decide
+	inline bool Touches(const AABB& first, const AABB& second)
+	{
+		return first.minX <= second.maxX && first.maxX >= second.minX &&
+			first.minY <= second.maxY && first.maxY >= second.minY;
+	}
+
+	// First t in [0, limit] where start + move * t touches box, -1 if there is none
+	inline float SegmentEnters(const AABB& box, float startX, float startY, float moveX, float moveY, float limit)
+	{
+		float starts[2] = { startX, startY };
+		float moves[2] = { moveX, moveY };
+		float mins[2] = { box.minX, box.minY };
+		float maxs[2] = { box.maxX, box.maxY };
+		float enter = 0.0f;
+		float exit = limit;
+		for (int axis = 0; axis < 2; axis++)
+		{
+			if (moves[axis] == 0.0f)
+			{
+				if (starts[axis] < mins[axis] || starts[axis] > maxs[axis])
+				{
+					return -1.0f;
+				}
+				continue;
+			}
+
+			float first = (mins[axis] - starts[axis]) / moves[axis];
+			float second = (maxs[axis] - starts[axis]) / moves[axis];
+			enter = std::max(enter, std::min(first, second));
+			exit = std::min(exit, std::max(first, second));
+			if (enter > exit)
+			{
+				return -1.0f;
+			}
+		}
+		return enter;
+	}
+
+	// A point starting at start relative to a circle's centre and moving by move, aspect
+	// corrected. Returns the first time in [0, 1] it is within radius
+	bool CastAgainstCircle(float startX, float startY, float moveX, float moveY, float radius,
+		float& time, float& normalX, float& normalY)
+	{
+		float startDistanceSquared = startX * startX + startY * startY;
+		float c = startDistanceSquared - radius * radius;
+		if (c <= 0.0f)
+		{
+			time = 0.0f;
+			float moveLength = std::sqrt(moveX * moveX + moveY * moveY);
+			if (startDistanceSquared > 0.0f)
+			{
+				float distance = std::sqrt(startDistanceSquared);
+				normalX = startX / distance;
+				normalY = startY / distance;
+			}
+			else if (moveLength > 0.0f)
+			{
+				normalX = -moveX / moveLength;
+				normalY = -moveY / moveLength;
+			}
+			else
+			{
+				normalX = 0.0f;
+				normalY = 1.0f;
+			}
+			return true;
+		}
+
+		// Moving away or not at all never gets closer
+		float a = moveX * moveX + moveY * moveY;
+		float b = startX * moveX + startY * moveY;
+		if (a == 0.0f || b >= 0.0f)
+		{
+			return false;
+		}
+
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+
+		time = (-b - std::sqrt(discriminant)) / a;
+		if (time > 1.0f)
+		{
+			return false;
+		}
+
+		normalX = (startX + moveX * time) / radius;
+		normalY = (startY + moveY * time) / radius;
+		return true;
+	}
+
+	// Same for a box with rounded corners: the box half size grown by radius on every side,
+	// with quarter circles of radius at the corners. A radius of 0 is the plain box
+	bool CastAgainstRoundedBox(float startX, float startY, float moveX, float moveY, float halfWidth, float halfHeight,
+		float radius, float& time, float& normalX, float& normalY)
+	{
+		// Starting within radius of the box
+		float offsetX = startX - std::min(std::max(startX, -halfWidth), halfWidth);
+		float offsetY = startY - std::min(std::max(startY, -halfHeight), halfHeight);
+		float offsetSquared = offsetX * offsetX + offsetY * offsetY;
+		if (offsetSquared <= radius * radius)
+		{
+			time = 0.0f;
+			if (offsetSquared > 0.0f)
+			{
+				float distance = std::sqrt(offsetSquared);
+				normalX = offsetX / distance;
+				normalY = offsetY / distance;
+			}
+			else if (halfWidth - std::abs(startX) < halfHeight - std::abs(startY))
+			{
+				normalX = std::copysign(1.0f, startX);
+				normalY = 0.0f;
+			}
+			else
+			{
+				normalX = 0.0f;
+				normalY = std::copysign(1.0f, startY);
+			}
+			return true;
+		}
+
+		// Enter the box grown by radius at the latest of the times each axis is entered
+		float starts[2] = { startX, startY };
+		float moves[2] = { moveX, moveY };
+		float grows[2] = { halfWidth + radius, halfHeight + radius };
+		float enter = -std::numeric_limits<float>::max();
+		float exit = std::numeric_limits<float>::max();
+		int enterAxis = 0;
+		for (int axis = 0; axis < 2; axis++)
+		{
+			if (moves[axis] == 0.0f)
+			{
+				if (std::abs(starts[axis]) > grows[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float nearTime = (-std::copysign(grows[axis], moves[axis]) - starts[axis]) / moves[axis];
+			float farTime = (std::copysign(grows[axis], moves[axis]) - starts[axis]) / moves[axis];
+			if (nearTime > enter)
+			{
+				enter = nearTime;
+				enterAxis = axis;
+			}
+			exit = std::min(exit, farTime);
+		}
+
+		if (enter > exit || exit < 0.0f || enter > 1.0f)
+		{
+			return false;
+		}
+
+		// Entering at a corner of the grown box, the rounded box there is the corner's circle.
+		// Missing that circle misses the whole shape, every way on from a corner passes through it
+		float enterX = startX + moveX * std::max(enter, 0.0f);
+		float enterY = startY + moveY * std::max(enter, 0.0f);
+		if (radius > 0.0f && std::abs(enterX) > halfWidth && std::abs(enterY) > halfHeight)
+		{
+			float cornerX = std::copysign(halfWidth, enterX);
+			float cornerY = std::copysign(halfHeight, enterY);
+			return CastAgainstCircle(startX - cornerX, startY - cornerY, moveX, moveY, radius, time, normalX, normalY);
+		}
+
+		time = std::max(enter, 0.0f);
+		normalX = (enterAxis == 0) ? -std::copysign(1.0f, moveX) : 0.0f;
+		normalY = (enterAxis == 1) ? -std::copysign(1.0f, moveY) : 0.0f;
+		return true;
+	}
+}
+
+QuerySnapshot::QuerySnapshot(float aspectRatio)
+	: m_AspectRatio(aspectRatio)
+{
+}
+
+void QuerySnapshot::Add(float x, float y, float halfWidth, float halfHeight, float radius, const QueryItem& item)
+{
+	m_X.push_back(x);
+	m_Y.push_back(y);
+	m_HalfWidth.push_back(halfWidth);
+	m_HalfHeight.push_back(halfHeight);
+	m_Radius.push_back(radius);
+	m_Items.push_back(item);
+}
+
+void QuerySnapshot::Build(const BodyStore& bodies, const StaticGeometry& walls, const AABB& groundBox)
+{
+	m_X.clear();
+	m_Y.clear();
+	m_HalfWidth.clear();
+	m_HalfHeight.clear();
+	m_Radius.clear();
+	m_Items.clear();
+
+	// Only circles and squares collide, same as the broadphase. For circles halfHeight is the radius
+	for (uint32_t i = 0; i < bodies.Size(); i++)
+	{
+		bool circle = bodies.type[i] == ShapeType::Circle;
+		if (circle || bodies.type[i] == ShapeType::Square)
+		{
+			Add(bodies.x[i], bodies.y[i], bodies.halfWidth[i], bodies.halfHeight[i],
+				circle ? bodies.halfHeight[i] : 0.0f, { bodies.HandleAt(i), QueryItem::NoFeature });
+		}
+	}
+
+	BodyHandle noBody = { BodyStore::InvalidIndex, 0 };
+	Add((groundBox.minX + groundBox.maxX) / 2.0f, (groundBox.minY + groundBox.maxY) / 2.0f,
+		(groundBox.maxX - groundBox.minX) / 2.0f, (groundBox.maxY - groundBox.minY) / 2.0f, 0.0f, { noBody, 0 });
+	for (uint32_t wall = 0; wall < walls.Size(); wall++)
+	{
+		const AABB& box = walls.GetBounds(wall);
+		Add((box.minX + box.maxX) / 2.0f, (box.minY + box.maxY) / 2.0f,
+			(box.maxX - box.minX) / 2.0f, (box.maxY - box.minY) / 2.0f, 0.0f, { noBody, 1 + wall });
+	}
+
+	std::vector<AABB> bounds(m_Items.size());
+	for (size_t shape = 0; shape < bounds.size(); shape++)
+	{
+		bounds[shape] = { m_X[shape] - m_HalfWidth[shape], m_Y[shape] - m_HalfHeight[shape],
+			m_X[shape] + m_HalfWidth[shape], m_Y[shape] + m_HalfHeight[shape] };
+	}
+	m_Tree.Build(bounds, m_AspectRatio);
+}
+
+void QuerySnapshot::CastShape(uint32_t shape, const CastQuery& query, CastHit& hit) const
+{
+	// Relative to the shape's centre, aspect corrected
+	float startX = (query.startX - m_X[shape]) * m_AspectRatio;
+	float startY = query.startY - m_Y[shape];
+	float moveX = (query.endX - query.startX) * m_AspectRatio;
+	float moveY = query.endY - query.startY;
+
+	float time, normalX, normalY;
+	bool touched = (m_Radius[shape] > 0.0f)
+		? CastAgainstCircle(startX, startY, moveX, moveY, m_Radius[shape] + query.radius, time, normalX, normalY)
+		: CastAgainstRoundedBox(startX, startY, moveX, moveY, m_HalfWidth[shape] * m_AspectRatio, m_HalfHeight[shape],
+			query.radius, time, normalX, normalY);
+
+	// On a tie the shape found first stays
+	if (!touched || (hit.hit && time >= hit.fraction))
+	{
+		return;
+	}
+
+	hit = { true, m_Items[shape], time, query.startX + (query.endX - query.startX) * time,
+		query.startY + (query.endY - query.startY) * time, normalX, normalY };
+}
+
+bool QuerySnapshot::Cast(const CastQuery& query, CastHit& hit) const
+{
+	hit = CastHit();
+
+	// Nodes are grown by the cast radius, and only entered if the segment up to the nearest hit
+	// so far reaches them, nearest first
+	float growX = query.radius / m_AspectRatio;
+	float growY = query.radius;
+	float moveX = query.endX - query.startX;
+	float moveY = query.endY - query.startY;
+	m_Tree.Traverse(
+		[&](const AABB& box)
+		{
+			AABB grown = { box.minX - growX, box.minY - growY, box.maxX + growX, box.maxY + growY };
+			return SegmentEnters(grown, query.startX, query.startY, moveX, moveY, hit.hit ? hit.fraction : 1.0f);
+		},
+		[&](uint32_t shape)
+		{
+			CastShape(shape, query, hit);
+		});
+
+	return hit.hit;
+}
+
+void QuerySnapshot::Overlap(const AABB& box, std::vector<QueryItem>& items) const
+{
+	items.clear();
+	std::vector<uint32_t> shapes;
+	m_Tree.Query(box, shapes);
+	for (uint32_t shape : shapes)
+	{
+		// Circles by their closest point to the box, boxes already overlap
+		if (m_Radius[shape] > 0.0f)
+		{
+			float dx = (std::min(std::max(m_X[shape], box.minX), box.maxX) - m_X[shape]) * m_AspectRatio;
+			float dy = std::min(std::max(m_Y[shape], box.minY), box.maxY) - m_Y[shape];
+			if (dx * dx + dy * dy > m_Radius[shape] * m_Radius[shape])
+			{
+				continue;
+			}
+		}
+		items.push_back(m_Items[shape]);
+	}
+}
+
+void QuerySnapshot::Contains(const QueryPoint& point, std::vector<QueryItem>& items) const
+{
+	items.clear();
+	std::vector<uint32_t> shapes;
+	m_Tree.Query({ point.x, point.y, point.x, point.y }, shapes);
+	for (uint32_t shape : shapes)
+	{
+		if (m_Radius[shape] > 0.0f)
+		{
+			float dx = (point.x - m_X[shape]) * m_AspectRatio;
+			float dy = point.y - m_Y[shape];
+			if (dx * dx + dy * dy > m_Radius[shape] * m_Radius[shape])
+			{
+				continue;
+			}
+		}
+		items.push_back(m_Items[shape]);
+	}
+}
+
+void QuerySnapshot::CastBatch(const std::vector<CastQuery>& queries, std::vector<CastHit>& hits, JobSystem& jobs) const
+{
+	hits.resize(queries.size());
+	jobs.ParallelFor(static_cast<uint32_t>(queries.size()), QueriesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				Cast(queries[i], hits[i]);
+			}
+		});
+}
+
+template <typename Input, typename Function>
+void QuerySnapshot::RunBatch(const std::vector<Input>& inputs, QueryResults& results, JobSystem& jobs,
+	Function function) const
+{
+	// Each chunk of queries fills its own buffer, joined in chunk order afterwards
+	uint32_t count = static_cast<uint32_t>(inputs.size());
+	uint32_t chunkCount = (count + QueriesPerJob - 1) / QueriesPerJob;
+	std::vector<std::vector<QueryItem>> chunkItems(chunkCount);
+	results.start.assign(count + 1, 0);
+
+	jobs.ParallelFor(count, QueriesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<QueryItem>& items = chunkItems[begin / QueriesPerJob];
+			std::vector<QueryItem> found;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				function(inputs[i], found);
+				items.insert(items.end(), found.begin(), found.end());
+				results.start[i + 1] = static_cast<uint32_t>(found.size());
+			}
+		});
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		results.start[i + 1] += results.start[i];
+	}
+
+	results.items.clear();
+	results.items.reserve(results.start[count]);
+	for (const std::vector<QueryItem>& items : chunkItems)
+	{
+		results.items.insert(results.items.end(), items.begin(), items.end());
+	}
+}
+
+void QuerySnapshot::OverlapBatch(const std::vector<AABB>& boxes, QueryResults& results, JobSystem& jobs) const
+{
+	RunBatch(boxes, results, jobs, [&](const AABB& box, std::vector<QueryItem>& items) { Overlap(box, items); });
+}
+
+void QuerySnapshot::ContainsBatch(const std::vector<QueryPoint>& points, QueryResults& results, JobSystem& jobs) const
+{
+	RunBatch(points, results, jobs, [&](const QueryPoint& point, std::vector<QueryItem>& items) { Contains(point, items); });
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "Physics/StaticGeometry.h"
+
+StaticGeometry::StaticGeometry(float aspectRatio)
+	: m_AspectRatio(aspectRatio), m_Dirty(false)
+{
+}
+
+uint32_t StaticGeometry::Add(const Wall& wall)
+{
+	// Wall widths are in screen units, physics x is divided by the aspect ratio
+	float halfWidth = (wall.width / 2.0f) / m_AspectRatio;
+	float halfHeight = wall.height / 2.0f;
+
+	m_Walls.push_back(wall);
+	m_Bounds.push_back({ wall.xPosition - halfWidth, wall.yPosition - halfHeight,
+		wall.xPosition + halfWidth, wall.yPosition + halfHeight });
+	m_Dirty = true;
+	return static_cast<uint32_t>(m_Walls.size() - 1);
+}
+
+void StaticGeometry::Clear()
+{
+	m_Walls.clear();
+	m_Bounds.clear();
+	m_Dirty = true;
+}
+
+void StaticGeometry::Build()
+{
+	if (!m_Dirty)
+	{
+		return;
+	}
+
+	m_Tree.Build(m_Bounds, m_AspectRatio);
+	m_Dirty = false;
+}
+
+void StaticGeometry::Query(const AABB& box, std::vector<uint32_t>& walls) const
+{
+	// Same order as looping over every wall, so contacts come out in the same order too
+	m_Tree.Query(box, walls);
+}
\ No newline at end of file
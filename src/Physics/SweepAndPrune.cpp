@@ -0,0 +1,255 @@
+#include "Physics/SweepAndPrune.h"
+#include <algorithm>
+
+namespace
+{
+	inline uint32_t Proxy(uint32_t data) { return data >> 1; }
+	inline bool IsMin(uint32_t data) { return (data & 1) != 0; }
+
+	inline uint64_t PairKey(uint32_t a, uint32_t b)
+	{
+		if (a > b)
+		{
+			std::swap(a, b);
+		}
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	// On equal values max endpoints sort before min endpoints, so two boxes that only touch
+	// count as separated, the same as Overlaps()
+	inline bool SortsAfter(float value1, uint32_t data1, float value2, uint32_t data2)
+	{
+		return value1 > value2 || (value1 == value2 && IsMin(data1) && !IsMin(data2));
+	}
+}
+
+SweepAndPrune::SweepAndPrune()
+	: m_Bounds(nullptr), m_ProxyCount(0)
+{
+}
+
+void SweepAndPrune::AddProxies(uint32_t first, uint32_t last)
+{
+	// New endpoints go on the end with values the sort will pick up; moving them into place
+	// reports their pairs like any other swap
+	for (uint32_t proxy = first; proxy < last; proxy++)
+	{
+		m_EndpointsX.push_back({ 0.0f, (proxy << 1) | 1 });
+		m_EndpointsX.push_back({ 0.0f, proxy << 1 });
+		m_EndpointsY.push_back({ 0.0f, (proxy << 1) | 1 });
+		m_EndpointsY.push_back({ 0.0f, proxy << 1 });
+	}
+	m_ProxyCount = last;
+}
+
+void SweepAndPrune::RemoveProxies(uint32_t first)
+{
+	// Erasing keeps the remaining endpoints in sorted order
+	auto removed = [first](const Endpoint& endpoint) { return Proxy(endpoint.data) >= first; };
+	m_EndpointsX.erase(std::remove_if(m_EndpointsX.begin(), m_EndpointsX.end(), removed), m_EndpointsX.end());
+	m_EndpointsY.erase(std::remove_if(m_EndpointsY.begin(), m_EndpointsY.end(), removed), m_EndpointsY.end());
+
+	for (auto it = m_Pairs.begin(); it != m_Pairs.end();)
+	{
+		// The key holds the higher proxy in its low bits
+		if (static_cast<uint32_t>(*it) >= first)
+		{
+			it = m_Pairs.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	m_ProxyCount = first;
+}
+
+void SweepAndPrune::Update(const std::vector<AABB>& bounds)
+{
+	m_Bounds = &bounds;
+	uint32_t proxyCount = static_cast<uint32_t>(bounds.size());
+
+	if (m_ProxyCount == 0 || proxyCount > m_ProxyCount + RebuildProxyCount)
+	{
+		Rebuild(proxyCount);
+		return;
+	}
+
+	// Removed bodies take the highest proxies with them (the body moved into a freed slot just
+	// shows up as a big jump of its proxy, which the sort handles like any other move)
+	if (proxyCount < m_ProxyCount)
+	{
+		RemoveProxies(proxyCount);
+	}
+
+	if (proxyCount > m_ProxyCount)
+	{
+		AddProxies(m_ProxyCount, proxyCount);
+	}
+
+	RefreshEndpoints(m_EndpointsX, true);
+	RefreshEndpoints(m_EndpointsY, false);
+
+	InsertionSort(m_EndpointsX);
+	InsertionSort(m_EndpointsY);
+}
+
+void SweepAndPrune::Reset()
+{
+	// Every proxy would jump to another body's place, insertion sort would take O(n^2) to follow
+	m_EndpointsX.clear();
+	m_EndpointsY.clear();
+	m_Pairs.clear();
+	m_ProxyCount = 0;
+}
+
+void SweepAndPrune::Rebuild(uint32_t proxyCount)
+{
+	m_EndpointsX.clear();
+	m_EndpointsY.clear();
+	m_Pairs.clear();
+	m_ProxyCount = 0;
+	AddProxies(0, proxyCount);
+	RefreshEndpoints(m_EndpointsX, true);
+	RefreshEndpoints(m_EndpointsY, false);
+
+	// Same order the insertion sort keeps
+	auto sortsBefore = [](const Endpoint& first, const Endpoint& second)
+		{
+			return SortsAfter(second.value, second.data, first.value, first.data);
+		};
+	std::sort(m_EndpointsX.begin(), m_EndpointsX.end(), sortsBefore);
+	std::sort(m_EndpointsY.begin(), m_EndpointsY.end(), sortsBefore);
+
+	// Proxies whose x range is open at the current endpoint, their boxes copied alongside so the
+	// inner loop reads them in order, and each one's slot so it can be swapped out when its max
+	// comes. A zero width box meets its max first: it still overlaps the boxes open around it,
+	// but nothing that opens after it
+	const std::vector<AABB>& bounds = *m_Bounds;
+	const uint32_t Closed = 0xFFFFFFFF;
+	std::vector<uint32_t> open;
+	std::vector<AABB> openBounds;
+	std::vector<uint32_t> openSlot(proxyCount, Closed);
+	std::vector<uint8_t> finished(proxyCount, 0);
+	for (const Endpoint& endpoint : m_EndpointsX)
+	{
+		uint32_t proxy = Proxy(endpoint.data);
+		if (IsMin(endpoint.data))
+		{
+			const AABB& box = bounds[proxy];
+			for (size_t slot = 0; slot < open.size(); slot++)
+			{
+				if (Overlaps(box, openBounds[slot]))
+				{
+					m_Pairs.insert(PairKey(proxy, open[slot]));
+				}
+			}
+			if (finished[proxy])
+			{
+				continue;
+			}
+			openSlot[proxy] = static_cast<uint32_t>(open.size());
+			open.push_back(proxy);
+			openBounds.push_back(box);
+		}
+		else
+		{
+			finished[proxy] = 1;
+			uint32_t slot = openSlot[proxy];
+			if (slot == Closed)
+			{
+				continue;
+			}
+			uint32_t last = open.back();
+			open[slot] = last;
+			openBounds[slot] = openBounds.back();
+			openSlot[last] = slot;
+			open.pop_back();
+			openBounds.pop_back();
+			openSlot[proxy] = Closed;
+		}
+	}
+}
+
+void SweepAndPrune::RefreshEndpoints(std::vector<Endpoint>& endpoints, bool xAxis)
+{
+	const std::vector<AABB>& bounds = *m_Bounds;
+	for (Endpoint& endpoint : endpoints)
+	{
+		const AABB& box = bounds[Proxy(endpoint.data)];
+		if (xAxis)
+		{
+			endpoint.value = IsMin(endpoint.data) ? box.minX : box.maxX;
+		}
+		else
+		{
+			endpoint.value = IsMin(endpoint.data) ? box.minY : box.maxY;
+		}
+	}
+}
+
+void SweepAndPrune::InsertionSort(std::vector<Endpoint>& endpoints)
+{
+	const std::vector<AABB>& bounds = *m_Bounds;
+
+	for (size_t i = 1; i < endpoints.size(); i++)
+	{
+		Endpoint moving = endpoints[i];
+		size_t j = i;
+
+		while (j > 0 && SortsAfter(endpoints[j - 1].value, endpoints[j - 1].data, moving.value, moving.data))
+		{
+			const Endpoint& passed = endpoints[j - 1];
+			uint32_t movingProxy = Proxy(moving.data);
+			uint32_t passedProxy = Proxy(passed.data);
+
+			if (movingProxy != passedProxy)
+			{
+				if (IsMin(moving.data) && !IsMin(passed.data))
+				{
+					// A min passing a max to the left: the pair starts overlapping on this axis
+					if (Overlaps(bounds[movingProxy], bounds[passedProxy]))
+					{
+						m_Pairs.insert(PairKey(movingProxy, passedProxy));
+					}
+				}
+				else if (!IsMin(moving.data) && IsMin(passed.data))
+				{
+					// A max passing a min to the left: the pair stops overlapping on this axis
+					m_Pairs.erase(PairKey(movingProxy, passedProxy));
+				}
+			}
+
+			endpoints[j] = passed;
+			j--;
+		}
+
+		endpoints[j] = moving;
+	}
+}
+
+void SweepAndPrune::FindPairs(std::vector<BodyPair>& pairs) const
+{
+	pairs.clear();
+	pairs.reserve(m_Pairs.size());
+
+	// The overlapping set is kept whatever the filters say, they can change between steps
+	uint32_t filtered = 0;
+	for (uint64_t key : m_Pairs)
+	{
+		uint32_t first = static_cast<uint32_t>(key >> 32);
+		uint32_t second = static_cast<uint32_t>(key & 0xFFFFFFFF);
+		if (!Accepts(first, second))
+		{
+			filtered++;
+			continue;
+		}
+		pairs.push_back({ first, second });
+	}
+	AddFilteredPairs(filtered);
+
+	std::sort(pairs.begin(), pairs.end(), [](const BodyPair& first, const BodyPair& second)
+		{
+			return (first.a != second.a) ? (first.a < second.a) : (first.b < second.b);
+		});
+}
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include "Physics/UniformGrid.h"
+#include <algorithm>
+#include <cmath>
+
+UniformGrid::UniformGrid()
+	: m_CellSize(0.0f), m_ActiveCellSize(0.0f), m_OriginX(0.0f), m_OriginY(0.0f),
+	m_CellsX(0), m_CellsY(0), m_Bounds(nullptr)
+{
+}
+
+void UniformGrid::SetCellSize(float cellSize)
+{
+	m_CellSize = cellSize;
+}
+
+int UniformGrid::CellX(float x) const
+{
+	int cell = static_cast<int>((x - m_OriginX) / m_ActiveCellSize);
+	return std::min(std::max(cell, 0), m_CellsX - 1);
+}
+
+int UniformGrid::CellY(float y) const
+{
+	int cell = static_cast<int>((y - m_OriginY) / m_ActiveCellSize);
+	return std::min(std::max(cell, 0), m_CellsY - 1);
+}
+
+void UniformGrid::Update(const std::vector<AABB>& bounds)
+{
+	uint32_t bodyCount = static_cast<uint32_t>(bounds.size());
+	if (!BeginBuild(bounds))
+	{
+		return;
+	}
+	SizeCells(MeasureBounds(0, bodyCount), bodyCount);
+
+	// Pass 1: entries per body, prefix summed into offsets
+	m_EntryOffsets.resize(bodyCount + 1);
+	m_EntryOffsets[bodyCount] = CountEntries(0, bodyCount);
+	OffsetEntries(0, bodyCount, 0);
+
+	// Pass 2: one entry per overlapped cell, written to the slots this body owns
+	uint32_t entryCount = m_EntryOffsets[bodyCount];
+	m_Entries.resize(entryCount);
+	WriteEntries(0, bodyCount);
+
+	// Pass 3: counting sort of the entries by cell
+	uint32_t cellCount = static_cast<uint32_t>(m_CellsX * m_CellsY);
+	m_CellStart.resize(cellCount + 1);
+	m_CellBodies.resize(entryCount);
+	SortCells(m_Entries.data(), 0, entryCount, 0, cellCount);
+	m_CellStart[cellCount] = entryCount;
+}
+
+void UniformGrid::UpdateParallel(const std::vector<AABB>& bounds, JobSystem& jobs)
+{
+	uint32_t bodyCount = static_cast<uint32_t>(bounds.size());
+	if (!BeginBuild(bounds))
+	{
+		return;
+	}
+
+	// The extent, merged from one measurement per chunk of bodies
+	uint32_t bodyChunks = (bodyCount - 1) / BodiesPerJob + 1;
+	m_ChunkExtents.resize(bodyChunks);
+	jobs.ParallelFor(bodyCount, BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			m_ChunkExtents[begin / BodiesPerJob] = MeasureBounds(begin, end);
+		});
+	Extent extent = m_ChunkExtents[0];
+	for (uint32_t chunk = 1; chunk < bodyChunks; chunk++)
+	{
+		const Extent& chunkExtent = m_ChunkExtents[chunk];
+		extent.minX = std::min(extent.minX, chunkExtent.minX);
+		extent.minY = std::min(extent.minY, chunkExtent.minY);
+		extent.maxX = std::max(extent.maxX, chunkExtent.maxX);
+		extent.maxY = std::max(extent.maxY, chunkExtent.maxY);
+		extent.largest = std::max(extent.largest, chunkExtent.largest);
+	}
+	SizeCells(extent, bodyCount);
+
+	// Pass 1: every chunk counts its bodies' entries, the chunk totals are prefix summed here
+	m_EntryOffsets.resize(bodyCount + 1);
+	m_ChunkCounts.resize(bodyChunks + 1);
+	jobs.ParallelFor(bodyCount, BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			m_ChunkCounts[begin / BodiesPerJob + 1] = CountEntries(begin, end);
+		});
+	m_ChunkCounts[0] = 0;
+	for (uint32_t chunk = 0; chunk < bodyChunks; chunk++)
+	{
+		m_ChunkCounts[chunk + 1] += m_ChunkCounts[chunk];
+	}
+
+	// Pass 2: every chunk finishes its own offsets from its chunk's start and writes its entries
+	uint32_t entryCount = m_ChunkCounts[bodyChunks];
+	m_EntryOffsets[bodyCount] = entryCount;
+	m_Entries.resize(entryCount);
+	jobs.ParallelFor(bodyCount, BodiesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			OffsetEntries(begin, end, m_ChunkCounts[begin / BodiesPerJob]);
+			WriteEntries(begin, end);
+		});
+
+	// Pass 3: the entries are first split into bands of rows, keeping their order, then every
+	// band is counting sorted on its own. A band's entries land exactly where the cells they
+	// sort into start, so the bands write disjoint parts of m_CellStart and m_CellBodies
+	uint32_t rowsPerBand = (static_cast<uint32_t>(m_CellsY) - 1) / MaxBands + 1;
+	uint32_t bandCount = (static_cast<uint32_t>(m_CellsY) - 1) / rowsPerBand + 1;
+	uint32_t cellsPerBand = rowsPerBand * static_cast<uint32_t>(m_CellsX);
+	uint32_t entryChunks = (entryCount > 0) ? (entryCount - 1) / EntriesPerJob + 1 : 0;
+
+	// Entries per band in every chunk of entries, turned into where each chunk writes them
+	m_BandCounts.assign(static_cast<size_t>(entryChunks) * bandCount, 0);
+	jobs.ParallelFor(entryCount, EntriesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t* counts = &m_BandCounts[static_cast<size_t>(begin / EntriesPerJob) * bandCount];
+			for (uint32_t e = begin; e < end; e++)
+			{
+				counts[m_Entries[e].cell / cellsPerBand]++;
+			}
+		});
+
+	m_BandStart.resize(bandCount + 1);
+	uint32_t running = 0;
+	for (uint32_t band = 0; band < bandCount; band++)
+	{
+		m_BandStart[band] = running;
+		for (uint32_t chunk = 0; chunk < entryChunks; chunk++)
+		{
+			uint32_t& count = m_BandCounts[static_cast<size_t>(chunk) * bandCount + band];
+			uint32_t chunkStart = running;
+			running += count;
+			count = chunkStart;
+		}
+	}
+	m_BandStart[bandCount] = entryCount;
+
+	m_BandEntries.resize(entryCount);
+	jobs.ParallelFor(entryCount, EntriesPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t* write = &m_BandCounts[static_cast<size_t>(begin / EntriesPerJob) * bandCount];
+			for (uint32_t e = begin; e < end; e++)
+			{
+				m_BandEntries[write[m_Entries[e].cell / cellsPerBand]++] = m_Entries[e];
+			}
+		});
+
+	uint32_t cellCount = static_cast<uint32_t>(m_CellsX * m_CellsY);
+	m_CellStart.resize(cellCount + 1);
+	m_CellBodies.resize(entryCount);
+	jobs.ParallelFor(bandCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t band = begin; band < end; band++)
+			{
+				uint32_t firstCell = band * cellsPerBand;
+				uint32_t lastCell = std::min(cellCount, firstCell + cellsPerBand);
+				SortCells(m_BandEntries.data(), m_BandStart[band], m_BandStart[band + 1], firstCell, lastCell);
+			}
+		});
+	m_CellStart[cellCount] = entryCount;
+}
+
+bool UniformGrid::BeginBuild(const std::vector<AABB>& bounds)
+{
+	m_Bounds = bounds.data();
+	m_Entries.clear();
+	m_CellBodies.clear();
+	m_CellStart.assign(1, 0);
+	m_CellsX = 0;
+	m_CellsY = 0;
+	return !bounds.empty();
+}
+
+UniformGrid::Extent UniformGrid::MeasureBounds(uint32_t first, uint32_t last) const
+{
+	Extent extent = { m_Bounds[first].minX, m_Bounds[first].minY, m_Bounds[first].maxX, m_Bounds[first].maxY, 0.0f };
+	for (uint32_t i = first; i < last; i++)
+	{
+		const AABB& box = m_Bounds[i];
+		extent.minX = std::min(extent.minX, box.minX);
+		extent.minY = std::min(extent.minY, box.minY);
+		extent.maxX = std::max(extent.maxX, box.maxX);
+		extent.maxY = std::max(extent.maxY, box.maxY);
+		extent.largest = std::max(extent.largest, std::max(box.maxX - box.minX, box.maxY - box.minY));
+	}
+	return extent;
+}
+
+void UniformGrid::SizeCells(const Extent& extent, uint32_t bodyCount)
+{
+	// A cell as big as the largest body means a body never spans more than 2x2 cells
+	float cellSize = (m_CellSize > 0.0f) ? m_CellSize : extent.largest;
+	if (cellSize <= 0.0f)
+	{
+		cellSize = 0.01f;
+	}
+
+	long long maxCells = std::max<long long>(64, static_cast<long long>(bodyCount) * MaxCellsPerBody);
+	long long cellsX, cellsY;
+	while (true)
+	{
+		cellsX = static_cast<long long>((extent.maxX - extent.minX) / cellSize) + 1;
+		cellsY = static_cast<long long>((extent.maxY - extent.minY) / cellSize) + 1;
+		if (cellsX * cellsY <= maxCells)
+		{
+			break;
+		}
+		cellSize *= 2.0f;
+	}
+
+	m_ActiveCellSize = cellSize;
+	m_OriginX = extent.minX;
+	m_OriginY = extent.minY;
+	m_CellsX = static_cast<int>(cellsX);
+	m_CellsY = static_cast<int>(cellsY);
+}
+
+uint32_t UniformGrid::CountEntries(uint32_t first, uint32_t last)
+{
+	uint32_t total = 0;
+	for (uint32_t i = first; i < last; i++)
+	{
+		const AABB& box = m_Bounds[i];
+		uint32_t spanX = static_cast<uint32_t>(CellX(box.maxX) - CellX(box.minX) + 1);
+		uint32_t spanY = static_cast<uint32_t>(CellY(box.maxY) - CellY(box.minY) + 1);
+		m_EntryOffsets[i] = spanX * spanY;
+		total += spanX * spanY;
+	}
+	return total;
+}
+
+void UniformGrid::OffsetEntries(uint32_t first, uint32_t last, uint32_t start)
+{
+	for (uint32_t i = first; i < last; i++)
+	{
+		uint32_t count = m_EntryOffsets[i];
+		m_EntryOffsets[i] = start;
+		start += count;
+	}
+}
+
+void UniformGrid::WriteEntries(uint32_t first, uint32_t last)
+{
+	for (uint32_t i = first; i < last; i++)
+	{
+		const AABB& box = m_Bounds[i];
+		uint32_t write = m_EntryOffsets[i];
+		for (int y = CellY(box.minY); y <= CellY(box.maxY); y++)
+		{
+			for (int x = CellX(box.minX); x <= CellX(box.maxX); x++)
+			{
+				m_Entries[write++] = { static_cast<uint32_t>(y * m_CellsX + x), i };
+			}
+		}
+	}
+}
+
+void UniformGrid::SortCells(const CellEntry* entries, uint32_t begin, uint32_t end, uint32_t firstCell,
+	uint32_t lastCell)
+{
+	std::fill(m_CellStart.begin() + firstCell, m_CellStart.begin() + lastCell, 0u);
+	for (uint32_t e = begin; e < end; e++)
+	{
+		m_CellStart[entries[e].cell]++;
+	}
+
+	uint32_t running = begin;
+	for (uint32_t c = firstCell; c < lastCell; c++)
+	{
+		running += m_CellStart[c];
+		m_CellStart[c] = running;
+	}
+
+	// Scattering backwards leaves every cell sorted by body index and turns the running
+	// ends in m_CellStart back into cell starts
+	for (uint32_t e = end; e-- > begin;)
+	{
+		m_CellBodies[--m_CellStart[entries[e].cell]] = entries[e].body;
+	}
+}
+
+namespace
+{
+	// Resolve in the same order the old nested pair loop did so results stay deterministic
+	void SortPairs(std::vector<BodyPair>& pairs)
+	{
+		std::sort(pairs.begin(), pairs.end(), [](const BodyPair& first, const BodyPair& second)
+			{
+				return (first.a != second.a) ? (first.a < second.a) : (first.b < second.b);
+			});
+	}
+}
+
+void UniformGrid::FindPairs(std::vector<BodyPair>& pairs) const
+{
+	pairs.clear();
+	FindPairsInRows(0, m_CellsY, pairs);
+	SortPairs(pairs);
+}
+
+void UniformGrid::FindPairsParallel(std::vector<BodyPair>& pairs, JobSystem& jobs) const
+{
+	pairs.clear();
+	if (m_CellsY == 0)
+	{
+		return;
+	}
+
+	// Rows are split into chunks, each with its own pair buffer, and the buffers are joined in
+	// chunk order. Every pair belongs to exactly one cell so nothing is found twice
+	uint32_t rowsPerJob = std::max(1u, CellsPerJob / static_cast<unsigned int>(m_CellsX));
+	uint32_t chunkCount = (static_cast<uint32_t>(m_CellsY) - 1) / rowsPerJob + 1;
+	if (m_ChunkPairs.size() < chunkCount)
+	{
+		m_ChunkPairs.resize(chunkCount);
+	}
+
+	jobs.ParallelFor(static_cast<uint32_t>(m_CellsY), rowsPerJob, [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<BodyPair>& chunkPairs = m_ChunkPairs[begin / rowsPerJob];
+			chunkPairs.clear();
+			FindPairsInRows(static_cast<int>(begin), static_cast<int>(end), chunkPairs);
+		});
+
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		pairs.insert(pairs.end(), m_ChunkPairs[chunk].begin(), m_ChunkPairs[chunk].end());
+	}
+	SortPairs(pairs);
+}
+
+void UniformGrid::FindPairsInRows(int firstRow, int lastRow, std::vector<BodyPair>& pairs) const
+{
+	uint32_t filtered = 0;
+	for (int cellY = firstRow; cellY < lastRow; cellY++)
+	{
+		for (int cellX = 0; cellX < m_CellsX; cellX++)
+		{
+			uint32_t cell = static_cast<uint32_t>(cellY * m_CellsX + cellX);
+			uint32_t begin = m_CellStart[cell];
+			uint32_t end = m_CellStart[cell + 1];
+
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const AABB& first = m_Bounds[m_CellBodies[i]];
+				for (uint32_t j = i + 1; j < end; j++)
+				{
+					const AABB& second = m_Bounds[m_CellBodies[j]];
+					if (!Overlaps(first, second))
+					{
+						continue;
+					}
+
+					// Bodies that share several cells are only reported by the cell holding
+					// the bottom left corner of their overlap
+					if (CellX(std::max(first.minX, second.minX)) != cellX ||
+						CellY(std::max(first.minY, second.minY)) != cellY)
+					{
+						continue;
+					}
+
+					if (!Accepts(m_CellBodies[i], m_CellBodies[j]))
+					{
+						filtered++;
+						continue;
+					}
+
+					pairs.push_back({ m_CellBodies[i], m_CellBodies[j] });
+				}
+			}
+		}
+	}
+	AddFilteredPairs(filtered);
+}
\ No newline at end of file
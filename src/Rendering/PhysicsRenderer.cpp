@@ -2,13 +2,17 @@
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
 #include "Rendering/PhysicsRenderer.h"
 #include "Rendering/Renderer.h"
 
 PhysicsEngine::PhysicsEngine(int width, int height, const char* title)
 	: m_Width(width), m_Height(height), m_Window(nullptr), m_PhysicsLayer(nullptr),
-	m_LastFrameTime(0.05f), m_Dt(0.0f)
+	m_FixedDt(1.0 / 60.0), m_Accumulator(0.0), m_LastFrameTime(0.0), m_MaxStepsPerFrame(5),
+	m_PrintedDecisions(0)
 {
 	srand(static_cast<unsigned int>(time(nullptr)));
 }
@@ -59,28 +63,27 @@ bool PhysicsEngine::Init(const char* title)
 
 	glfwSetWindowUserPointer(m_Window, this);
 	glfwSetMouseButtonCallback(m_Window, MouseLeftClickCallBack);
+	glfwSetKeyCallback(m_Window, KeyCallBack);
 
 	float scale = m_Height / 480.0f;
 	float aspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
 
-	float gravity = 0.01f;
+	// Units per second squared, the old 0.01 per frame at 60 frames a second
+	float gravity = 0.6f;
 	float groundPosition = -1.0;
 	float groundHeight = 0.2;
 	float bounceLevel = 0.5;
 	float groundWidth = 2.95f;  
 
 	m_PhysicsLayer = new Physics(gravity, groundPosition, groundHeight, groundWidth, bounceLevel, aspectRatio);
+	m_Bodies.SetAspectRatio(aspectRatio);
 
 	// Remove later, Just a rectangle at bottom of screen
-	m_Shapes.push_back({ ShapeType::Ground, 0.0f, groundPosition, groundHeight, groundWidth,
+	m_Bodies.Add({ ShapeType::Ground, 0.0f, groundPosition, groundHeight, groundWidth,
 		0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
 
-	m_Shapes.push_back({ ShapeType::Wall, -0.8f, -0.5f, 1.0f, 0.07f,
-		0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
+	// Walls live in the physics layer only, Run draws them from there
 	m_PhysicsLayer->AddWall(-0.8, -0.5, 0.07, 1.0);
-
-	m_Shapes.push_back({ ShapeType::Wall, 0.8f, -0.5f, 1.0f, 0.07f,
-		0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, true });
 	m_PhysicsLayer->AddWall(0.8, -0.5, 0.07, 1.0);
 
 	return true;
@@ -98,20 +101,50 @@ int PhysicsEngine::Run()
 	float aspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
 	renderer.SetAspectRatio(aspectRatio);
 
-	m_LastFrameTime = static_cast<float>(glfwGetTime());
+	m_LastFrameTime = glfwGetTime();
+	m_Accumulator = 0.0;
 
 	while (!glfwWindowShouldClose(m_Window))
 	{
-		float currTime = static_cast<float>(glfwGetTime());
-		m_Dt = currTime - m_LastFrameTime;
+		double currTime = glfwGetTime();
+		m_Accumulator += currTime - m_LastFrameTime;
 		m_LastFrameTime = currTime;
 
-		if (m_Dt > 0.05f)
+		int steps = 0;
+		while (m_Accumulator >= m_FixedDt && steps < m_MaxStepsPerFrame)
+		{
+			// The wind blows from a jet just inside the left wall, carrying smoke with it
+			if (m_PhysicsLayer->GetGridFluidEnabled())
+			{
+				GridFluid& wind = m_PhysicsLayer->GetGridFluid();
+				wind.AddVelocity(-0.7f, -0.3f, 0.05f, 1.0f, 0.0f);
+				wind.AddDye(-0.7f, -0.3f, 0.05f, 1.0f);
+			}
+			m_PhysicsLayer->Update(m_Bodies, static_cast<float>(m_FixedDt));
+			m_Accumulator -= m_FixedDt;
+			steps++;
+		}
+
+		// Physics couldn't keep up, drop the backlog instead of trying to catch up next frame
+		// and falling further behind (spiral of death)
+		if (m_Accumulator >= m_FixedDt)
+		{
+			m_Accumulator = std::fmod(m_Accumulator, m_FixedDt);
+		}
+
+		// Log whatever the broadphase tuner decided during these steps
+		for (const TunerDecision& decision : m_PhysicsLayer->GetBroadPhaseDecisions())
 		{
-			m_Dt = 0.05f;
+			if (decision.number >= m_PrintedDecisions)
+			{
+				std::cout << "Broadphase tuner, step " << decision.step << ": " << decision.reason << std::endl;
+				m_PrintedDecisions = decision.number + 1;
+			}
 		}
 
-		m_PhysicsLayer->Update(m_Shapes, m_Dt);
+		// How far between the previous and the current physics state this frame is
+		float alpha = static_cast<float>(m_Accumulator / m_FixedDt);
+
 		// Step one: clear screen
 		renderer.Clear();
 
@@ -119,25 +152,69 @@ int PhysicsEngine::Run()
 		renderer.BeginBatch();
 
 		// Step three: Submit draw data
-		for (const auto& shape : m_Shapes)
+		for (const Wall& wall : m_PhysicsLayer->GetStaticGeometry().GetWalls())
+		{
+			renderer.DrawRectangle(wall.xPosition, wall.yPosition, wall.height, wall.width,
+				0.5f, 0.5f, 0.5f, 1.0f);
+		}
+
+		// Smoke from the grid fluid behind the bodies, one square per block of cells
+		if (m_PhysicsLayer->GetGridFluidEnabled())
+		{
+			const GridFluid& wind = m_PhysicsLayer->GetGridFluid();
+			const uint32_t stride = 4;
+			float blockSize = wind.GetCellSize() * stride;
+			for (uint32_t cellY = 0; cellY + stride <= wind.GetCellsY(); cellY += stride)
+			{
+				for (uint32_t cellX = 0; cellX + stride <= wind.GetCellsX(); cellX += stride)
+				{
+					float dye = std::min(wind.GetDye(cellX, cellY), 1.0f);
+					if (dye > 0.05f)
+					{
+						float x = (wind.GetCellX(cellX) + wind.GetCellX(cellX + stride - 1)) * 0.5f;
+						float y = (wind.GetCellY(cellY) + wind.GetCellY(cellY + stride - 1)) * 0.5f;
+						renderer.DrawRectangle(x, y, blockSize, blockSize, 0.8f * dye, 0.8f * dye, 0.8f * dye, 1.0f);
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < m_Bodies.Size(); i++)
 		{
-			if (shape.shape == ShapeType::Square)
+			ShapeType type = m_Bodies.type[i];
+			float r, g, b, a;
+			BodyStore::UnpackColor(m_Bodies.color[i], r, g, b, a);
+
+			float x = m_Bodies.prevX[i] + (m_Bodies.x[i] - m_Bodies.prevX[i]) * alpha;
+			float y = m_Bodies.prevY[i] + (m_Bodies.y[i] - m_Bodies.prevY[i]) * alpha;
+
+			if (type == ShapeType::Square)
 			{
-				renderer.DrawSquare(shape.x, shape.y, shape.size, shape.width,
-					shape.r, shape.g, shape.b, shape.a);
+				renderer.DrawSquare(x, y, m_Bodies.size[i], m_Bodies.width[i],
+					r, g, b, a);
 			}
-			else if (shape.shape == ShapeType::Circle)
+			else if (type == ShapeType::Circle)
 			{
-				renderer.DrawCircle(shape.x, shape.y, shape.size,
-					shape.r, shape.g, shape.b, shape.a);
+				renderer.DrawCircle(x, y, m_Bodies.size[i],
+					r, g, b, a);
 			}
-			else if (shape.shape == ShapeType::Rectangle || shape.shape == ShapeType::Ground || shape.shape == ShapeType::Wall)
+			else if (type == ShapeType::Rectangle || type == ShapeType::Ground || type == ShapeType::Wall)
 			{
-				renderer.DrawRectangle(shape.x, shape.y, shape.size, shape.width,
-					shape.r, shape.g, shape.b, shape.a);
+				renderer.DrawRectangle(x, y, m_Bodies.size[i], m_Bodies.width[i],
+					r, g, b, a);
 			}
 		}
 
+		// Fluid particles go through the same circle batch, drawn as large as their rest spacing
+		const Fluid& fluid = m_PhysicsLayer->GetFluid();
+		float particleSize = fluid.GetParticleRadius() * 3.5f;
+		for (size_t i = 0; i < fluid.Size(); i++)
+		{
+			float x = fluid.prevX[i] + (fluid.x[i] - fluid.prevX[i]) * alpha;
+			float y = fluid.prevY[i] + (fluid.y[i] - fluid.prevY[i]) * alpha;
+			renderer.DrawCircle(x, y, particleSize, 0.2f, 0.45f, 0.9f, 1.0f);
+		}
+
 		// Step four: Draw everything all at once (Batch Rendering) 
 		renderer.EndBatch();
 
@@ -152,6 +229,16 @@ int PhysicsEngine::Run()
 	return 0;
 }
 
+void PhysicsEngine::SetStepRate(double stepsPerSecond)
+{
+	m_FixedDt = 1.0 / stepsPerSecond;
+}
+
+void PhysicsEngine::SetMaxStepsPerFrame(int maxSteps)
+{
+	m_MaxStepsPerFrame = maxSteps;
+}
+
 void PhysicsEngine::OnMouseLeftClick(double clickXPos, double clickYPos)
 {
 	// Conversion of screen to OpenGL coordinates
@@ -180,11 +267,11 @@ void PhysicsEngine::OnMouseLeftClick(double clickXPos, double clickYPos)
 
 	if (isCircle)
 	{
-		m_Shapes.push_back({ ShapeType::Circle, x, y, 0.1f * scale, 0.1f * scale, r, g, b, 1.0f, 0.0f, 0.0f, false });
+		m_Bodies.Add({ ShapeType::Circle, x, y, 0.1f * scale, 0.1f * scale, r, g, b, 1.0f, 0.0f, 0.0f, false });
 	}
 	else
 	{
-		m_Shapes.push_back({ ShapeType::Square, x, y, 0.05f * scale, 0.05f * scale, r, g, b, 1.0f, 0.0f, 0.0f, false });
+		m_Bodies.Add({ ShapeType::Square, x, y, 0.05f * scale, 0.05f * scale, r, g, b, 1.0f, 0.0f, 0.0f, false });
 	}
 }
 
@@ -197,4 +284,160 @@ void PhysicsEngine::MouseLeftClickCallBack(GLFWwindow* window, int button, int a
 		glfwGetCursorPos(window, &mouseXPos, &mouseYPos);
 		engine->OnMouseLeftClick(mouseXPos, mouseYPos);
 	}
+}
+
+void PhysicsEngine::OnKeyPress(int key)
+{
+	// A turns the broadphase tuner on and off
+	if (key == GLFW_KEY_A)
+	{
+		bool enabled = !m_PhysicsLayer->GetBroadPhaseAutoTune();
+		m_PhysicsLayer->SetBroadPhaseAutoTune(enabled);
+		std::cout << "Broadphase auto tuning: " << (enabled ? "On" : "Off") << std::endl;
+	}
+
+	// B cycles through the broadphases so they can be compared on the same scene, which turns
+	// the tuner off until A turns it back on
+	if (key == GLFW_KEY_B)
+	{
+		switch (m_PhysicsLayer->GetBroadPhase())
+		{
+		case BroadPhaseType::BruteForce:
+			m_PhysicsLayer->SetBroadPhase(BroadPhaseType::UniformGrid);
+			std::cout << "Broadphase: Uniform Grid" << std::endl;
+			break;
+		case BroadPhaseType::UniformGrid:
+			m_PhysicsLayer->SetBroadPhase(BroadPhaseType::SweepAndPrune);
+			std::cout << "Broadphase: Sweep And Prune" << std::endl;
+			break;
+		case BroadPhaseType::SweepAndPrune:
+			m_PhysicsLayer->SetBroadPhase(BroadPhaseType::DynamicTree);
+			std::cout << "Broadphase: Dynamic AABB Tree" << std::endl;
+			break;
+		default:
+			m_PhysicsLayer->SetBroadPhase(BroadPhaseType::BruteForce);
+			std::cout << "Broadphase: Brute Force" << std::endl;
+			break;
+		}
+	}
+
+	// T doubles the physics thread count, wrapping back to 1 past the hardware thread count
+	if (key == GLFW_KEY_T)
+	{
+		unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		unsigned int threadCount = m_PhysicsLayer->GetThreadCount() * 2;
+		if (threadCount > maxThreads)
+		{
+			threadCount = (m_PhysicsLayer->GetThreadCount() < maxThreads) ? maxThreads : 1;
+		}
+
+		m_PhysicsLayer->SetThreadCount(threadCount);
+		std::cout << "Physics threads: " << threadCount << std::endl;
+	}
+
+	// X switches between the impulse solver and substeps
+	if (key == GLFW_KEY_X)
+	{
+		if (m_PhysicsLayer->GetSolverType() == SolverType::Impulse)
+		{
+			m_PhysicsLayer->SetSolverType(SolverType::Substep);
+			std::cout << "Solver: " << m_PhysicsLayer->GetSubsteps() << " substeps" << std::endl;
+		}
+		else
+		{
+			m_PhysicsLayer->SetSolverType(SolverType::Impulse);
+			std::cout << "Solver: Impulse" << std::endl;
+		}
+	}
+
+	// C turns the sweeps that stop fast bodies passing through the ground and walls on and off
+	if (key == GLFW_KEY_C)
+	{
+		bool enabled = !m_PhysicsLayer->GetContinuousCollision();
+		m_PhysicsLayer->SetContinuousCollision(enabled);
+		std::cout << "Continuous collision: " << (enabled ? "On" : "Off") << std::endl;
+	}
+
+	// G switches between uniform gravity and every body pulling on every other
+	if (key == GLFW_KEY_G)
+	{
+		if (m_PhysicsLayer->GetGravityMode() == GravityMode::Uniform)
+		{
+			m_PhysicsLayer->SetGravityMode(GravityMode::NBody);
+			std::cout << "Gravity: N-body" << std::endl;
+		}
+		else
+		{
+			m_PhysicsLayer->SetGravityMode(GravityMode::Uniform);
+			std::cout << "Gravity: Uniform" << std::endl;
+		}
+	}
+
+	// F pours a block of fluid in between the walls
+	if (key == GLFW_KEY_F)
+	{
+		Fluid& fluid = m_PhysicsLayer->GetFluid();
+		fluid.AddBlock(0.0f, 0.3f, 0.6f, 0.4f);
+		std::cout << "Fluid: " << fluid.Size() << " particles" << std::endl;
+	}
+
+	// J turns the wind (grid fluid) on and off, starting it again from still air
+	if (key == GLFW_KEY_J)
+	{
+		bool enabled = !m_PhysicsLayer->GetGridFluidEnabled();
+		m_PhysicsLayer->SetGridFluidEnabled(enabled);
+		if (enabled)
+		{
+			m_PhysicsLayer->GetGridFluid().Clear();
+		}
+		std::cout << "Wind: " << (enabled ? "on" : "off") << std::endl;
+	}
+
+	// S prints what the contact solver did on the last step
+	if (key == GLFW_KEY_S)
+	{
+		const SolverStats& stats = m_PhysicsLayer->GetSolverStats();
+		std::cout << "Solver: " << stats.contacts << " contacts, " << stats.colours << " colours, "
+			<< stats.overflow << " overflow, " << stats.velocityIterations << " iterations in "
+			<< stats.velocityMilliseconds << " ms (" << stats.contactsPerMillisecond << " contacts/ms)" << std::endl;
+
+		const PairStats& pairs = m_PhysicsLayer->GetPairStats();
+		std::cout << "Pairs: " << pairs.overlapping << " overlapping, " << pairs.filtered << " filtered, "
+			<< pairs.sleeping << " sleeping, " << pairs.sensor << " sensor, " << pairs.tested << " tested, " << pairs.touching << " touching" << std::endl;
+
+		if (m_PhysicsLayer->GetGravityMode() == GravityMode::NBody)
+		{
+			const NBodyStats& nbody = m_PhysicsLayer->GetNBodyStats();
+			NBodyError error = m_PhysicsLayer->MeasureNBodyError(64);
+			std::cout << "N-body: " << nbody.bodies << " bodies, " << nbody.nodes << " nodes, "
+				<< nbody.interactionsPerBody << " interactions/body, build " << nbody.buildMilliseconds << " ms, forces "
+				<< nbody.forceMilliseconds << " ms, rms error " << error.rmsError << std::endl;
+		}
+
+		const FluidStats& fluid = m_PhysicsLayer->GetFluidStats();
+		if (fluid.particles > 0)
+		{
+			std::cout << "Fluid: " << fluid.particles << " particles, " << fluid.neighboursPerParticle
+				<< " neighbours/particle, " << fluid.densityError * 100.0f << "% compressed, " << fluid.milliseconds
+				<< " ms" << std::endl;
+		}
+
+		if (m_PhysicsLayer->GetGridFluidEnabled())
+		{
+			const GridFluidStats& wind = m_PhysicsLayer->GetGridFluidStats();
+			std::cout << "Wind: " << wind.cellsX << "x" << wind.cellsY << " cells, " << wind.levels << " levels, "
+				<< wind.vCycles << " V-cycles, divergence " << wind.divergenceBefore << " -> " << wind.divergenceAfter
+				<< ", advect " << wind.advectMilliseconds << " ms, project " << wind.projectMilliseconds << " ms, "
+				<< wind.milliseconds << " ms" << std::endl;
+		}
+	}
+}
+
+void PhysicsEngine::KeyCallBack(GLFWwindow* window, int key, int, int action, int)
+{
+	PhysicsEngine* engine = static_cast<PhysicsEngine*>(glfwGetWindowUserPointer(window));
+	if (engine && action == GLFW_PRESS)
+	{
+		engine->OnKeyPress(key);
+	}
 }
\ No newline at end of file
@@ -95,8 +95,8 @@ void Renderer::DrawSquare(float x, float y, float size, float width, float r, fl
 {
     if (QuadCount >= MaxQuads)
     {
-        // No more cause max Quads
-        return;
+        // Buffer is full, draw what's there and carry on in a fresh batch
+        Flush();
     }
 
     float halfSize = size / 2.0f;
@@ -119,8 +119,8 @@ void Renderer::DrawSquare(float x, float y, float size, float width, float r, fl
 void Renderer::DrawRectangle(float x, float y, float size, float width, float r, float g, float b, float a) {
     if (QuadCount >= MaxQuads)
     {
-        // No more cause max Quads
-        return;
+        // Buffer is full, draw what's there and carry on in a fresh batch
+        Flush();
     }
 
     float halfSize = size / 2.0f;
@@ -149,8 +149,8 @@ void Renderer::DrawCircle(float x, float y, float radius, float r, float g, floa
 {
     if (QuadCount >= MaxQuads)
     {
-        // No more cause max Quads
-        return;
+        // Buffer is full, draw what's there and carry on in a fresh batch
+        Flush();
     }
 
     float halfSize = radius / 3.5f;
@@ -170,6 +170,11 @@ void Renderer::DrawCircle(float x, float y, float radius, float r, float g, floa
 }
 
 void Renderer::EndBatch()
+{
+    Flush();
+}
+
+void Renderer::Flush()
 {
     if (QuadCount == 0)
     {
@@ -183,4 +188,6 @@ void Renderer::EndBatch()
     VAO->Bind();
     IBO->Bind();
     GLCall(glDrawElements(GL_TRIANGLES, QuadCount * 6, GL_UNSIGNED_INT, nullptr));
+
+    BeginBatch();
 }
\ No newline at end of file